@@ -3,34 +3,59 @@
 #include "App.h"
 #include "Exceptions.h"
 
-App::App(Port port, std::string ip, size_t maxConnections)
-    : logger{"server.log", "communication.log", "stats.log"},
+namespace
+{
+std::string logPath(const std::string &directory, const std::string &fileName)
+{
+    // without a directory the logs are written into the working directory
+    return directory.empty() ? fileName : directory + "/" + fileName;
+}
+}
+
+App::App(Port port,
+         std::string ip,
+         size_t maxConnections,
+         unsigned broadcastRate,
+         std::string replayDirectory,
+         Port metricsPort,
+         std::string metricsSegment,
+         std::string logDirectory)
+    : clock{&systemClock},
+      logger{logPath(logDirectory, "server.log"),
+             logPath(logDirectory, "communication.cap"),
+             logPath(logDirectory, "stats.log")},
+      replayRecorder{logger, std::move(replayDirectory)},
       shell{*this},
       server{*this, port, std::move(ip)},
+      metricsServer{*this, metricsPort},
+      metricsPublisher{*this, std::move(metricsSegment)},
       packetHandler{*this},
+      spectatorBroadcaster{*this},
       lastConnectionUid{0},
       lastGameUid{0},
       maxConnections{maxConnections},
+      broadcastRate{broadcastRate},
+      interactive{true},
       pendingGame{nullptr}
 {}
 
 void App::addNickname(Uid uid, std::string nickname)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsNicknamesMutex);
+    auto lock = connectionsNicknamesMutex.acquire();
 
     connectionsNicknames.emplace(uid, nickname);
 }
 
 void App::removeNickname(Uid uid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsNicknamesMutex);
+    auto lock = connectionsNicknamesMutex.acquire();
 
     connectionsNicknames.erase(uid);
 }
 
 Connection &App::addConnection(int socket, sockaddr_in address)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsMutex);
+    auto lock = connectionsMutex.acquire();
 
     Uid uid = lastConnectionUid++;
 
@@ -39,12 +64,14 @@ Connection &App::addConnection(int socket, sockaddr_in address)
         std::forward_as_tuple(uid),
         std::forward_as_tuple(*this, uid, socket, address));
 
+    stats.setConnectionsCount(connections.size());
+
     return inserted.first->second;
 }
 
 App::ConnectionIterator App::removeConnection(ConnectionIterator it)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsMutex);
+    auto lock = connectionsMutex.acquire();
 
     Connection &connection = it->second;
 
@@ -60,12 +87,15 @@ App::ConnectionIterator App::removeConnection(ConnectionIterator it)
     connection.stop(true);
 
     notifyOne();
-    return connections.erase(it);
+    auto next = connections.erase(it);
+    stats.setConnectionsCount(connections.size());
+
+    return next;
 }
 
 Game &App::addGame()
 {
-    std::unique_lock<std::recursive_mutex> lock(gamesMutex);
+    auto lock = gamesMutex.acquire();
 
     Uid uid = lastGameUid++;
 
@@ -74,43 +104,90 @@ Game &App::addGame()
         std::forward_as_tuple(uid),
         std::forward_as_tuple(*this, uid));
 
-    return inserted.first->second;;
+    stats.setGamesCount(games.size());
+
+    return inserted.first->second;
 }
 
 App::GameIterator App::removeGame(GameIterator it)
 {
-    std::unique_lock<std::recursive_mutex> lockG(gamesMutex);
-    std::unique_lock<std::recursive_mutex> lockPG(pendingGameMutex);
+    auto lockG = gamesMutex.acquire();
+    auto lockPG = pendingGameMutex.acquire();
 
     Game &game = it->second;
 
     if (pendingGame && pendingGame->getUid() == game.getUid()) {
         pendingGame = nullptr;
+        stats.setPlayersWaiting(0);
     }
 
     game.stop(true);
 
+    {
+        auto lockS = connectionsSpectatingMutex.acquire();
+
+        // the broadcaster already forgot the spectators of the ended game
+        for (auto spectating = connectionsSpectating.begin(); spectating != connectionsSpectating.end();) {
+            if (spectating->second == game.getUid()) {
+                spectating = connectionsSpectating.erase(spectating);
+            } else {
+                spectating++;
+            }
+        }
+    }
+
     notifyOne();
-    return games.erase(it);
+    auto next = games.erase(it);
+    stats.setGamesCount(games.size());
+
+    return next;
 }
 
 void App::addConnectionGame(Uid connectionUid, Uid gameUid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsGamesMutex);
+    auto lock = connectionsGamesMutex.acquire();
 
     auto inserted = connectionsGames.emplace(connectionUid, gameUid);
 }
 
 void App::removeConnectionGame(Uid connectionUid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsGamesMutex);
+    auto lock = connectionsGamesMutex.acquire();
 
     connectionsGames.erase(connectionUid);
 }
 
+bool App::leaveSpectating(Uid connectionUid)
+{
+    Uid gameUid;
+
+    {
+        // not held while calling the game, removeGame() takes it under the games mutex
+        auto lock = connectionsSpectatingMutex.acquire();
+
+        auto found = connectionsSpectating.find(connectionUid);
+
+        if (found == connectionsSpectating.end()) {
+            return false;
+        }
+
+        gameUid = found->second;
+        connectionsSpectating.erase(found);
+    }
+
+    try {
+        getGame(gameUid).eventSpectatorLeave(connectionUid);
+    }
+    catch (GameNotExistsException &exception) {
+        // game already removed
+    }
+
+    return true;
+}
+
 size_t App::clearClosedConnections()
 {
-    std::unique_lock<std::recursive_mutex> lock{connectionsMutex};
+    auto lock = connectionsMutex.acquire();
 
     size_t count{0};
 
@@ -130,7 +207,7 @@ size_t App::clearClosedConnections()
 
 size_t App::clearEndedGames()
 {
-    std::unique_lock<std::recursive_mutex> lock{gamesMutex};
+    auto lock = gamesMutex.acquire();
 
     size_t count{0};
 
@@ -163,18 +240,64 @@ Stats &App::getStats()
     return stats;
 }
 
+Tracer &App::getTracer()
+{
+    return tracer;
+}
+
+Profiler &App::getProfiler()
+{
+    return profiler;
+}
+
+ReplayRecorder &App::getReplayRecorder()
+{
+    return replayRecorder;
+}
+
 PacketHandler &App::getPacketHandler()
 {
     return packetHandler;
 }
 
+SpectatorBroadcaster &App::getSpectatorBroadcaster()
+{
+    return spectatorBroadcaster;
+}
+
+Clock &App::getClock()
+{
+    return *clock;
+}
+
+void App::setClock(Clock &clock)
+{
+    this->clock = &clock;
+}
+
+void App::setInteractive(bool interactive)
+{
+    this->interactive = interactive;
+}
+
 Timestamp App::getCurrentTimestamp()
 {
-    std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    );
+    return clock->timestamp();
+}
 
-    return ms.count();
+Timestamp App::getCoarseTimestamp()
+{
+    return clock->coarseTimestamp();
+}
+
+unsigned App::getBroadcastRate() const
+{
+    return broadcastRate;
+}
+
+size_t App::getMaxConnections() const
+{
+    return maxConnections;
 }
 
 Connection &App::registerConnection(int socket, sockaddr_in address)
@@ -194,7 +317,7 @@ Connection &App::registerConnection(int socket, sockaddr_in address)
 
 Connection &App::getConnection(Uid uid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsMutex);
+    auto lock = connectionsMutex.acquire();
 
     auto found = connections.find(uid);
 
@@ -218,7 +341,7 @@ void App::login(Uid uid, std::string nickname)
 
 std::string App::getNickname(Uid uid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsNicknamesMutex);
+    auto lock = connectionsNicknamesMutex.acquire();
 
     auto found = connectionsNicknames.find(uid);
 
@@ -231,7 +354,7 @@ std::string App::getNickname(Uid uid)
 
 Game &App::joinGame(Uid uid)
 {
-    std::unique_lock<std::recursive_mutex> lock(pendingGameMutex);
+    auto lock = pendingGameMutex.acquire();
 
     try {
         getNickname(uid);
@@ -240,15 +363,20 @@ Game &App::joinGame(Uid uid)
         throw NotLoggedException("player is not logged");
     }
 
+    // a spectator stops watching to play
+    leaveSpectating(uid);
+
     Game *game;
 
     if (pendingGame && pendingGame->isRunning()) {
         game = pendingGame;
         pendingGame = nullptr;
+        stats.setPlayersWaiting(0);
     } else {
         pendingGame = &addGame();
         game = pendingGame;
         game->start();
+        stats.setPlayersWaiting(1);
     }
 
     addConnectionGame(uid, game->getUid());
@@ -260,11 +388,16 @@ Game &App::joinGame(Uid uid)
 
 void App::leaveGame(Uid connectionUid)
 {
+    if (leaveSpectating(connectionUid)) {
+        return;
+    }
+
     try {
         Game &game = getConnectionGame(connectionUid);
         game.eventPlayerLeave(connectionUid);
         if (pendingGame && pendingGame->getUid() == game.getUid()) {
             pendingGame = nullptr;
+            stats.setPlayersWaiting(0);
         }
     }
     catch (GameNotExistsException &exception) {
@@ -277,9 +410,52 @@ void App::leaveGame(Uid connectionUid)
     removeConnectionGame(connectionUid);
 }
 
+void App::spectateGame(Uid connectionUid, Uid gameUid)
+{
+    try {
+        getNickname(connectionUid);
+    }
+    catch (NoNicknameException &exception) {
+        throw NotLoggedException("player is not logged");
+    }
+
+    {
+        auto lock = connectionsGamesMutex.acquire();
+
+        if (connectionsGames.count(connectionUid)) {
+            throw AlreadyInGameException{"player " + std::to_string(connectionUid) + " is playing"};
+        }
+    }
+
+    leaveSpectating(connectionUid);
+
+    Game &game = getGame(gameUid);
+
+    {
+        // registered before joining, so that removeGame() clears it once the game is closed
+        auto lock = connectionsSpectatingMutex.acquire();
+        connectionsSpectating.emplace(connectionUid, gameUid);
+    }
+
+    try {
+        // the game refuses spectators once it has closed their stream
+        game.eventSpectatorJoin(connectionUid);
+    }
+    catch (GameNotExistsException &exception) {
+        auto lock = connectionsSpectatingMutex.acquire();
+        auto found = connectionsSpectating.find(connectionUid);
+
+        if (found != connectionsSpectating.end() && found->second == gameUid) {
+            connectionsSpectating.erase(found);
+        }
+
+        throw;
+    }
+}
+
 Game &App::getGame(Uid uid)
 {
-    std::unique_lock<std::recursive_mutex> lock(gamesMutex);
+    auto lock = gamesMutex.acquire();
 
     auto found = games.find(uid);
 
@@ -292,7 +468,7 @@ Game &App::getGame(Uid uid)
 
 Game &App::getConnectionGame(Uid connectionUid)
 {
-    std::unique_lock<std::recursive_mutex> lock(connectionsGamesMutex);
+    auto lock = connectionsGamesMutex.acquire();
 
     auto found = connectionsGames.find(connectionUid);
 
@@ -305,7 +481,7 @@ Game &App::getConnectionGame(Uid connectionUid)
 
 size_t App::forEachConnection(std::function<void(Connection &)> function)
 {
-    std::unique_lock<std::recursive_mutex> lock{connectionsMutex};
+    auto lock = connectionsMutex.acquire();
 
     size_t count{0};
 
@@ -317,9 +493,28 @@ size_t App::forEachConnection(std::function<void(Connection &)> function)
     return count;
 }
 
+size_t App::forEachConnection(const std::vector<Uid> &uids, std::function<void(Connection &)> function)
+{
+    auto lock = connectionsMutex.acquire();
+
+    size_t count{0};
+
+    // the connections can not be removed while the function uses them
+    for (Uid uid : uids) {
+        auto found = connections.find(uid);
+
+        if (found != connections.end()) {
+            function(found->second);
+            count++;
+        }
+    }
+
+    return count;
+}
+
 size_t App::forEachGame(std::function<void(Game &)> function)
 {
-    std::unique_lock<std::recursive_mutex> lock{gamesMutex};
+    auto lock = gamesMutex.acquire();
 
     size_t count{0};
 
@@ -331,11 +526,40 @@ size_t App::forEachGame(std::function<void(Game &)> function)
     return count;
 }
 
+void App::updateGameRates()
+{
+    std::vector<Stats::GameRates> rates;
+
+    forEachGame([&rates](Game &game) {
+        rates.push_back({game.getUid(), game.getSendRate(), game.getUpdateRate()});
+    });
+
+    stats.setGameRates(std::move(rates));
+}
+
 void App::before()
 {
-    logger.log("starting application");
+    LOG_DEFAULT(logger, "starting application");
+
+    if (replayRecorder.isEnabled()) {
+        replayRecorder.start();
+    }
+
     server.start();
-    shell.start();
+
+    if (metricsServer.isEnabled()) {
+        metricsServer.start();
+    }
+
+    if (metricsPublisher.isEnabled()) {
+        metricsPublisher.start();
+    }
+
+    if (interactive) {
+        shell.start();
+    }
+
+    spectatorBroadcaster.start();
 }
 
 void App::run()
@@ -346,14 +570,15 @@ void App::run()
 
         count = clearClosedConnections();
         if (count) {
-            logger.log(std::to_string(count) + " closed connection" + (count > 1 ? "s" : "") + " cleared");
+            LOG_DEFAULT(logger, count, " closed connection", count > 1 ? "s" : "", " cleared");
         }
 
         count = clearEndedGames();
         if (count) {
-            logger.log(std::to_string(count) + " ended game" + (count > 1 ? "s" : "") + " cleared");
+            LOG_DEFAULT(logger, count, " ended game", count > 1 ? "s" : "", " cleared");
         }
 
+        updateGameRates();
         logger.writeStats(stats);
 
         auto lock = acquireLock();
@@ -363,18 +588,34 @@ void App::run()
 
 void App::after()
 {
-    logger.log("closing application");
+    LOG_DEFAULT(logger, "closing application");
 
     // stop server from accepting new connections
     server.stop(true);
 
+    if (metricsServer.isEnabled()) {
+        metricsServer.stop(true);
+    }
+
+    if (metricsPublisher.isEnabled()) {
+        metricsPublisher.stop(true);
+    }
+
+    // a profile left running is discarded
+    profiler.stop(true);
+
     // close active games
     forEachGame([](Game &game) {
         game.stop(true);
     });
 
+    spectatorBroadcaster.stop(true);
+
     // close active connections
     forEachConnection([](Connection &connection) {
         connection.stop(true);
     });
+
+    // the games are stopped, write out the rest of their replays
+    replayRecorder.stop(true);
 }
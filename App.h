@@ -4,46 +4,66 @@
 #include <unordered_map>
 
 #include "Types.h"
+#include "Utils/Clock.h"
 #include "Utils/Logger.h"
+#include "Utils/MetricsPublisher.h"
+#include "Utils/Profiler.h"
 #include "Utils/Stats.h"
 #include "Utils/Shell.h"
 #include "Utils/Thread.h"
+#include "Utils/Tracer.h"
 #include "Network/Server.h"
+#include "Network/MetricsServer.h"
 #include "Network/Connection.h"
 #include "Network/PacketHandler.h"
+#include "Network/SpectatorBroadcaster.h"
 #include "Game/Game.h"
+#include "Game/ReplayRecorder.h"
 
 class App: public Thread
 {
 public:
     static const Port DEFAULT_PORT{8191};
     static const size_t DEFAUL_MAX_CONNECTIONS{120};
+    static const unsigned DEFAULT_BROADCAST_RATE{60};
 
     typedef std::unordered_map<Uid, Connection>::iterator ConnectionIterator;
     typedef std::unordered_map<Uid, Game>::iterator GameIterator;
 
 private:
+    SystemClock systemClock;
+    Clock *clock;
     Logger logger;
+    ReplayRecorder replayRecorder;
     Shell shell;
     Server server;
+    MetricsServer metricsServer;
+    MetricsPublisher metricsPublisher;
     Stats stats;
+    Tracer tracer;
+    Profiler profiler;
     PacketHandler packetHandler;
+    SpectatorBroadcaster spectatorBroadcaster;
     std::unordered_map<Uid, Connection> connections;
     std::unordered_map<Uid, Game> games;
     std::unordered_map<Uid, Uid> connectionsGames;
     std::unordered_map<Uid, std::string> connectionsNicknames;
+    std::unordered_map<Uid, Uid> connectionsSpectating;
 
     size_t maxConnections;
+    unsigned broadcastRate;
+    bool interactive;
 
     Uid lastConnectionUid;
     Uid lastGameUid;
     Game *pendingGame;
 
-    std::recursive_mutex connectionsMutex;
-    std::recursive_mutex gamesMutex;
-    std::recursive_mutex pendingGameMutex;
-    std::recursive_mutex connectionsGamesMutex;
-    std::recursive_mutex connectionsNicknamesMutex;
+    ProfiledMutex<std::recursive_mutex> connectionsMutex{"App::connectionsMutex"};
+    ProfiledMutex<std::recursive_mutex> gamesMutex{"App::gamesMutex"};
+    ProfiledMutex<std::recursive_mutex> pendingGameMutex{"App::pendingGameMutex"};
+    ProfiledMutex<std::recursive_mutex> connectionsGamesMutex{"App::connectionsGamesMutex"};
+    ProfiledMutex<std::recursive_mutex> connectionsNicknamesMutex{"App::connectionsNicknamesMutex"};
+    ProfiledMutex<std::recursive_mutex> connectionsSpectatingMutex{"App::connectionsSpectatingMutex"};
 
     void addNickname(Uid uid, std::string nickname);
     void removeNickname(Uid uid);
@@ -57,18 +77,39 @@ private:
     void addConnectionGame(Uid connectionUid, Uid gameUid);
     void removeConnectionGame(Uid uid);
 
+    bool leaveSpectating(Uid connectionUid);
+
     size_t clearClosedConnections();
     size_t clearEndedGames();
 
 public:
-    explicit App(Port port = DEFAULT_PORT, std::string ip = "", size_t maxConnections = DEFAUL_MAX_CONNECTIONS);
+    explicit App(Port port = DEFAULT_PORT,
+                 std::string ip = "",
+                 size_t maxConnections = DEFAUL_MAX_CONNECTIONS,
+                 unsigned broadcastRate = DEFAULT_BROADCAST_RATE,
+                 std::string replayDirectory = "",
+                 Port metricsPort = 0,
+                 std::string metricsSegment = "",
+                 std::string logDirectory = "");
     App(App &app) = delete;
 
     Logger &getLogger();
     Server &getServer();
     Stats &getStats();
+    Tracer &getTracer();
+    Profiler &getProfiler();
+    ReplayRecorder &getReplayRecorder();
     PacketHandler &getPacketHandler();
+    SpectatorBroadcaster &getSpectatorBroadcaster();
+    Clock &getClock();
+    void setClock(Clock &clock);
+
+    // an app embedded in a tool runs without the shell, which would own the standard input
+    void setInteractive(bool interactive);
     Timestamp getCurrentTimestamp();
+    Timestamp getCoarseTimestamp();
+    unsigned getBroadcastRate() const;
+    size_t getMaxConnections() const;
 
     Connection &registerConnection(int socket, sockaddr_in address);
     Connection &getConnection(Uid uid);
@@ -78,12 +119,17 @@ public:
 
     Game &joinGame(Uid connectionUid);
     void leaveGame(Uid connectionUid);
+    void spectateGame(Uid connectionUid, Uid gameUid);
     Game &getGame(Uid uid);
     Game &getConnectionGame(Uid connectionUid);
 
     size_t forEachConnection(std::function<void(Connection &)> function);
+    size_t forEachConnection(const std::vector<Uid> &uids, std::function<void(Connection &)> function);
     size_t forEachGame(std::function<void(Game &)> function);
 
+    // copies the current rates of the games into the stats
+    void updateGameRates();
+
     void before() override;
     void run() override;
     void after() override;
@@ -51,6 +51,41 @@ class LoggerException: public AppException
     using AppException::AppException;
 };
 
+// metrics
+
+class MetricsException: public AppException
+{
+    using AppException::AppException;
+};
+
+// tracer
+
+class TracerException: public AppException
+{
+    using AppException::AppException;
+};
+
+// profiler
+
+class ProfilerException: public AppException
+{
+    using AppException::AppException;
+};
+
+// timer
+
+class TimerException: public AppException
+{
+    using AppException::AppException;
+};
+
+// replay
+
+class ReplayException: public AppException
+{
+    using AppException::AppException;
+};
+
 // shell
 
 class UnknownCommandException: public AppException
@@ -1,99 +1,92 @@
+#include <algorithm>
+
 #include "Game.h"
+#include "Physics.h"
 #include "../App.h"
 #include "../Exceptions.h"
+#include "../Utils/Tracer.h"
 
 Game::Game(App &app, Uid uid)
     : app(app),
       uid(uid),
-      scoreLeft(0),
-      scoreRight(0),
+      gamePhase{GamePhase::New},
+      inputDelayLeft{0},
+      inputDelayRight{0},
+      spectatorsCount{0},
+      spectatorsClosed{false},
       playerUidLeft(-1),
       playerUidRight(-1),
       playerReadyLeft(false),
       playerReadyRight(false),
-      maxScore{10},
       serviceSide{Side::Left},
-      gamePhase{GamePhase::New}
-{}
+      maxScore{10},
+      scoreLeft(0),
+      scoreRight(0),
+      createdAt{app.getCurrentTimestamp()},
+      broadcastPeriod{std::max<Timestamp>(1, 1000 / app.getBroadcastRate())},
+      lastFrameAt{0},
+      nextFrameAt{0},
+      framePending{false},
+      timer{TIMER_SLACK},
+      sendsCount{0},
+      ralliesCount{0},
+      resolutionsCount{0},
+      latenessSum{0},
+      latenessMax{0}
+{
+    // every game gets its own ball sequence, the seed is recorded to replay it
+    seed(std::random_device{}());
+}
 
 PlayerState Game::expectedPlayerState(const PlayerState &state, Timestamp timestamp)
 {
-    double seconds = (timestamp - state.timestamp()) / 1000.0;
+    Position position = expectedPlayerPosition(state.position(), state.direction(), timestamp - state.timestamp());
 
-    int dir;
-    switch (state.direction()) {
-    case PlayerDirection::Up: dir = 1;
-        break;
-    case PlayerDirection::Stop: dir = 0;
-        break;
-    case PlayerDirection::Down: dir = -1;
-        break;
-    }
+    return {timestamp, position, state.direction()};
+}
 
-    auto position = static_cast<long>(state.position() + (dir * PLAYER_SPEED * seconds));
+PlayerState Game::playerStateAt(Side side, Timestamp timestamp)
+{
+    PlayerState state;
 
-    if (position > PLAYER_POSITION_MAX) {
-        position = PLAYER_POSITION_MAX;
-    } else if (position < PLAYER_POSITION_MIN) {
-        position = PLAYER_POSITION_MIN;
+    // rewind to the recorded states, extrapolate only when the history has nothing to offer
+    if (!getPlayerHistory(side).stateAt(timestamp, state)) {
+        state = expectedPlayerState(getPlayerState(side), timestamp);
     }
 
-    return {timestamp, static_cast<Position>(position), state.direction()};
+    return state;
 }
 
 BallState Game::nextBallState(BallState &state, bool fromCenter, Side toSide)
 {
-    double movementWidth = GAME_WIDTH - 2 * BALL_RADIUS;
-    double movementHeight = GAME_HEIGHT - 2 * BALL_RADIUS;
-    double radians = M_PI / 180.0 * state.angle();
-    double halfWidth = movementWidth / 2.0;
-    double halfHeight = movementHeight / 2.0;
-
-    double width = fromCenter ? halfWidth : movementWidth;
-
-    double hypotenuse = width / std::cos(std::abs(radians));
-
-    auto hLeg = static_cast<long>(std::tan(radians) * width);
-
-    double timestamp = hypotenuse / (state.speed() / 1000.0);
-    timestamp += state.timestamp();
-
-    double y = (radians < 0 ? -1 : 1 ) * (hLeg + state.position()) + halfHeight;
-    int mod = static_cast<int>(y) % static_cast<int>(movementHeight);
-    int n = static_cast<int>(y / movementHeight + (radians < 0 ? 1 : 0));
-
-    switch (n % 2) {
-    case 0: {
-        y = mod;
-        break;
-    }
-    case 1: {
-        y = static_cast<int>(movementHeight - mod);
-        break;
-    }
-    }
-
-    y -= halfHeight;
+    BallState arrival = ballArrival(state, fromCenter, toSide);
 
     return {
-        static_cast<Timestamp>(timestamp),
-        fromCenter
-        ? toSide
-        : state.side() == Side::Left ? Side::Right : Side::Left,
-        static_cast<Position>(y),
+        arrival.timestamp(),
+        arrival.side(),
+        arrival.position(),
         randomAngle(randomGenerator),
         randomSpeed(randomGenerator)};
 }
 
 bool Game::canHit(const PlayerState &playerState, const BallState &ballState)
 {
-    return ballState.position() <= playerState.position() + (PLAYER_HEIGHT / 2)
-        && ballState.position() >= playerState.position() - (PLAYER_HEIGHT / 2);
+    return canHitBall(playerState.position(), ballState.position());
 }
 
-bool Game::isInPast(Timestamp timestamp)
+bool Game::isInPast(Timestamp timestamp, Timestamp now, Timestamp jitter)
 {
-    return timestamp <= app.getCurrentTimestamp() + TIME_THRESHOLD.count();
+    // the tolerance grows with the measured jitter of the player's connection
+    return timestamp <= now + TIME_THRESHOLD.count() + jitter;
+}
+
+Timestamp Game::resolutionAt()
+{
+    // the hit is judged once the states of the player on turn up to the arrival can have reached the server,
+    // bounded so that a laggy player does not hold the ball back for the opponent
+    Timestamp lagCompensation = std::min(getInputDelay(futureBallState.side()), MAX_LAG_COMPENSATION);
+
+    return futureBallState.timestamp() - TIME_THRESHOLD.count() + lagCompensation;
 }
 
 Score &Game::getScore(Side side)
@@ -122,6 +115,30 @@ PlayerState &Game::getPlayerState(Uid uid)
     return getPlayerState(getPlayerSide(uid));
 }
 
+PlayerStateHistory &Game::getPlayerHistory(Side side)
+{
+    switch (side) {
+    case Side::Left: { return playerHistoryLeft; }
+    case Side::Right: { return playerHistoryRight; }
+    }
+}
+
+Timestamp &Game::getInputDelay(Side side)
+{
+    switch (side) {
+    case Side::Left: { return inputDelayLeft; }
+    case Side::Right: { return inputDelayRight; }
+    }
+}
+
+Game::PlayerFrame &Game::getPlayerFrame(Side side)
+{
+    switch (side) {
+    case Side::Left: { return playerFrameLeft; }
+    case Side::Right: { return playerFrameRight; }
+    }
+}
+
 BallState &Game::getBallState()
 {
     return ballState;
@@ -149,6 +166,159 @@ Uid Game::getOpponent(Uid uid)
 void Game::sendPacket(Uid uid, Packet packet)
 {
     app.getPacketHandler().handleOutgoingPacket(uid, packet);
+    sendRate.add(app.getCoarseTimestamp());
+    sendsCount++;
+}
+
+void Game::sendPackets(Uid uid, const std::vector<Packet> &packets)
+{
+    app.getPacketHandler().handleOutgoingPackets(uid, packets);
+    sendRate.add(app.getCoarseTimestamp(), packets.size());
+    sendsCount++;
+}
+
+void Game::queuePacket(Side side, Packet packet)
+{
+    getPlayerFrame(side).outbox.push_back(std::move(packet));
+}
+
+void Game::queueSpectatorPacket(Packet packet)
+{
+    // nothing is built for the spectators of a game nobody watches
+    if (spectatorsCount) {
+        spectatorOutbox.push_back(std::move(packet));
+    }
+}
+
+void Game::publishSpectatorFrame()
+{
+    if (spectatorOutbox.empty()) {
+        return;
+    }
+
+    bool essential = std::any_of(spectatorOutbox.begin(), spectatorOutbox.end(), [](const Packet &packet) {
+        return packet.getType() != "player_state";
+    });
+
+    // serialized once, the broadcaster sends the same buffer to all the spectators
+    app.getSpectatorBroadcaster().publishFrame(
+        uid, SpectatorBroadcaster::serialize(spectatorOutbox), spectatorOutbox.size(), essential);
+
+    spectatorOutbox.clear();
+}
+
+void Game::markPlayerUpdated(Side side, bool accepted)
+{
+    PlayerFrame &frame = getPlayerFrame(side);
+    const PlayerState &state = getPlayerState(side);
+    const PlayerState &broadcast = frame.broadcastState;
+
+    if (accepted) {
+        // the opponent extrapolates from the last broadcast state, send only what it can not predict
+        Position predicted = expectedPlayerPosition(
+            broadcast.position(), broadcast.direction(), state.timestamp() - broadcast.timestamp());
+
+        frame.changed |= state.direction() != broadcast.direction() || state.position() != predicted;
+    } else {
+        // the player has to be corrected by its authoritative state
+        frame.resync = true;
+    }
+
+    if ((frame.changed || frame.resync) && !frame.trace) {
+        frame.trace = Tracer::currentTrace();
+    }
+
+    if ((frame.changed || frame.resync) && !framePending) {
+        framePending = true;
+        nextFrameAt = std::max(app.getCoarseTimestamp(), lastFrameAt + broadcastPeriod);
+        reschedule();
+    }
+}
+
+void Game::flushFrame()
+{
+    // the frame is sent on behalf of the first traced update it carries
+    uint64_t trace = Tracer::currentTrace();
+
+    for (Side side : {Side::Left, Side::Right}) {
+        if (!trace) {
+            trace = getPlayerFrame(side).trace;
+        }
+        getPlayerFrame(side).trace = 0;
+    }
+
+    Tracer::Context context{trace};
+    TraceSpan span{app.getTracer(), "frame"};
+
+    for (Side side : {Side::Left, Side::Right}) {
+        PlayerFrame &frame = getPlayerFrame(side);
+        Side opponentSide = side == Side::Left ? Side::Right : Side::Left;
+        const PlayerState &state = getPlayerState(side);
+
+        if (frame.changed) {
+            queuePacket(side, Packet{"your_state", state.itemize()});
+            queuePacket(opponentSide, Packet{"opponent_state", state.itemize()});
+            frame.broadcastState = state;
+
+            Packet packetState{"player_state", {sideToStr(side)}};
+            packetState.addItems(state.itemize());
+            queueSpectatorPacket(packetState);
+        } else if (frame.resync) {
+            queuePacket(side, Packet{"your_state", state.itemize()});
+        }
+
+        frame.changed = false;
+        frame.resync = false;
+    }
+
+    // everything queued for one player during the frame goes out in a single send
+    for (Side side : {Side::Left, Side::Right}) {
+        PlayerFrame &frame = getPlayerFrame(side);
+
+        if (frame.outbox.empty()) {
+            continue;
+        }
+
+        sendPackets(getPlayerUid(side), frame.outbox);
+        frame.outbox.clear();
+    }
+
+    publishSpectatorFrame();
+
+    framePending = false;
+    lastFrameAt = app.getCoarseTimestamp();
+}
+
+void Game::reschedule()
+{
+    timer.wake();
+}
+
+Timestamp Game::nextWakeUp(Timestamp now)
+{
+    Timestamp wakeUpAt = now + IDLE_WAKEUP_PERIOD;
+
+    if (gamePhase == GamePhase::Playing) {
+        wakeUpAt = std::min(wakeUpAt, resolutionAt());
+    }
+
+    if (framePending) {
+        wakeUpAt = std::min(wakeUpAt, nextFrameAt);
+    }
+
+    return wakeUpAt;
+}
+
+bool Game::isRecording()
+{
+    return app.getReplayRecorder().isEnabled();
+}
+
+void Game::record(const ReplayEvent &event)
+{
+    if (isRecording()) {
+        app.getReplayRecorder().record(uid, event);
+    }
 }
 
 Uid Game::getUid()
@@ -164,8 +334,102 @@ Uid Game::getPlayerUid(Side side)
     }
 }
 
+GamePhase Game::getPhase()
+{
+    return gamePhase;
+}
+
+BallState Game::getFutureBallState()
+{
+    auto lock = acquireLock();
+    return futureBallState;
+}
+
+PlayerState Game::getPlayerStateAt(Side side, Timestamp timestamp)
+{
+    auto lock = acquireLock();
+    return playerStateAt(side, timestamp);
+}
+
+Score Game::getPlayerScore(Side side)
+{
+    return getScore(side);
+}
+
+double Game::getSendRate()
+{
+    return sendRate.get(app.getCoarseTimestamp(), createdAt);
+}
+
+double Game::getUpdateRate()
+{
+    return updateRate.get(app.getCoarseTimestamp(), createdAt);
+}
+
+uint64_t Game::getRalliesCount()
+{
+    return ralliesCount;
+}
+
+int64_t Game::getMeanLateness()
+{
+    uint64_t count = resolutionsCount;
+    return count ? latenessSum / static_cast<int64_t>(count) : 0;
+}
+
+int64_t Game::getMaxLateness()
+{
+    return latenessMax;
+}
+
+void Game::seed(unsigned seed)
+{
+    auto lock = acquireLock();
+    randomGenerator.seed(seed);
+
+    record(ReplayEvent::of(ReplayEventType::Seed, app.getCurrentTimestamp(), static_cast<int32_t>(seed)));
+}
+
+void Game::update(Timestamp now)
+{
+    if (gamePhase == GamePhase::Playing) {
+        // check whether the ball reached the side
+        if (resolutionAt() <= now) {
+
+            // the ball resolution is not caused by any packet, it starts its own trace
+            Tracer::Context context{app.getTracer().newTrace()};
+            TraceSpan span{app.getTracer(), "resolve"};
+
+            Clock &clock = app.getClock();
+            int64_t intendedAt = clock.toMonotonic(resolutionAt()) * 1000;
+            int64_t lateness = clock.monotonicMicros() - intendedAt;
+            app.getStats().recordResolutionLateness(lateness);
+
+            // only this thread resolves, no compare and swap needed
+            resolutionsCount.fetch_add(1, std::memory_order_relaxed);
+            latenessSum.fetch_add(lateness, std::memory_order_relaxed);
+            if (lateness > latenessMax.load(std::memory_order_relaxed)) {
+                latenessMax.store(lateness, std::memory_order_relaxed);
+            }
+
+            // get player on turn as it was when the ball arrived
+            PlayerState expectedState = playerStateAt(futureBallState.side(), futureBallState.timestamp());
+
+            // calculate hit
+            if (canHit(expectedState, futureBallState)) {
+                eventBallHit();
+            } else {
+                eventBallMiss(futureBallState.side() == Side::Left ? Side::Right : Side::Left);
+            }
+        }
+    }
+
+    eventFrame(now);
+}
+
 void Game::eventPlayerJoin(Uid uid)
 {
+    TraceSpan span{app.getTracer(), "join", uid};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::New) {
@@ -180,6 +444,8 @@ void Game::eventPlayerJoin(Uid uid)
         throw AlreadyInGameException("player " + std::to_string(uid) + " is already in game " + std::to_string(this->uid));
     }
 
+    record(ReplayEvent::of(ReplayEventType::Join, app.getCurrentTimestamp(), uid));
+
     Packet packetJoined{"joined"};
 
     if (playerUidLeft == -1) {
@@ -189,6 +455,9 @@ void Game::eventPlayerJoin(Uid uid)
 
         sendPacket(playerUidLeft, packetJoined);
 
+        queueSpectatorPacket(Packet{"player_joined", {sideToStr(Side::Left), app.getNickname(uid)}});
+        publishSpectatorFrame();
+
     } else if (playerUidRight == -1) {
 
         playerUidRight = uid;
@@ -206,21 +475,30 @@ void Game::eventPlayerJoin(Uid uid)
         sendPacket(playerUidLeft, packetNewRound);
         sendPacket(playerUidRight, packetNewRound);
 
+        queueSpectatorPacket(Packet{"player_joined", {sideToStr(Side::Right), app.getNickname(uid)}});
+        queueSpectatorPacket(packetNewRound);
+        publishSpectatorFrame();
+
         gamePhase = GamePhase::Waiting;
     }
 }
 
 void Game::eventPlayerReady(Uid uid)
 {
+    TraceSpan span{app.getTracer(), "ready", uid};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::Waiting) {
         throw GamePhaseException("can not accept ready in playing phase");
     }
 
+    Timestamp now = app.getCurrentTimestamp();
+    Side side = getPlayerSide(uid);
     Packet packetOpponentReady{"opponent_ready"};
 
-    switch (getPlayerSide(uid)) {
+    record(ReplayEvent::of(ReplayEventType::Ready, now, side, PlayerState{}));
+
+    switch (side) {
     case Side::Left: {
         playerReadyLeft = true;
         sendPacket(playerUidRight, packetOpponentReady);
@@ -233,11 +511,13 @@ void Game::eventPlayerReady(Uid uid)
     }
     }
 
+    queueSpectatorPacket(Packet{"player_ready", {sideToStr(side)}});
+
     if (playerReadyLeft && playerReadyRight) {
         gamePhase = GamePhase::Playing;
 
         ballState = BallState{
-            app.getCurrentTimestamp() + START_DELAY,
+            now + START_DELAY,
             serviceSide == Side::Left ? Side::Right : Side::Left,
             0,
             0,
@@ -245,73 +525,122 @@ void Game::eventPlayerReady(Uid uid)
 
         futureBallState = nextBallState(ballState, true, serviceSide);
 
+        record(ReplayEvent::of(ReplayEventType::Serve, now, futureBallState));
+
         Packet packetBallReleased{"ball_released", ballState.itemize()};
 
         sendPacket(playerUidLeft, packetBallReleased);
         sendPacket(playerUidRight, packetBallReleased);
 
-        notifyOne();
+        queueSpectatorPacket(packetBallReleased);
+        publishSpectatorFrame();
+
+        reschedule();
         return;
     }
+
+    publishSpectatorFrame();
 }
 
-void Game::eventPlayerUpdate(Uid uid, PlayerState newPlayerState)
+bool Game::eventPlayerUpdate(Uid uid, PlayerState newPlayerState, Timestamp jitter)
 {
+    TraceSpan span{app.getTracer(), "update", uid};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::Playing && gamePhase != GamePhase::Waiting) {
         throw GamePhaseException("can not update player while not playing");
     }
 
-    if (isInPast(newPlayerState.timestamp())) {
+    Timestamp now = app.getCoarseTimestamp();
+    Side side = getPlayerSide(uid);
+    PlayerState &currentState = getPlayerState(side);
+    bool accepted{false};
+
+    updateRate.add(now);
+
+    // the delay follows a rise at once so the next resolution waits for late states, and decays slowly
+    Timestamp &inputDelay = getInputDelay(side);
+    Timestamp delay = std::max<Timestamp>(0, now - newPlayerState.timestamp());
+    inputDelay = delay > inputDelay ? delay : inputDelay + (delay - inputDelay) / 8;
 
-        PlayerState &currentState = getPlayerState(uid);
-        PlayerState expected = expectedPlayerState(currentState, newPlayerState.timestamp());
+    if (isInPast(newPlayerState.timestamp(), now, jitter) && newPlayerState.timestamp() > currentState.timestamp()) {
+
+        PlayerState expected = playerStateAt(side, newPlayerState.timestamp());
 
         if (std::abs(newPlayerState.position() - expected.position()) < POSITION_THRESHOLD) {
             currentState = newPlayerState;
+            getPlayerHistory(side).record(newPlayerState);
+            accepted = true;
         }
     }
 
-    sendPacket(uid, Packet{"your_state", getPlayerState(uid).itemize()});
-    sendPacket(getOpponent(uid), Packet{"opponent_state", getPlayerState(uid).itemize()});
+    if (isRecording()) {
+        ReplayEvent event = ReplayEvent::of(ReplayEventType::Update, now, side, newPlayerState);
+        event.value = static_cast<int32_t>(jitter);
+        event.flags = accepted;
+        record(event);
+    }
+
+    // states are not echoed per update, they are broadcast once per frame
+    markPlayerUpdated(side, accepted);
+
+    return accepted;
 }
 
 void Game::eventPlayerLeave(Uid uid)
 {
+    TraceSpan span{app.getTracer(), "leave", uid};
     auto lock = acquireLock();
 
     sendPacket(getOpponent(uid), Packet{"opponent_left"});
     sendPacket(uid, Packet{"left"});
 
+    record(ReplayEvent::of(ReplayEventType::Leave, app.getCurrentTimestamp(), getPlayerSide(uid), PlayerState{}));
+
+    queueSpectatorPacket(Packet{"player_left", {sideToStr(getPlayerSide(uid))}});
+    publishSpectatorFrame();
+
     playerUidLeft = -1;
     playerUidRight = -1;
 
     gamePhase = GamePhase::End;
-    notifyOne();
+    reschedule();
 
     stop(false);
 }
 
 void Game::eventBallHit()
 {
+    TraceSpan span{app.getTracer(), "hit"};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::Playing) {
         throw GamePhaseException("can not hit ball while not playing");
     }
 
+    Position paddle{0};
+    if (isRecording()) {
+        paddle = playerStateAt(futureBallState.side(), futureBallState.timestamp()).position();
+    }
+
     ballState = futureBallState;
     futureBallState = nextBallState(ballState, false);
+    ralliesCount.fetch_add(1, std::memory_order_relaxed);
+
+    record(ReplayEvent::of(ReplayEventType::Hit, app.getCurrentTimestamp(), futureBallState, paddle));
 
     Packet packet{"ball_hit", ballState.itemize()};
 
-    sendPacket(playerUidLeft, packet);
-    sendPacket(playerUidRight, packet);
+    // coalesced with the pending states of this frame
+    queuePacket(Side::Left, packet);
+    queuePacket(Side::Right, packet);
+    queueSpectatorPacket(packet);
+    flushFrame();
 }
 
 void Game::eventBallMiss(Side winner)
 {
+    TraceSpan span{app.getTracer(), "miss"};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::Playing) {
@@ -319,6 +648,15 @@ void Game::eventBallMiss(Side winner)
     }
 
     getScore(winner)++;
+
+    if (isRecording()) {
+        Position paddle = playerStateAt(futureBallState.side(), futureBallState.timestamp()).position();
+        ReplayEvent event = ReplayEvent::of(ReplayEventType::Miss, app.getCurrentTimestamp(), futureBallState, paddle);
+        event.side = static_cast<uint8_t>(winner);
+        event.value = scoreLeft << 16 | scoreRight;
+        record(event);
+    }
+
     playerReadyLeft = false;
     playerReadyRight = false;
     serviceSide = winner == Side::Left ? Side::Right : Side::Left;
@@ -330,8 +668,10 @@ void Game::eventBallMiss(Side winner)
         packet.addItem(scoreToStr(scoreLeft));
         packet.addItem(scoreToStr(scoreRight));
 
-        sendPacket(playerUidLeft, packet);
-        sendPacket(playerUidRight, packet);
+        queuePacket(Side::Left, packet);
+        queuePacket(Side::Right, packet);
+        queueSpectatorPacket(packet);
+        flushFrame();
         return;
     }
 
@@ -341,21 +681,27 @@ void Game::eventBallMiss(Side winner)
     packet.addItem(scoreToStr(scoreLeft));
     packet.addItem(scoreToStr(scoreRight));
 
-    sendPacket(playerUidLeft, packet);
-    sendPacket(playerUidRight, packet);
+    queuePacket(Side::Left, packet);
+    queuePacket(Side::Right, packet);
+    queueSpectatorPacket(packet);
+    flushFrame();
 }
 
 void Game::eventPlayerRestart(Uid uid)
 {
+    TraceSpan span{app.getTracer(), "restart", uid};
     auto lock = acquireLock();
 
     if (gamePhase != GamePhase::GameOver) {
         throw GamePhaseException("can not accept ready in playing phase");
     }
 
+    Side side = getPlayerSide(uid);
     Packet packetOpponentReady{"opponent_ready"};
 
-    switch (getPlayerSide(uid)) {
+    record(ReplayEvent::of(ReplayEventType::Restart, app.getCurrentTimestamp(), side, PlayerState{}));
+
+    switch (side) {
     case Side::Left: {
         playerReadyLeft = true;
         sendPacket(playerUidRight, packetOpponentReady);
@@ -368,6 +714,8 @@ void Game::eventPlayerRestart(Uid uid)
     }
     }
 
+    queueSpectatorPacket(Packet{"player_ready", {sideToStr(side)}});
+
     if (playerReadyLeft && playerReadyRight) {
         gamePhase = GamePhase::Waiting;
         playerReadyLeft = false;
@@ -381,7 +729,86 @@ void Game::eventPlayerRestart(Uid uid)
 
         sendPacket(playerUidLeft, packetNewRound);
         sendPacket(playerUidRight, packetNewRound);
+
+        queueSpectatorPacket(packetNewRound);
+    }
+
+    publishSpectatorFrame();
+}
+
+void Game::eventSpectatorJoin(Uid uid)
+{
+    TraceSpan span{app.getTracer(), "spectator join", uid};
+    auto lock = acquireLock();
+
+    // the broadcaster would never hear of this game again
+    if (spectatorsClosed) {
+        throw GameNotExistsException{"game " + std::to_string(this->uid) + " already ended"};
+    }
+
+    spectatorsCount++;
+
+    // the spectator starts from a snapshot, the following frames continue from it
+    std::vector<Packet> snapshot;
+    Packet packetSpectating{"spectating", {std::to_string(this->uid)}};
+
+    for (Side side : {Side::Left, Side::Right}) {
+        std::string nickname;
+
+        try {
+            nickname = getPlayerUid(side) != -1 ? app.getNickname(getPlayerUid(side)) : "";
+        }
+        catch (NoNicknameException &exception) {
+            // the player is just leaving
+        }
+
+        packetSpectating.addItem(nickname);
+    }
+
+    packetSpectating.addItem(scoreToStr(scoreLeft));
+    packetSpectating.addItem(scoreToStr(scoreRight));
+    snapshot.push_back(packetSpectating);
+
+    if (gamePhase == GamePhase::Playing) {
+        snapshot.push_back(Packet{"ball_state", ballState.itemize()});
+    }
+
+    for (Side side : {Side::Left, Side::Right}) {
+        Packet packetState{"player_state", {sideToStr(side)}};
+        packetState.addItems(getPlayerState(side).itemize());
+        snapshot.push_back(packetState);
+    }
+
+    app.getSpectatorBroadcaster().addSpectator(this->uid, uid, SpectatorBroadcaster::serialize(snapshot));
+}
+
+void Game::eventSpectatorLeave(Uid uid)
+{
+    TraceSpan span{app.getTracer(), "spectator leave", uid};
+    auto lock = acquireLock();
+
+    if (spectatorsCount) {
+        spectatorsCount--;
     }
+
+    app.getSpectatorBroadcaster().removeSpectator(uid);
+    sendPacket(uid, Packet{"left"});
+}
+
+bool Game::eventFrame(Timestamp now)
+{
+    auto lock = acquireLock();
+
+    if (framePending && nextFrameAt <= now) {
+        flushFrame();
+    }
+
+    return framePending;
+}
+
+void Game::before()
+{
+    timer.open();
 }
 
 void Game::run()
@@ -390,33 +817,35 @@ void Game::run()
 
     while (!shouldStop()) {
 
-        auto nextUpdateAt = std::chrono::system_clock::now();
+        Timestamp now = app.getCurrentTimestamp();
 
-        if (gamePhase == GamePhase::Playing) {
-            // check whether the ball reached the side
-            if ((futureBallState.timestamp() - app.getCurrentTimestamp()) < 0 + TIME_THRESHOLD.count()) {
+        update(now);
 
-                // get player on turn
-                PlayerState playerState = getPlayerState(futureBallState.side());
-                PlayerState expectedState = expectedPlayerState(playerState, app.getCurrentTimestamp());
+        // sleep until the ball arrives or the next frame is due, events wake the timer up earlier
+        Timestamp wakeUpAt;
+        {
+            auto lock = acquireLock();
+            wakeUpAt = nextWakeUp(now);
+        }
 
-                // calculate hit
-                if (canHit(expectedState, futureBallState)) {
-                    eventBallHit();
-                } else {
-                    eventBallMiss(futureBallState.side() == Side::Left ? Side::Right : Side::Left);
-                }
-            }
+        Clock &clock = app.getClock();
+        timer.waitFor(std::chrono::microseconds{clock.toMonotonic(wakeUpAt) * 1000 - clock.monotonicMicros()});
+    }
 
-            nextUpdateAt += std::chrono::milliseconds{ballState.timestamp() - app.getCurrentTimestamp()};
-        } else {
-            nextUpdateAt += std::chrono::seconds{10};
-        }
+}
 
-        auto lock = acquireLock();
-        waitUntil(lock, nextUpdateAt, [this] { return gamePhase == GamePhase::Playing; });
+bool Game::stop(bool wait)
+{
+    bool running = Thread::stop(false);
+
+    // the stop flag is set, break the timer wait
+    timer.wake();
+
+    if (wait) {
+        return join();
     }
 
+    return running;
 }
 
 void Game::after()
@@ -425,5 +854,18 @@ void Game::after()
     sendPacket(playerUidLeft, packet);
     sendPacket(playerUidRight, packet);
 
+    {
+        auto lock = acquireLock();
+
+        queueSpectatorPacket(packet);
+        publishSpectatorFrame();
+        app.getSpectatorBroadcaster().closeGame(uid);
+        spectatorsClosed = true;
+    }
+
+    if (isRecording()) {
+        app.getReplayRecorder().close(uid);
+    }
+
     app.notifyOne();
 }
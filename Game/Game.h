@@ -7,8 +7,12 @@
 #include "GameTypes.h"
 #include "BallState.h"
 #include "PlayerState.h"
+#include "PlayerStateHistory.h"
+#include "Replay.h"
 #include "../Types.h"
 #include "../Utils/Thread.h"
+#include "../Utils/Timer.h"
+#include "../Utils/WindowedRate.h"
 #include "../Network/Packet.h"
 
 class App;
@@ -19,8 +23,22 @@ public:
     const std::chrono::seconds DEFAULT_UPDATE_PERIOD{60};
     const std::chrono::milliseconds TIME_THRESHOLD{50};
     const Position POSITION_THRESHOLD{10};
+    const Timestamp IDLE_WAKEUP_PERIOD{10000};
+    const std::chrono::microseconds TIMER_SLACK{0};
+    const Timestamp MAX_LAG_COMPENSATION{150};
 
 private:
+    struct PlayerFrame
+    {
+        PlayerState broadcastState;
+        bool changed{false};
+        bool resync{false};
+        std::vector<Packet> outbox;
+
+        // the update which made the frame pending, its trace follows the broadcast
+        uint64_t trace{0};
+    };
+
     App &app;
     Uid uid;
 
@@ -29,6 +47,20 @@ private:
     BallState futureBallState;
     PlayerState playerStateLeft;
     PlayerState playerStateRight;
+    PlayerStateHistory playerHistoryLeft;
+    PlayerStateHistory playerHistoryRight;
+
+    // how late the states of the player reach the server, the ball waits for them before it is judged
+    Timestamp inputDelayLeft;
+    Timestamp inputDelayRight;
+
+    PlayerFrame playerFrameLeft;
+    PlayerFrame playerFrameRight;
+    std::vector<Packet> spectatorOutbox;
+    size_t spectatorsCount;
+
+    // the spectator stream is closed, nobody can start watching any more
+    bool spectatorsClosed;
     Uid playerUidLeft;
     Uid playerUidRight;
 
@@ -41,24 +73,58 @@ private:
     Score scoreLeft;
     Score scoreRight;
 
+    Timestamp createdAt;
+    Timestamp broadcastPeriod;
+    Timestamp lastFrameAt;
+    Timestamp nextFrameAt;
+    bool framePending;
+
+    Timer timer;
+
+    WindowedRate sendRate;
+    std::atomic<uint64_t> sendsCount;
+    std::atomic<uint64_t> ralliesCount;
+    WindowedRate updateRate;
+    std::atomic<uint64_t> resolutionsCount;
+    std::atomic<int64_t> latenessSum;
+    std::atomic<int64_t> latenessMax;
+
     std::default_random_engine randomGenerator;
     std::uniform_int_distribution<Angle> randomAngle{ANGLE_MIN, ANGLE_MAX};
     std::uniform_int_distribution<Speed> randomSpeed{BALL_SPEED_MIN, BALL_SPEED_MAX};
 
     PlayerState expectedPlayerState(const PlayerState &state, Timestamp timestamp);
+    PlayerState playerStateAt(Side side, Timestamp timestamp);
     BallState nextBallState(BallState &state, bool fromCenter, Side toSide = Side::Left);
     bool canHit(const PlayerState &playerState, const BallState &BallState);
-    bool isInPast(Timestamp timestamp);
+    bool isInPast(Timestamp timestamp, Timestamp now, Timestamp jitter = 0);
+    Timestamp resolutionAt();
 
     Score &getScore(Side side);
     Score &getScore(Uid uid);
     PlayerState &getPlayerState(Side side);
     PlayerState &getPlayerState(Uid uid);
+    PlayerStateHistory &getPlayerHistory(Side side);
+    Timestamp &getInputDelay(Side side);
+    PlayerFrame &getPlayerFrame(Side side);
     BallState &getBallState();
     Side getPlayerSide(Uid uid);
     Uid getOpponent(Uid uid);
 
-    void sendPacket(Uid uid, Packet packet);
+    void queuePacket(Side side, Packet packet);
+    void queueSpectatorPacket(Packet packet);
+    void publishSpectatorFrame();
+    void markPlayerUpdated(Side side, bool accepted);
+    void flushFrame();
+    void reschedule();
+    Timestamp nextWakeUp(Timestamp now);
+
+    bool isRecording();
+    void record(const ReplayEvent &event);
+
+protected:
+    virtual void sendPacket(Uid uid, Packet packet);
+    virtual void sendPackets(Uid uid, const std::vector<Packet> &packets);
 
 public:
 
@@ -66,16 +132,34 @@ public:
 
     Uid getUid();
     Uid getPlayerUid(Side side);
+    GamePhase getPhase();
+    BallState getFutureBallState();
+    PlayerState getPlayerStateAt(Side side, Timestamp timestamp);
+    Score getPlayerScore(Side side);
+    // per second over the last seconds, see WindowedRate
+    double getSendRate();
+    double getUpdateRate();
+    uint64_t getRalliesCount();
+    int64_t getMeanLateness();
+    int64_t getMaxLateness();
+
+    void seed(unsigned seed);
+    void update(Timestamp now);
 
     void eventPlayerJoin(Uid uid);
     void eventPlayerReady(Uid uid);
-    void eventPlayerUpdate(Uid uid, PlayerState playerState);
+    bool eventPlayerUpdate(Uid uid, PlayerState playerState, Timestamp jitter = 0);
     void eventPlayerLeave(Uid uid);
     void eventBallHit();
     void eventBallMiss(Side winner);
     void eventPlayerRestart(Uid uid);
+    void eventSpectatorJoin(Uid uid);
+    void eventSpectatorLeave(Uid uid);
+    bool eventFrame(Timestamp now);
 
+    void before() override;
     void run() override;
+    bool stop(bool wait) override;
     void after() override;
 };
 
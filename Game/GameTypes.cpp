@@ -6,7 +6,7 @@ bool isValidPlayerPosition(int position)
     return position <= PLAYER_POSITION_MAX && position >= PLAYER_POSITION_MIN;
 }
 
-Timestamp strToTimestamp(std::string &str)
+Timestamp strToTimestamp(const std::string &str)
 {
     long long timestamp;
 
@@ -20,7 +20,7 @@ Timestamp strToTimestamp(std::string &str)
     return static_cast<Timestamp>(timestamp);
 }
 
-Position strToPlayerPosition(std::string &str)
+Position strToPlayerPosition(const std::string &str)
 {
     int position;
 
@@ -38,7 +38,7 @@ Position strToPlayerPosition(std::string &str)
     return static_cast<Position>(position);
 }
 
-PlayerDirection strToPlayerDirection(std::string &str)
+PlayerDirection strToPlayerDirection(const std::string &str)
 {
     if (str == "up") {
         return PlayerDirection::Up;
@@ -57,9 +57,9 @@ const Score MAX_SCORE{UINT8_MAX};
 
 bool isValidPlayerPosition(int position);
 
-Timestamp strToTimestamp(std::string &str);
-Position strToPlayerPosition(std::string &str);
-PlayerDirection strToPlayerDirection(std::string &str);
+Timestamp strToTimestamp(const std::string &str);
+Position strToPlayerPosition(const std::string &str);
+PlayerDirection strToPlayerDirection(const std::string &str);
 
 std::string timestampToStr(Timestamp timestamp);
 std::string sideToStr(Side playerSide);
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Physics.h"
+
+namespace
+{
+// keeps relative timestamps and their differences inside of the 32 bit lanes
+const int64_t RELATIVE_LIMIT{int64_t{1} << 29};
+const float PLAYER_REACH{PLAYER_HEIGHT / 2};
+}
+
+float playerVelocity(PlayerDirection direction)
+{
+    switch (direction) {
+    case PlayerDirection::Up: return PLAYER_SPEED_PER_MS;
+    case PlayerDirection::Down: return -PLAYER_SPEED_PER_MS;
+    case PlayerDirection::Stop: return 0;
+    }
+
+    return 0;
+}
+
+Position expectedPlayerPosition(Position position, PlayerDirection direction, Timestamp elapsed)
+{
+    elapsed = std::max(-2 * RELATIVE_LIMIT, std::min(2 * RELATIVE_LIMIT, elapsed));
+
+    // same float operations as the vector kernel, so that both give the same results
+    auto moved = static_cast<int32_t>(position + playerVelocity(direction) * static_cast<float>(elapsed));
+
+    if (moved > PLAYER_POSITION_MAX) {
+        moved = PLAYER_POSITION_MAX;
+    } else if (moved < PLAYER_POSITION_MIN) {
+        moved = PLAYER_POSITION_MIN;
+    }
+
+    return static_cast<Position>(moved);
+}
+
+BallState ballArrival(const BallState &state, bool fromCenter, Side toSide)
+{
+    double movementWidth = GAME_WIDTH - 2 * BALL_RADIUS;
+    double movementHeight = GAME_HEIGHT - 2 * BALL_RADIUS;
+    double radians = M_PI / 180.0 * state.angle();
+    double halfWidth = movementWidth / 2.0;
+    double halfHeight = movementHeight / 2.0;
+
+    double width = fromCenter ? halfWidth : movementWidth;
+
+    double hypotenuse = width / std::cos(std::abs(radians));
+
+    auto hLeg = static_cast<long>(std::tan(radians) * width);
+
+    double timestamp = hypotenuse / (state.speed() / 1000.0);
+    timestamp += state.timestamp();
+
+    double y = (radians < 0 ? -1 : 1 ) * (hLeg + state.position()) + halfHeight;
+    int mod = static_cast<int>(y) % static_cast<int>(movementHeight);
+    int n = static_cast<int>(y / movementHeight + (radians < 0 ? 1 : 0));
+
+    switch (n % 2) {
+    case 0: {
+        y = mod;
+        break;
+    }
+    case 1: {
+        y = static_cast<int>(movementHeight - mod);
+        break;
+    }
+    }
+
+    y -= halfHeight;
+
+    return {
+        static_cast<Timestamp>(timestamp),
+        fromCenter
+        ? toSide
+        : state.side() == Side::Left ? Side::Right : Side::Left,
+        static_cast<Position>(y),
+        0,
+        0};
+}
+
+bool canHitBall(Position playerPosition, Position ballPosition)
+{
+    return ballPosition <= playerPosition + (PLAYER_HEIGHT / 2)
+        && ballPosition >= playerPosition - (PLAYER_HEIGHT / 2);
+}
+
+const int32_t PhysicsBatch::IDLE;
+
+PhysicsBatch::PhysicsBatch(Timestamp epoch)
+    : epoch{epoch}
+{}
+
+int32_t PhysicsBatch::relative(Timestamp timestamp) const
+{
+    return static_cast<int32_t>(std::max(-RELATIVE_LIMIT, std::min(RELATIVE_LIMIT, timestamp - epoch)));
+}
+
+size_t PhysicsBatch::add()
+{
+    dueAt.push_back(IDLE);
+    ballPosition.push_back(0);
+    playerTimestamp.push_back(0);
+    playerPosition.push_back(0);
+    playerVelocity.push_back(0);
+
+    return dueAt.size() - 1;
+}
+
+size_t PhysicsBatch::size() const
+{
+    return dueAt.size();
+}
+
+void PhysicsBatch::reserve(size_t capacity)
+{
+    dueAt.reserve(capacity);
+    ballPosition.reserve(capacity);
+    playerTimestamp.reserve(capacity);
+    playerPosition.reserve(capacity);
+    playerVelocity.reserve(capacity);
+}
+
+void PhysicsBatch::setBall(size_t index, const BallState &futureBallState)
+{
+    dueAt[index] = relative(futureBallState.timestamp());
+    ballPosition[index] = futureBallState.position();
+}
+
+void PhysicsBatch::setPlayer(size_t index, const PlayerState &playerState)
+{
+    playerTimestamp[index] = relative(playerState.timestamp());
+    playerPosition[index] = playerState.position();
+    playerVelocity[index] = ::playerVelocity(playerState.direction());
+}
+
+void PhysicsBatch::setIdle(size_t index)
+{
+    dueAt[index] = IDLE;
+}
+
+size_t PhysicsBatch::resolveScalar(size_t from, int32_t limit, std::vector<Resolution> &resolutions) const
+{
+    size_t count{0};
+
+    for (size_t i = from; i < dueAt.size(); ++i) {
+        if (dueAt[i] >= limit) {
+            continue;
+        }
+
+        auto position = static_cast<float>(static_cast<int32_t>(
+            playerPosition[i] + playerVelocity[i] * static_cast<float>(dueAt[i] - playerTimestamp[i])));
+        position = std::max(static_cast<float>(PLAYER_POSITION_MIN),
+                            std::min(static_cast<float>(PLAYER_POSITION_MAX), position));
+
+        resolutions.push_back({i, std::abs(ballPosition[i] - position) <= PLAYER_REACH});
+        count++;
+    }
+
+    return count;
+}
+
+#if defined(__AVX2__)
+
+size_t PhysicsBatch::resolveVector(int32_t limit, std::vector<Resolution> &resolutions) const
+{
+    const __m256i limitLanes = _mm256_set1_epi32(limit);
+    const __m256 minLanes = _mm256_set1_ps(PLAYER_POSITION_MIN);
+    const __m256 maxLanes = _mm256_set1_ps(PLAYER_POSITION_MAX);
+    const __m256 reachLanes = _mm256_set1_ps(PLAYER_REACH);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    size_t count{0};
+    size_t i{0};
+
+    for (; i + 8 <= dueAt.size(); i += 8) {
+        __m256i dueAtLanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&dueAt[i]));
+        __m256i due = _mm256_cmpgt_epi32(limitLanes, dueAtLanes);
+        int dueMask = _mm256_movemask_ps(_mm256_castsi256_ps(due));
+
+        if (!dueMask) {
+            continue;
+        }
+
+        __m256i elapsed = _mm256_sub_epi32(
+            dueAtLanes, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&playerTimestamp[i])));
+        __m256 moved = _mm256_add_ps(
+            _mm256_loadu_ps(&playerPosition[i]),
+            _mm256_mul_ps(_mm256_loadu_ps(&playerVelocity[i]), _mm256_cvtepi32_ps(elapsed)));
+        __m256 position = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(moved));
+        position = _mm256_max_ps(minLanes, _mm256_min_ps(maxLanes, position));
+
+        __m256 distance = _mm256_and_ps(absMask, _mm256_sub_ps(_mm256_loadu_ps(&ballPosition[i]), position));
+        int hitMask = _mm256_movemask_ps(_mm256_cmp_ps(distance, reachLanes, _CMP_LE_OQ));
+
+        for (int lane = 0; lane < 8; ++lane) {
+            if (dueMask & (1 << lane)) {
+                resolutions.push_back({i + lane, (hitMask & (1 << lane)) != 0});
+                count++;
+            }
+        }
+    }
+
+    return count + resolveScalar(i, limit, resolutions);
+}
+
+#elif defined(__SSE2__)
+
+size_t PhysicsBatch::resolveVector(int32_t limit, std::vector<Resolution> &resolutions) const
+{
+    const __m128i limitLanes = _mm_set1_epi32(limit);
+    const __m128 minLanes = _mm_set1_ps(PLAYER_POSITION_MIN);
+    const __m128 maxLanes = _mm_set1_ps(PLAYER_POSITION_MAX);
+    const __m128 reachLanes = _mm_set1_ps(PLAYER_REACH);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    size_t count{0};
+    size_t i{0};
+
+    for (; i + 4 <= dueAt.size(); i += 4) {
+        __m128i dueAtLanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&dueAt[i]));
+        __m128i due = _mm_cmpgt_epi32(limitLanes, dueAtLanes);
+        int dueMask = _mm_movemask_ps(_mm_castsi128_ps(due));
+
+        if (!dueMask) {
+            continue;
+        }
+
+        __m128i elapsed = _mm_sub_epi32(
+            dueAtLanes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&playerTimestamp[i])));
+        __m128 moved = _mm_add_ps(
+            _mm_loadu_ps(&playerPosition[i]),
+            _mm_mul_ps(_mm_loadu_ps(&playerVelocity[i]), _mm_cvtepi32_ps(elapsed)));
+        __m128 position = _mm_cvtepi32_ps(_mm_cvttps_epi32(moved));
+        position = _mm_max_ps(minLanes, _mm_min_ps(maxLanes, position));
+
+        __m128 distance = _mm_and_ps(absMask, _mm_sub_ps(_mm_loadu_ps(&ballPosition[i]), position));
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(distance, reachLanes));
+
+        for (int lane = 0; lane < 4; ++lane) {
+            if (dueMask & (1 << lane)) {
+                resolutions.push_back({i + lane, (hitMask & (1 << lane)) != 0});
+                count++;
+            }
+        }
+    }
+
+    return count + resolveScalar(i, limit, resolutions);
+}
+
+#else
+
+size_t PhysicsBatch::resolveVector(int32_t limit, std::vector<Resolution> &resolutions) const
+{
+    return resolveScalar(0, limit, resolutions);
+}
+
+#endif
+
+size_t PhysicsBatch::resolve(Timestamp now, Timestamp threshold, std::vector<Resolution> &resolutions) const
+{
+    // a row is due when its ball arrives until now + threshold, same as in Game::run
+    int32_t limit = relative(now + threshold) + 1;
+
+    return resolveVector(limit, resolutions);
+}
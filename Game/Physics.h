@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GameTypes.h"
+#include "BallState.h"
+#include "PlayerState.h"
+
+// paddle movement per millisecond, shared by the scalar and the vector paths
+const float PLAYER_SPEED_PER_MS{PLAYER_SPEED / 1000.0f};
+
+float playerVelocity(PlayerDirection direction);
+Position expectedPlayerPosition(Position position, PlayerDirection direction, Timestamp elapsed);
+bool canHitBall(Position playerPosition, Position ballPosition);
+BallState ballArrival(const BallState &state, bool fromCenter, Side toSide);
+
+/**
+ * Structure-of-arrays store of the ball and paddle states of many games.
+ * Each row holds the future ball state of one game and the paddle state of the player on turn,
+ * the paddle is judged at the ball arrival time like in Game::run.
+ * The resolve() kernel evaluates all rows at once (AVX2 / SSE2 / scalar, chosen at compile time)
+ * and reports only the rows whose ball has reached the side.
+ */
+class PhysicsBatch
+{
+public:
+    static const int32_t IDLE{INT32_MAX};
+
+    struct Resolution
+    {
+        size_t index;
+        bool hit;
+    };
+
+private:
+    Timestamp epoch;
+
+    // timestamps are kept relative to the epoch, so that all lanes are 32 bits wide
+    std::vector<int32_t> dueAt;
+    std::vector<float> ballPosition;
+    std::vector<int32_t> playerTimestamp;
+    std::vector<float> playerPosition;
+    std::vector<float> playerVelocity;
+
+    int32_t relative(Timestamp timestamp) const;
+
+    size_t resolveScalar(size_t from, int32_t limit, std::vector<Resolution> &resolutions) const;
+    size_t resolveVector(int32_t limit, std::vector<Resolution> &resolutions) const;
+
+public:
+    // the epoch must be close to the timestamps of the rows, those further than 2^29 ms away are clamped
+    explicit PhysicsBatch(Timestamp epoch);
+
+    size_t add();
+    size_t size() const;
+    void reserve(size_t capacity);
+
+    void setBall(size_t index, const BallState &futureBallState);
+    void setPlayer(size_t index, const PlayerState &playerState);
+    void setIdle(size_t index);
+
+    size_t resolve(Timestamp now, Timestamp threshold, std::vector<Resolution> &resolutions) const;
+};
@@ -0,0 +1,106 @@
+#include "PlayerStateHistory.h"
+#include "Physics.h"
+
+PlayerStateHistory::PlayerStateHistory()
+    : head{0}
+{}
+
+bool PlayerStateHistory::read(uint64_t index, PlayerState &state) const
+{
+    const Slot &slot = slots[index % CAPACITY];
+    const uint64_t expected = 2 * (index + 1);
+
+    while (true) {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+
+        if (before & 1) {
+            // writer is in the middle of the slot update
+            continue;
+        }
+
+        if (before != expected) {
+            // the record was already overwritten by a newer one
+            return false;
+        }
+
+        Timestamp timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        Position position = slot.position.load(std::memory_order_relaxed);
+        PlayerDirection direction = slot.direction.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            state = PlayerState{timestamp, position, direction};
+            return true;
+        }
+    }
+}
+
+void PlayerStateHistory::record(const PlayerState &state)
+{
+    uint64_t index = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[index % CAPACITY];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp.store(state.timestamp(), std::memory_order_relaxed);
+    slot.position.store(state.position(), std::memory_order_relaxed);
+    slot.direction.store(state.direction(), std::memory_order_relaxed);
+
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
+    head.store(index + 1, std::memory_order_release);
+}
+
+bool PlayerStateHistory::latest(PlayerState &state) const
+{
+    uint64_t end = head.load(std::memory_order_acquire);
+
+    if (end == 0) {
+        return false;
+    }
+
+    return read(end - 1, state);
+}
+
+bool PlayerStateHistory::stateAt(Timestamp timestamp, PlayerState &state) const
+{
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+    PlayerState newer;
+    bool hasNewer{false};
+
+    // walk from the newest record back to the first one not newer than the timestamp
+    for (uint64_t i = end; i > begin; --i) {
+        PlayerState older;
+
+        if (!read(i - 1, older)) {
+            return false;
+        }
+
+        if (older.timestamp() > timestamp) {
+            newer = older;
+            hasNewer = true;
+            continue;
+        }
+
+        if (!hasNewer || newer.timestamp() == older.timestamp()) {
+            // nothing recorded after the timestamp yet, extrapolate from the older state
+            Position position = expectedPlayerPosition(
+                older.position(), older.direction(), timestamp - older.timestamp());
+            state = PlayerState{timestamp, position, older.direction()};
+            return true;
+        }
+
+        // interpolate between the two recorded states around the timestamp
+        double ratio = static_cast<double>(timestamp - older.timestamp())
+            / static_cast<double>(newer.timestamp() - older.timestamp());
+        auto position = static_cast<Position>(older.position() + ratio * (newer.position() - older.position()));
+
+        state = PlayerState{timestamp, position, older.direction()};
+        return true;
+    }
+
+    return false;
+}
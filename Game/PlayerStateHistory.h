@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+
+#include "GameTypes.h"
+#include "PlayerState.h"
+
+/**
+ * Fixed-size ring of the recently accepted states of one player.
+ * There is a single writer (the game, under its lock), readers never block:
+ * each slot is guarded by its own sequence number and readers retry on a torn read.
+ * Slots are kept compact (the whole ring is well under 1 KiB), so a rewind stays in cache.
+ */
+class PlayerStateHistory
+{
+public:
+    static const size_t CAPACITY{32};
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<Timestamp> timestamp{0};
+        std::atomic<Position> position{0};
+        std::atomic<PlayerDirection> direction{PlayerDirection::Stop};
+    };
+
+    std::array<Slot, CAPACITY> slots;
+    std::atomic<uint64_t> head;
+
+    bool read(uint64_t index, PlayerState &state) const;
+
+public:
+    PlayerStateHistory();
+
+    void record(const PlayerState &state);
+
+    bool latest(PlayerState &state) const;
+    bool stateAt(Timestamp timestamp, PlayerState &state) const;
+};
@@ -0,0 +1,200 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Replay.h"
+#include "../Exceptions.h"
+
+ReplayEvent ReplayEvent::of(ReplayEventType type, Timestamp at, int32_t value)
+{
+    ReplayEvent event{};
+    event.type = static_cast<uint8_t>(type);
+    event.at = at;
+    event.value = value;
+
+    return event;
+}
+
+ReplayEvent ReplayEvent::of(ReplayEventType type, Timestamp at, Side side, const PlayerState &state)
+{
+    ReplayEvent event = of(type, at);
+    event.side = static_cast<uint8_t>(side);
+    event.timestamp = state.timestamp();
+    event.position = state.position();
+    event.direction = static_cast<uint8_t>(state.direction());
+
+    return event;
+}
+
+ReplayEvent ReplayEvent::of(ReplayEventType type, Timestamp at, const BallState &state, Position paddle)
+{
+    ReplayEvent event = of(type, at);
+    event.side = static_cast<uint8_t>(state.side());
+    event.timestamp = state.timestamp();
+    event.position = state.position();
+    event.angle = state.angle();
+    event.speed = state.speed();
+    event.paddle = paddle;
+
+    return event;
+}
+
+ReplayEventType ReplayEvent::getType() const
+{
+    return static_cast<ReplayEventType>(type);
+}
+
+Side ReplayEvent::getSide() const
+{
+    return static_cast<Side>(side);
+}
+
+PlayerState ReplayEvent::toPlayerState() const
+{
+    return {timestamp, position, static_cast<PlayerDirection>(direction)};
+}
+
+BallState ReplayEvent::toBallState() const
+{
+    return {timestamp, getSide(), position, static_cast<Angle>(angle), speed};
+}
+
+std::string ReplayEvent::toLog() const
+{
+    switch (getType()) {
+    case ReplayEventType::Seed: {
+        return "seed " + std::to_string(static_cast<uint32_t>(value));
+    }
+    case ReplayEventType::Join: {
+        return "join " + std::to_string(value);
+    }
+    case ReplayEventType::Ready: {
+        return "ready " + sideToStr(getSide());
+    }
+    case ReplayEventType::Update: {
+        return "update " + sideToStr(getSide())
+            + " " + timestampToStr(timestamp)
+            + " " + playerPositionToStr(position)
+            + " " + directionToStr(static_cast<PlayerDirection>(direction))
+            + " jitter " + std::to_string(value)
+            + (flags ? "" : " rejected");
+    }
+    case ReplayEventType::Serve:
+    case ReplayEventType::Hit: {
+        return std::string{getType() == ReplayEventType::Serve ? "serve" : "hit"}
+            + " to " + sideToStr(getSide())
+            + " at " + timestampToStr(timestamp)
+            + " " + ballPositionToStr(position)
+            + " angle " + std::to_string(angle)
+            + " speed " + std::to_string(speed)
+            + (getType() == ReplayEventType::Hit ? " paddle " + std::to_string(paddle) : "");
+    }
+    case ReplayEventType::Miss: {
+        return "miss, " + sideToStr(getSide()) + " wins"
+            + " " + std::to_string(value >> 16) + ":" + std::to_string(value & 0xffff)
+            + " ball " + ballPositionToStr(position)
+            + " paddle " + std::to_string(paddle);
+    }
+    case ReplayEventType::Restart: {
+        return "restart " + sideToStr(getSide());
+    }
+    case ReplayEventType::Leave: {
+        return "leave " + sideToStr(getSide());
+    }
+    }
+
+    return "unknown " + std::to_string(type);
+}
+
+ReplayHeader makeReplayHeader(Uid gameUid, Timestamp createdAt)
+{
+    ReplayHeader header{};
+    std::memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.recordSize = sizeof(ReplayEvent);
+    header.createdAt = createdAt;
+    header.gameUid = gameUid;
+
+    return header;
+}
+
+ReplayReader::ReplayReader(const std::string &fileName)
+    : fd{-1},
+      data{MAP_FAILED},
+      length{0},
+      header{nullptr},
+      events{nullptr},
+      count{0}
+{
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw ReplayException{"can not open replay " + fileName};
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) == -1 || static_cast<size_t>(info.st_size) < sizeof(ReplayHeader)) {
+        ::close(fd);
+        throw ReplayException{"replay " + fileName + " is too short"};
+    }
+
+    length = static_cast<size_t>(info.st_size);
+    data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        throw ReplayException{"can not map replay " + fileName};
+    }
+
+    // the records are read once from the start to the end
+    madvise(data, length, MADV_SEQUENTIAL);
+
+    header = static_cast<const ReplayHeader *>(data);
+    if (std::memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0
+        || header->version != REPLAY_VERSION
+        || header->recordSize != sizeof(ReplayEvent)) {
+        munmap(data, length);
+        ::close(fd);
+        throw ReplayException{"file " + fileName + " is not a supported replay"};
+    }
+
+    // a record cut off by a crash of the writer is ignored
+    events = reinterpret_cast<const ReplayEvent *>(static_cast<const char *>(data) + sizeof(ReplayHeader));
+    count = (length - sizeof(ReplayHeader)) / sizeof(ReplayEvent);
+}
+
+ReplayReader::~ReplayReader()
+{
+    if (data != MAP_FAILED) {
+        munmap(data, length);
+    }
+
+    if (fd != -1) {
+        ::close(fd);
+    }
+}
+
+const ReplayHeader &ReplayReader::getHeader() const
+{
+    return *header;
+}
+
+size_t ReplayReader::size() const
+{
+    return count;
+}
+
+const ReplayEvent &ReplayReader::operator[](size_t index) const
+{
+    return events[index];
+}
+
+const ReplayEvent *ReplayReader::begin() const
+{
+    return events;
+}
+
+const ReplayEvent *ReplayReader::end() const
+{
+    return events + count;
+}
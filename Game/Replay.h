@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "GameTypes.h"
+#include "BallState.h"
+#include "PlayerState.h"
+#include "../Types.h"
+
+enum class ReplayEventType: uint8_t
+{
+    Seed,
+    Join,
+    Ready,
+    Update,
+    Serve,
+    Hit,
+    Miss,
+    Restart,
+    Leave
+};
+
+/**
+ * One fixed-size record of the replay stream, the meaning of the fields depends on the type:
+ * Seed - value = seed; Join, Ready, Restart, Leave - value = player uid, side;
+ * Update - player state, value = jitter, flags = accepted;
+ * Serve, Hit - the future ball state; Miss - the missed ball, side = winner, value = left << 16 | right score.
+ * Hit and Miss carry the paddle position the ball was judged against.
+ */
+struct ReplayEvent
+{
+    Timestamp at;
+    Timestamp timestamp;
+    int32_t value;
+    int16_t position;
+    int16_t angle;
+    uint16_t speed;
+    int16_t paddle;
+    uint8_t type;
+    uint8_t side;
+    uint8_t direction;
+    uint8_t flags;
+
+    static ReplayEvent of(ReplayEventType type, Timestamp at, int32_t value = 0);
+    static ReplayEvent of(ReplayEventType type, Timestamp at, Side side, const PlayerState &state);
+    static ReplayEvent of(ReplayEventType type, Timestamp at, const BallState &state, Position paddle = 0);
+
+    ReplayEventType getType() const;
+    Side getSide() const;
+    PlayerState toPlayerState() const;
+    BallState toBallState() const;
+
+    std::string toLog() const;
+};
+
+/**
+ * Leads every replay file, the records follow in the order the game applied them.
+ */
+struct ReplayHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    Timestamp createdAt;
+    int32_t gameUid;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ReplayEvent) == 32, "replay records must keep their on-disk size");
+static_assert(sizeof(ReplayHeader) == 32, "replay header must keep its on-disk size");
+
+const char REPLAY_MAGIC[8]{'U', 'P', 'S', 'R', 'P', 'L', 'Y', '\0'};
+const uint32_t REPLAY_VERSION{1};
+
+ReplayHeader makeReplayHeader(Uid gameUid, Timestamp createdAt);
+
+/**
+ * Read-only view of a replay file mapped into memory.
+ */
+class ReplayReader
+{
+    int fd;
+    void *data;
+    size_t length;
+
+    const ReplayHeader *header;
+    const ReplayEvent *events;
+    size_t count;
+
+public:
+    explicit ReplayReader(const std::string &fileName);
+    ReplayReader(const ReplayReader &reader) = delete;
+    virtual ~ReplayReader();
+
+    const ReplayHeader &getHeader() const;
+    size_t size() const;
+    const ReplayEvent &operator[](size_t index) const;
+    const ReplayEvent *begin() const;
+    const ReplayEvent *end() const;
+};
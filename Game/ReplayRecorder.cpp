@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ReplayRecorder.h"
+#include "../Utils/Logger.h"
+
+ReplayRecorder::ReplayRecorder(Logger &logger, std::string directory)
+    : logger(logger),
+      directory{std::move(directory)},
+      recordsWritten{0},
+      recordsDropped{0}
+{}
+
+int ReplayRecorder::getFile(Uid game, Timestamp createdAt)
+{
+    auto found = files.find(game);
+
+    if (found != files.end()) {
+        return found->second;
+    }
+
+    std::string fileName = directory + "/game-" + std::to_string(createdAt) + "-" + std::to_string(game) + ".replay";
+    int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd == -1) {
+        LOG_ERROR(logger, "can not open replay ", fileName, ": ", std::strerror(errno));
+    } else {
+        ReplayHeader header = makeReplayHeader(game, createdAt);
+        write(fd, std::string{reinterpret_cast<const char *>(&header), sizeof(header)});
+    }
+
+    // a file that failed to open stays -1, the records of the game are dropped
+    files.emplace(game, fd);
+    return fd;
+}
+
+void ReplayRecorder::closeFile(Uid game)
+{
+    auto found = files.find(game);
+
+    if (found == files.end()) {
+        return;
+    }
+
+    if (found->second != -1) {
+        ::close(found->second);
+    }
+
+    files.erase(found);
+}
+
+void ReplayRecorder::write(int fd, const std::string &buffer)
+{
+    size_t written{0};
+
+    while (written < buffer.size()) {
+        ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (result <= 0) {
+            LOG_ERROR(logger, "replay write failed: ", std::strerror(errno));
+            return;
+        }
+
+        written += static_cast<size_t>(result);
+    }
+}
+
+void ReplayRecorder::flush()
+{
+    {
+        auto lock = acquireLock();
+        writing.swap(pending);
+    }
+
+    // the records of each game are gathered, so that a game costs one write per flush
+    std::vector<Uid> closed;
+
+    for (auto &record : writing) {
+        if (record.close) {
+            closed.push_back(record.game);
+            continue;
+        }
+
+        if (getFile(record.game, record.event.at) == -1) {
+            recordsDropped++;
+            continue;
+        }
+
+        buffers[record.game].append(reinterpret_cast<const char *>(&record.event), sizeof(ReplayEvent));
+    }
+
+    for (auto &buffer : buffers) {
+        if (buffer.second.empty()) {
+            continue;
+        }
+
+        write(files[buffer.first], buffer.second);
+        recordsWritten += buffer.second.size() / sizeof(ReplayEvent);
+        buffer.second.clear();
+    }
+
+    for (Uid game : closed) {
+        closeFile(game);
+        buffers.erase(game);
+    }
+
+    writing.clear();
+}
+
+bool ReplayRecorder::isEnabled() const
+{
+    return !directory.empty();
+}
+
+void ReplayRecorder::record(Uid game, const ReplayEvent &event)
+{
+    auto lock = acquireLock();
+
+    if (pending.size() >= MAX_PENDING) {
+        // the disk does not keep up, the game must not wait for it
+        recordsDropped++;
+        return;
+    }
+
+    pending.push_back(Record{game, false, event});
+
+    if (pending.size() == FLUSH_THRESHOLD) {
+        notifyOne();
+    }
+}
+
+void ReplayRecorder::close(Uid game)
+{
+    auto lock = acquireLock();
+
+    pending.push_back(Record{game, true, ReplayEvent{}});
+}
+
+uint64_t ReplayRecorder::getWrittenCount() const
+{
+    return recordsWritten;
+}
+
+uint64_t ReplayRecorder::getDroppedCount() const
+{
+    return recordsDropped;
+}
+
+void ReplayRecorder::run()
+{
+    while (!shouldStop()) {
+        {
+            auto lock = acquireLock();
+            waitFor(lock, FLUSH_PERIOD, [this]() {
+                return shouldStop() || pending.size() >= FLUSH_THRESHOLD;
+            });
+        }
+
+        flush();
+    }
+}
+
+void ReplayRecorder::after()
+{
+    flush();
+
+    for (auto &file : files) {
+        if (file.second != -1) {
+            ::close(file.second);
+        }
+    }
+
+    files.clear();
+    buffers.clear();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Replay.h"
+#include "../Types.h"
+#include "../Utils/Thread.h"
+
+class Logger;
+
+/**
+ * Appends the replay events of all games to one binary file per game.
+ * Games only push the records into a shared buffer, the files are written by the recorder thread
+ * every FLUSH_PERIOD or as soon as FLUSH_THRESHOLD records are waiting.
+ */
+class ReplayRecorder: public Thread
+{
+public:
+    const std::chrono::milliseconds FLUSH_PERIOD{100};
+    const size_t FLUSH_THRESHOLD{4096};
+    const size_t MAX_PENDING{1 << 20};
+
+private:
+    struct Record
+    {
+        Uid game;
+        bool close;
+        ReplayEvent event;
+    };
+
+    Logger &logger;
+    std::string directory;
+
+    std::vector<Record> pending;
+    std::vector<Record> writing;
+
+    std::unordered_map<Uid, int> files;
+    std::unordered_map<Uid, std::string> buffers;
+
+    std::atomic<uint64_t> recordsWritten;
+    std::atomic<uint64_t> recordsDropped;
+
+    int getFile(Uid game, Timestamp createdAt);
+    void closeFile(Uid game);
+    void write(int fd, const std::string &buffer);
+    void flush();
+
+public:
+    ReplayRecorder(Logger &logger, std::string directory);
+
+    bool isEnabled() const;
+    void record(Uid game, const ReplayEvent &event);
+    void close(Uid game);
+
+    uint64_t getWrittenCount() const;
+    uint64_t getDroppedCount() const;
+
+    void run() override;
+    void after() override;
+};
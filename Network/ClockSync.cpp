@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <sstream>
+
+#include "ClockSync.h"
+
+const size_t ClockSync::RTT_SAMPLES_COUNT;
+const Timestamp ClockSync::MAX_JITTER;
+
+ClockSync::ClockSync()
+    : rttSamples{},
+      rttCount{0},
+      rttMin{0},
+      pokeSentAt{-1},
+      windowOffset{0},
+      windowRtt{0},
+      windowCount{0},
+      hasOffset{false},
+      offset{0},
+      offsetAt{0},
+      drift{0}
+{}
+
+Timestamp ClockSync::percentileLocked(double percentile) const
+{
+    size_t count = std::min(rttCount, RTT_SAMPLES_COUNT);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    std::array<Timestamp, RTT_SAMPLES_COUNT> sorted = rttSamples;
+    std::sort(sorted.begin(), sorted.begin() + count);
+
+    return sorted[static_cast<size_t>(percentile * (count - 1))];
+}
+
+void ClockSync::pokeSent(Timestamp now)
+{
+    auto lock = acquireLock();
+
+    // only the last poke is timed, a lost poke_back must not be matched to a newer poke
+    pokeSentAt = now;
+}
+
+Timestamp ClockSync::addRttLocked(Timestamp now)
+{
+    if (pokeSentAt < 0) {
+        return -1;
+    }
+
+    Timestamp rtt = now - pokeSentAt;
+
+    rttSamples[rttCount % RTT_SAMPLES_COUNT] = rtt;
+    rttCount++;
+    pokeSentAt = -1;
+
+    size_t count = std::min(rttCount, RTT_SAMPLES_COUNT);
+    rttMin = *std::min_element(rttSamples.begin(), rttSamples.begin() + count);
+
+    return rtt;
+}
+
+void ClockSync::pokeReturned(Timestamp now)
+{
+    auto lock = acquireLock();
+    addRttLocked(now);
+}
+
+void ClockSync::pokeReturned(Timestamp now, Timestamp clientTimestamp)
+{
+    auto lock = acquireLock();
+
+    Timestamp sentAt = pokeSentAt;
+    Timestamp rtt = addRttLocked(now);
+
+    if (rtt < 0) {
+        return;
+    }
+
+    // the error of the sample is at most half of its round trip, the shortest one is kept
+    Timestamp sample = clientTimestamp - (sentAt + now) / 2;
+
+    if (windowCount == 0 || rtt < windowRtt) {
+        windowOffset = sample;
+        windowRtt = rtt;
+    }
+
+    windowCount++;
+
+    // the first estimate is taken at once, the following ones once per full window
+    if (hasOffset && windowCount < OFFSET_WINDOW_SIZE) {
+        return;
+    }
+
+    if (hasOffset && now > offsetAt) {
+        double measured = static_cast<double>(windowOffset - offset) / (now - offsetAt);
+        drift = std::max(-1e-3, std::min(1e-3, (drift + measured) / 2));
+    }
+
+    offset = windowOffset;
+    offsetAt = now;
+    hasOffset = true;
+    windowCount = 0;
+}
+
+Timestamp ClockSync::toServerTime(Timestamp clientTimestamp, Timestamp now) const
+{
+    auto lock = acquireLock();
+
+    if (!hasOffset) {
+        return clientTimestamp;
+    }
+
+    auto current = static_cast<Timestamp>(offset + drift * (now - offsetAt));
+
+    return clientTimestamp - current;
+}
+
+Timestamp ClockSync::getRttPercentile(double percentile) const
+{
+    auto lock = acquireLock();
+    return percentileLocked(percentile);
+}
+
+Timestamp ClockSync::getJitter() const
+{
+    auto lock = acquireLock();
+
+    if (rttCount == 0) {
+        return 0;
+    }
+
+    return std::min(MAX_JITTER, percentileLocked(0.9) - rttMin);
+}
+
+std::string ClockSync::toLog() const
+{
+    auto lock = acquireLock();
+
+    std::stringstream stream;
+
+    if (rttCount == 0) {
+        stream << "rtt: no samples";
+    } else {
+        stream << "rtt p50: " << percentileLocked(0.5) << " ms"
+               << ", p90: " << percentileLocked(0.9) << " ms"
+               << ", p99: " << percentileLocked(0.99) << " ms";
+    }
+
+    if (hasOffset) {
+        stream << ", offset: " << offset << " ms";
+    }
+
+    return stream.str();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "../Utils/Lockable.h"
+#include "../Game/GameTypes.h"
+
+/**
+ * Estimates the round trip time of one connection and the offset of its clock.
+ *
+ * Round trips are measured by the server's own poke / poke_back exchanges.
+ * A poke_back carrying the client time is also an offset sample, the client stamped it
+ * in the middle of the round trip. The offset is taken from the sample with the shortest round trip
+ * in a window (min-RTT filtering) and the drift between consecutive windows is extrapolated.
+ */
+class ClockSync: public Lockable
+{
+public:
+    static const size_t RTT_SAMPLES_COUNT{64};
+    static const size_t OFFSET_WINDOW_SIZE{8};
+    static const Timestamp MAX_JITTER{250};
+
+private:
+    std::array<Timestamp, RTT_SAMPLES_COUNT> rttSamples;
+    size_t rttCount;
+    Timestamp rttMin;
+    Timestamp pokeSentAt;
+
+    // client time minus server time of the sample with the shortest round trip in the window
+    Timestamp windowOffset;
+    Timestamp windowRtt;
+    size_t windowCount;
+
+    bool hasOffset;
+    Timestamp offset;
+    Timestamp offsetAt;
+    double drift;
+
+    Timestamp percentileLocked(double percentile) const;
+    Timestamp addRttLocked(Timestamp now);
+
+public:
+    ClockSync();
+
+    void pokeSent(Timestamp now);
+    void pokeReturned(Timestamp now);
+    void pokeReturned(Timestamp now, Timestamp clientTimestamp);
+
+    Timestamp toServerTime(Timestamp clientTimestamp, Timestamp now) const;
+    Timestamp getRttPercentile(double percentile) const;
+    Timestamp getJitter() const;
+
+    std::string toLog() const;
+};
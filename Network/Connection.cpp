@@ -1,12 +1,17 @@
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 
+#include <algorithm>
 #include <cstring>
 
 #include "Connection.h"
 #include "../App.h"
 #include "../Utils/Logger.h"
 #include "../Utils/Text.h"
+#include "../Utils/Tracer.h"
 #include "../Exceptions.h"
 
 Connection::Connection(App &app, Uid uid, int socket, sockaddr_in address)
@@ -14,7 +19,16 @@ Connection::Connection(App &app, Uid uid, int socket, sockaddr_in address)
       uid(uid),
       socket(socket),
       address(address),
-      port(ntohs(address.sin_port))
+      port(ntohs(address.sin_port)),
+      lastActiveAt{std::chrono::steady_clock::now()},
+      lastPokeAt{},
+      lastStateTimestamp{0},
+      spectating{false},
+      bytesReceived{0},
+      bytesSent{0},
+      packetsReceived{0},
+      packetsSent{0},
+      corruptedCount{0}
 {
     if (socket < 0) {
         throw ConnectionException("invalid connection socket");
@@ -96,18 +110,235 @@ void Connection::setMode(Connection::Mode mode)
     this->mode = mode;
 }
 
+ClockSync &Connection::getClockSync()
+{
+    return clockSync;
+}
+
+void Connection::setSpectating(bool spectating)
+{
+    this->spectating = spectating;
+}
+
+uint64_t Connection::getBytesReceived() const
+{
+    return bytesReceived.load(std::memory_order_relaxed);
+}
+
+uint64_t Connection::getBytesSent() const
+{
+    return bytesSent.load(std::memory_order_relaxed);
+}
+
+uint64_t Connection::getPacketsReceived() const
+{
+    return packetsReceived.load(std::memory_order_relaxed);
+}
+
+uint64_t Connection::getPacketsSent() const
+{
+    return packetsSent.load(std::memory_order_relaxed);
+}
+
+uint64_t Connection::getCorruptedCount() const
+{
+    return corruptedCount.load(std::memory_order_relaxed);
+}
+
+size_t Connection::getSendQueueDepth() const
+{
+    // bytes in the socket send buffer the client has not acknowledged yet
+    int queued{0};
+
+    if (::ioctl(socket, SIOCOUTQ, &queued) == -1) {
+        return 0;
+    }
+
+    return static_cast<size_t>(queued);
+}
+
+std::chrono::milliseconds Connection::getInactiveFor() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastActiveAt.load());
+}
+
+void Connection::poke()
+{
+    // every poke is also a round trip sample for the clock synchronization
+    clockSync.pokeSent(app.getCurrentTimestamp());
+    send(Packet{"poke"});
+    lastPokeAt = std::chrono::steady_clock::now();
+}
+
 void Connection::send(const Packet &packet) const
 {
-    std::string contents = packet.serialize();
+    send(std::vector<Packet>{packet});
+}
+
+void Connection::send(const std::vector<Packet> &packets) const
+{
+    // serialize all the packets into one buffer, so that they leave in a single send call
+    std::string contents;
+    std::vector<size_t> packetEnds;
+
+    for (auto &packet : packets) {
+        contents += packet.serialize();
+        packetEnds.push_back(contents.length());
+    }
+
+    TraceSpan span{app.getTracer(), "send", uid};
+
+    for (auto &packet : packets) {
+        if (packet.getTraceId()) {
+            span.setTrace(packet.getTraceId());
+            break;
+        }
+    }
+
+    Clock &clock = app.getClock();
+    int64_t sendStart = clock.monotonicMicros();
+    size_t sentTotal{0};
+    int error{0};
+
+    {
+        // the senders of the game and of this connection must not interleave partly sent buffers
+        std::unique_lock<std::mutex> lock{sendMutex};
+
+        if (spectating && app.getSpectatorBroadcaster().forward(uid, contents, packets.size())) {
+            // the broadcaster writes it after the frames already queued, its bytes are counted there
+            this->packetsSent.fetch_add(packets.size(), std::memory_order_relaxed);
+            app.getStats().addPacketsSent(packets.size());
+
+            for (auto &packet : packets) {
+                app.getLogger().logCommunication(packet, false, getUid());
+            }
+
+            return;
+        }
+
+        while (sentTotal < contents.length()) {
+            // a client gone meanwhile must not kill the server with SIGPIPE
+            ssize_t sentBytes = ::send(socket, contents.c_str() + sentTotal, contents.length() - sentTotal, MSG_NOSIGNAL);
+
+            if (sentBytes == -1 && errno == EINTR) {
+                continue;
+            }
+
+            if (sentBytes <= 0) {
+                error = sentBytes == 0 ? EPIPE : errno;
+                break;
+            }
+
+            sentTotal += static_cast<size_t>(sentBytes);
+        }
+    }
+
+    app.getStats().recordSendTime(clock.monotonicMicros() - sendStart);
+
+    // only the packets which left whole are counted
+    size_t packetsSent = static_cast<size_t>(
+        std::upper_bound(packetEnds.begin(), packetEnds.end(), sentTotal) - packetEnds.begin());
+
+    this->packetsSent.fetch_add(packetsSent, std::memory_order_relaxed);
+    this->bytesSent.fetch_add(sentTotal, std::memory_order_relaxed);
+    app.getStats().addPacketsSent(packetsSent);
+    app.getStats().addBytesSent(sentTotal);
+
+    for (size_t i = 0; i < packetsSent; ++i) {
+        app.getLogger().logCommunication(packets[i], false, getUid());
+    }
+
+    if (error && error != EBADF) {
+        // the stream of the client is cut in the middle of a packet, the connection can not continue
+        LOG_WARNING(app.getLogger(), uid, " - can not send: ", std::strerror(error), " - disconnecting");
+        ::shutdown(socket, SHUT_RDWR);
+    }
+}
+
+ssize_t Connection::sendNonBlocking(const iovec *buffers, size_t count) const
+{
+    std::unique_lock<std::mutex> lock{sendMutex, std::try_to_lock};
+
+    if (!lock.owns_lock()) {
+        // a blocking send is being written, the caller tries again like with a full buffer
+        return 0;
+    }
+
+    msghdr message{};
+    message.msg_iov = const_cast<iovec *>(buffers);
+    message.msg_iovlen = count;
+
+    ssize_t sentBytes = ::sendmsg(socket, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (sentBytes == -1) {
+        // a full socket buffer is not an error, the caller keeps the rest
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    }
+
+    bytesSent.fetch_add(static_cast<uint64_t>(sentBytes), std::memory_order_relaxed);
+    app.getStats().addBytesSent(static_cast<uint64_t>(sentBytes));
+
+    return sentBytes;
+}
+
+bool Connection::isSupersededState(const Packet &packet) const
+{
+    if (packet.getType() != "state") {
+        return false;
+    }
+
+    auto items = packet.getItems();
+
+    if (items.empty()) {
+        return false;
+    }
+
+    Timestamp timestamp;
+
+    try {
+        timestamp = strToTimestamp(items[0]);
+    }
+    catch (GameTypeException &exception) {
+        // let the handler reject it
+        return false;
+    }
 
-    ssize_t sentBytes = ::send(socket, contents.c_str(), contents.length(), 0);
+    // an older state than the last applied one, unless the client clock obviously jumped back
+    return timestamp <= lastStateTimestamp
+        && lastStateTimestamp - timestamp < SUPERSEDED_STATE_WINDOW.count();
+}
 
-    if (sentBytes != 0) {
-        // success
-        app.getStats().addPacketsSent(1);
-        app.getStats().addBytesSent(static_cast<uint64_t>(sentBytes));
-        app.getLogger().logCommunication(packet, false, getUid());
+bool Connection::handle(const Packet &packet, int &corruptedPackets)
+{
+    // the responses and the game events of the packet carry its trace
+    Tracer::Context context{packet.getTraceId()};
+    bool accepted{false};
+
+    try {
+        TraceSpan handleSpan{app.getTracer(), "handle", uid, PacketCapture::typeId(packet.getType())};
+        int64_t handlingStart = app.getClock().monotonicMicros();
+        accepted = app.getPacketHandler().handleIncomingPacket(uid, packet);
+        app.getStats().recordHandlingTime(PacketCapture::typeId(packet.getType()),
+                                          app.getClock().monotonicMicros() - handlingStart);
+        corruptedPackets = 0;
+        app.getStats().addPacketsReceived(1);
+
+        if (accepted && packet.getType() == "state") {
+            lastStateTimestamp = strToTimestamp(packet.getItems()[0]);
+        }
+    }
+    catch (MalformedPacketException &exception) {
+        corruptedPackets++;
+        corruptedCount.fetch_add(1, std::memory_order_relaxed);
+        send(Packet{"malformed_packet"});
     }
+    catch (PacketException &exception) {
+        corruptedPackets++;
+        corruptedCount.fetch_add(1, std::memory_order_relaxed);
+        app.getStats().addPacketsDropped(1);
+    }
+
+    return accepted;
 }
 
 void Connection::before()
@@ -119,7 +350,7 @@ void Connection::before()
 
 void Connection::run()
 {
-    app.getLogger().log(std::to_string(uid) + " - listening", Logger::Level::Success);
+    LOG_SUCCESS(app.getLogger(), uid, " - listening");
 
     char buffer[1024];
     std::string data;
@@ -136,70 +367,61 @@ void Connection::run()
             if (errno == EAGAIN) {
                 // client inactive
                 auto now = std::chrono::steady_clock::now();
-                auto inactive = now - lastActiveAt;
+                auto inactive = now - lastActiveAt.load();
 
                 if (inactive > inactiveTimeout) {
                     // inactive too long, probably dead
-                    app.getLogger()
-                        .log(std::to_string(uid) + " - inactive for too long - disconnecting",
-                             Logger::Level::Warning);
+                    LOG_WARNING(app.getLogger(), uid, " - inactive for too long - disconnecting");
                     return;
                 }
 
                 // send poke packet
-                send(Packet{"poke"});
+                poke();
 
                 continue;
             }
+            else if (errno == EINTR) {
+                // interrupted by a signal (the profiler), receive again
+                continue;
+            }
             else if (errno == EBADF || errno == EINVAL) {
                 // socket shut down
                 return;
             }
             else {
                 // unrecoverable error
-                app.getLogger()
-                    .log(std::to_string(uid) + " - error while receiving: " + std::string{strerror(errno)},
-                         Logger::Level::Error);
+                LOG_ERROR(app.getLogger(), uid, " - error while receiving: ", strerror(errno));
                 return;
             }
         }
 
         if (bytesRead == 0) {
             // player orderly disconnected
-            app.getLogger()
-                .log(std::to_string(uid) + " - orderly disconnected");
+            LOG_DEFAULT(app.getLogger(), uid, " - orderly disconnected");
             return;
         }
 
-        lastActiveAt = std::chrono::steady_clock::now();
-        app.getStats().addBytesReceived(static_cast<uint64_t>(bytesRead));
-
-        // process the received data
-        for (int i = 0; i < bytesRead; ++i) {
-            bool endMessage{false};
-
-            if (buffer[i] == Packet::TERMINATOR) {
-                // if found terminator, the whole message was received
+        TraceSpan receiveSpan{app.getTracer(), "receive", uid};
 
-                // handle received message
-                Packet packet = Packet::parse(data);
+        auto now = std::chrono::steady_clock::now();
+        lastActiveAt = now;
+        bytesReceived.fetch_add(static_cast<uint64_t>(bytesRead), std::memory_order_relaxed);
+        app.getStats().addBytesReceived(static_cast<uint64_t>(bytesRead));
 
-                app.getLogger().logCommunication(packet, true, getUid());
+        if (now - lastPokeAt > POKE_PERIOD) {
+            // keep the round trip estimate fresh even for busy clients
+            poke();
+        }
 
-                try {
-                    app.getPacketHandler().handleIncomingPacket(uid, packet);
-                    corruptedPackets = 0;
-                    app.getStats().addPacketsReceived(1);
-                }
-                catch (MalformedPacketException &exception) {
-                    corruptedPackets++;
-                    send(Packet{"malformed_packet"});
-                }
-                catch (PacketException &exception) {
-                    corruptedPackets++;
-                    app.getStats().addPacketsDropped(1);
-                }
+        // split the received data into packets
+        std::vector<Packet> packets;
 
+        for (int i = 0; i < bytesRead; ++i) {
+            if (buffer[i] == Packet::TERMINATOR) {
+                // if found terminator, the whole message was received, it starts its own trace
+                Tracer::Context context{app.getTracer().newTrace()};
+                TraceSpan parseSpan{app.getTracer(), "parse", uid};
+                packets.push_back(Packet::parse(data));
                 data.clear();
             }
             else {
@@ -207,6 +429,51 @@ void Connection::run()
             }
         }
 
+        if (!packets.empty()) {
+            receiveSpan.setTrace(packets.front().getTraceId());
+        }
+
+        // only the newest state of the batch is applied
+        size_t latestState = packets.size();
+
+        for (size_t i = packets.size(); i > 0; --i) {
+            if (packets[i - 1].getType() == "state") {
+                latestState = i - 1;
+                break;
+            }
+        }
+
+        // handle received messages
+        packetsReceived.fetch_add(packets.size(), std::memory_order_relaxed);
+
+        for (size_t i = 0; i < packets.size(); ++i) {
+            Packet &packet = packets[i];
+
+            app.getLogger().logCommunication(packet, true, getUid());
+
+            if (i == latestState) {
+                // the newest state the game accepts is applied, the older ones only when the newer are rejected
+                bool applied{false};
+
+                for (size_t j = i + 1; j > 0; --j) {
+                    Packet &state = packets[j - 1];
+
+                    if (state.getType() != "state") {
+                        continue;
+                    }
+
+                    if (applied || isSupersededState(state)) {
+                        app.getStats().addPacketsSuperseded(1);
+                        continue;
+                    }
+
+                    applied = handle(state, corruptedPackets);
+                }
+            }
+            else if (packet.getType() != "state") {
+                handle(packet, corruptedPackets);
+            }
+        }
 
         if (data.size() > Packet::MAX_SIZE) {
             // buffered data exceeds the normal message length
@@ -214,13 +481,12 @@ void Connection::run()
             app.getStats().addBytesDropped(data.size());
             data.clear();
             corruptedPackets++;
+            corruptedCount.fetch_add(1, std::memory_order_relaxed);
         }
 
         if (corruptedPackets > CORRUPTED_PACKETS_LIMIT) {
             // connection probably corrupted
-            app.getLogger()
-                .log(std::to_string(uid) + " - too much corrupted data received - disconnecting",
-                     Logger::Level::Error);
+            LOG_ERROR(app.getLogger(), uid, " - too much corrupted data received - disconnecting");
             break;
         }
     }
@@ -237,6 +503,6 @@ void Connection::after()
 {
     ::close(socket);
     socket = -1;
-    app.getLogger().log(std::to_string(uid) + " - connection closed", Logger::Level::Warning);
+    LOG_WARNING(app.getLogger(), uid, " - connection closed");
     app.notifyOne();
 }
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 
 #include "Packet.h"
+#include "ClockSync.h"
 #include "../Utils/Thread.h"
 #include "../Types.h"
+#include "../Game/GameTypes.h"
 
 class App;
 
@@ -23,7 +28,9 @@ public:
     const timeval RECV_TIMEOUT_IDLE{10, 0};
     const timeval RECV_TIMEOUT_BUSY{2, 0};
     const timeval SEND_TIMEOUT{1, 0};
+    const std::chrono::seconds POKE_PERIOD{2};
     const int CORRUPTED_PACKETS_LIMIT{5};
+    const std::chrono::milliseconds SUPERSEDED_STATE_WINDOW{500};
 
 private:
     App &app;
@@ -34,8 +41,29 @@ private:
     sockaddr_in address;
     Mode mode;
 
-    std::chrono::steady_clock::time_point lastActiveAt;
+    std::atomic<std::chrono::steady_clock::time_point> lastActiveAt;
     std::chrono::seconds inactiveTimeout;
+    std::chrono::steady_clock::time_point lastPokeAt;
+
+    ClockSync clockSync;
+
+    Timestamp lastStateTimestamp;
+
+    mutable std::mutex sendMutex;
+
+    // while spectating the broadcaster owns the writes, the sends are queued behind its frames
+    std::atomic<bool> spectating;
+
+    // live counters, written by the receiving thread and by the senders
+    mutable std::atomic<uint64_t> bytesReceived;
+    mutable std::atomic<uint64_t> bytesSent;
+    mutable std::atomic<uint64_t> packetsReceived;
+    mutable std::atomic<uint64_t> packetsSent;
+    std::atomic<uint64_t> corruptedCount;
+
+    bool isSupersededState(const Packet &packet) const;
+    bool handle(const Packet &packet, int &corruptedPackets);
+    void poke();
 
 public:
     Connection(App &app, Uid uid, int socket, sockaddr_in address);
@@ -47,8 +75,20 @@ public:
     const sockaddr_in &getAdress() const;
     Mode getMode() const;
     void setMode(Mode mode);
+    ClockSync &getClockSync();
+    void setSpectating(bool spectating);
+
+    uint64_t getBytesReceived() const;
+    uint64_t getBytesSent() const;
+    uint64_t getPacketsReceived() const;
+    uint64_t getPacketsSent() const;
+    uint64_t getCorruptedCount() const;
+    size_t getSendQueueDepth() const;
+    std::chrono::milliseconds getInactiveFor() const;
 
     void send(const Packet &packet) const;
+    void send(const std::vector<Packet> &packets) const;
+    ssize_t sendNonBlocking(const iovec *buffers, size_t count) const;
 
     void before() override;
     void run() override;
@@ -0,0 +1,154 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "MetricsServer.h"
+#include "../App.h"
+#include "../Exceptions.h"
+
+const size_t MetricsServer::MAX_REQUEST_SIZE;
+
+MetricsServer::MetricsServer(App &app, Port port)
+    : app(app),
+      port(port),
+      socket(-1)
+{
+    memset(&address, 0, sizeof(address));
+
+    // the metrics are meant for a local agent only
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+bool MetricsServer::isEnabled() const
+{
+    return port != 0;
+}
+
+Port MetricsServer::getPort() const
+{
+    return port;
+}
+
+void MetricsServer::before()
+{
+    socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (socket == -1) {
+        std::string message = "cannot create a socket for the metrics: " + std::string{std::strerror(errno)};
+        LOG_ERROR(app.getLogger(), message);
+        throw ServerException(message);
+    }
+
+    int parameter = 1;
+    ::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const void *>(&parameter), sizeof(parameter));
+
+    if (::bind(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(socket, 16) != 0) {
+        std::string message = "can not listen on the metrics port: " + std::string{std::strerror(errno)};
+        LOG_ERROR(app.getLogger(), message);
+        throw ServerException(message);
+    }
+}
+
+void MetricsServer::run()
+{
+    LOG_DEFAULT(app.getLogger(), "metrics served at http://127.0.0.1:", port, "/metrics");
+
+    while (!shouldStop()) {
+        int clientSocket = ::accept4(socket, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (clientSocket == -1) {
+            if (errno == EBADF || errno == EINVAL) {
+                // socket closed
+                break;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            LOG_ERROR(app.getLogger(), "error while accepting a metrics scrape: ", std::strerror(errno));
+            return;
+        }
+
+        serve(clientSocket);
+        ::close(clientSocket);
+    }
+}
+
+void MetricsServer::serve(int clientSocket)
+{
+    // a stuck client must not keep the next scrapes waiting
+    timeval timeout{REQUEST_TIMEOUT.count(), 0};
+    ::setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(clientSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        ssize_t bytesRead = ::recv(clientSocket, buffer, sizeof(buffer), 0);
+
+        if (bytesRead <= 0) {
+            return;
+        }
+
+        request.append(buffer, static_cast<size_t>(bytesRead));
+    }
+
+    std::string requestLine = request.substr(0, request.find("\r\n"));
+
+    if (requestLine.compare(0, 4, "GET ") != 0) {
+        respond(clientSocket, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+        return;
+    }
+
+    std::string target = requestLine.substr(4, requestLine.find(' ', 4) - 4);
+
+    if (target != "/metrics") {
+        respond(clientSocket, "404 Not Found", "text/plain", "metrics are served at /metrics\n");
+        return;
+    }
+
+    respond(clientSocket, "200 OK", "text/plain; version=0.0.4", app.getStats().toPrometheus());
+}
+
+void MetricsServer::respond(int clientSocket,
+                            const std::string &status,
+                            const std::string &contentType,
+                            const std::string &body)
+{
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+        + "Content-Type: " + contentType + "\r\n"
+        + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n"
+        + body;
+
+    size_t sent{0};
+
+    while (sent < response.size()) {
+        ssize_t bytesSent = ::send(clientSocket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+
+        if (bytesSent <= 0) {
+            return;
+        }
+
+        sent += static_cast<size_t>(bytesSent);
+    }
+}
+
+bool MetricsServer::stop(bool wait)
+{
+    // shutdown the socket to break the blocking accept() call
+    ::shutdown(socket, SHUT_RDWR);
+    return Thread::stop(wait);
+}
+
+void MetricsServer::after()
+{
+    ::close(socket);
+    socket = -1;
+}
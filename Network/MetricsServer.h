@@ -0,0 +1,42 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <string>
+
+#include "../Types.h"
+#include "../Utils/Thread.h"
+
+class App;
+
+/**
+ * Minimal HTTP listener on the loopback interface serving the stats in the Prometheus text format
+ * at /metrics. The scrapes are answered one at a time by this thread, the game threads are never involved.
+ */
+class MetricsServer: public Thread
+{
+public:
+    const std::chrono::seconds REQUEST_TIMEOUT{2};
+    static const size_t MAX_REQUEST_SIZE{4096};
+
+private:
+    App &app;
+
+    sockaddr_in address;
+    Port port;
+    int socket;
+
+    void serve(int clientSocket);
+    void respond(int clientSocket, const std::string &status, const std::string &contentType, const std::string &body);
+
+public:
+    MetricsServer(App &app, Port port);
+
+    bool isEnabled() const;
+    Port getPort() const;
+
+    void before() override;
+    void run() override;
+    bool stop(bool wait) override;
+    void after() override;
+};
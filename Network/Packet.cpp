@@ -3,6 +3,7 @@
 
 #include "Packet.h"
 #include "../Exceptions.h"
+#include "../Utils/Tracer.h"
 
 Packet Packet::parse(const std::string &contents)
 {
@@ -24,20 +25,22 @@ Packet Packet::parse(const std::string &contents)
 }
 
 Packet::Packet(std::string type)
-    : type{std::move(type)}
+    : type{std::move(type)},
+      traceId{Tracer::currentTrace()}
 {}
 
 Packet::Packet(std::string type, std::vector<std::string> items)
     : type{std::move(type)},
-      items{std::move(items)}
+      items{std::move(items)},
+      traceId{Tracer::currentTrace()}
 {}
 
-std::string Packet::getType() const
+const std::string &Packet::getType() const
 {
     return type;
 }
 
-std::vector<std::string> Packet::getItems() const
+const std::vector<std::string> &Packet::getItems() const
 {
     return items;
 }
@@ -84,6 +87,17 @@ void Packet::setType(std::string type)
 {
     this->type = std::move(type);
 }
+
+uint64_t Packet::getTraceId() const
+{
+    return traceId;
+}
+
+void Packet::setTraceId(uint64_t traceId)
+{
+    this->traceId = traceId;
+}
+
 std::string Packet::toLog() const
 {
     std::string serialized;
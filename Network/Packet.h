@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <array>
 #include <memory>
+#include <cstdint>
 
 class Packet
 {
@@ -19,17 +20,22 @@ private:
     std::string type;
     std::vector<std::string> items;
 
+    // trace of the packet which caused this one, zero when untraced
+    uint64_t traceId;
+
 public:
     explicit Packet(std::string type = "");
     explicit Packet(std::string type, std::vector<std::string> items);
 
-    std::string getType() const;
-    std::vector<std::string> getItems() const;
+    const std::string &getType() const;
+    const std::vector<std::string> &getItems() const;
     std::string serialize() const;
     void clear();
     void addItem(std::string item);
     void addItems(std::vector<std::string> items);
     void setType(std::string type);
+    uint64_t getTraceId() const;
+    void setTraceId(uint64_t traceId);
 
     std::string toLog() const;
 };
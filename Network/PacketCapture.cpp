@@ -0,0 +1,111 @@
+#include <sstream>
+#include <unordered_map>
+
+#include "PacketCapture.h"
+#include "../Utils/Text.h"
+
+const std::vector<std::string> PacketCapture::TYPES{
+    "other",
+    // connection
+    "poke", "poke_back", "time", "login", "logged", "login_failed", "already_logged", "not_logged",
+    "join", "joined", "leave", "left", "server_full", "already_in_game", "not_in_game",
+    "unknown_packet", "malformed_packet", "impossible_state",
+    // game
+    "opponent_joined", "ready", "opponent_ready", "restart", "new_round", "ball_released", "ball_hit",
+    "state", "your_state", "opponent_state", "opponent_left", "game_over", "game_ended",
+    // spectators
+    "spectate", "spectating", "player_joined", "player_ready", "player_state", "player_left", "ball_state"
+};
+
+uint8_t PacketCapture::typeId(const std::string &type)
+{
+    static const std::unordered_map<std::string, uint8_t> ids = []() {
+        std::unordered_map<std::string, uint8_t> ids;
+
+        for (size_t i = 0; i < TYPES.size(); ++i) {
+            ids.emplace(TYPES[i], static_cast<uint8_t>(i));
+        }
+
+        return ids;
+    }();
+
+    auto found = ids.find(type);
+
+    return found != ids.end() ? found->second : OTHER_TYPE;
+}
+
+const std::string &PacketCapture::typeName(uint8_t id)
+{
+    return id < TYPES.size() ? TYPES[id] : TYPES[OTHER_TYPE];
+}
+
+PacketCapture::PacketCapture()
+    : echo{true}
+{
+    static_assert(MAX_TYPES <= UINT8_MAX, "type ids are written as one byte");
+
+    for (size_t i = 0; i < MAX_TYPES; ++i) {
+        rates[i] = 1;
+        seen[i] = 0;
+        captured[i] = 0;
+    }
+
+    // keep-alives carry nothing, the states arrive several times per frame
+    for (const char *type : {"poke", "poke_back"}) {
+        rates[typeId(type)] = 0;
+    }
+
+    for (const char *type : {"state", "your_state", "opponent_state", "player_state"}) {
+        rates[typeId(type)] = 10;
+    }
+}
+
+bool PacketCapture::sample(uint8_t type)
+{
+    uint32_t rate = rates[type].load(std::memory_order_relaxed);
+    uint64_t count = seen[type].fetch_add(1, std::memory_order_relaxed);
+
+    if (rate == 0 || count % rate != 0) {
+        return false;
+    }
+
+    captured[type].fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void PacketCapture::setRate(uint8_t type, uint32_t rate)
+{
+    rates[type] = rate;
+}
+
+uint32_t PacketCapture::getRate(uint8_t type) const
+{
+    return rates[type];
+}
+
+void PacketCapture::setEcho(bool echo)
+{
+    this->echo = echo;
+}
+
+bool PacketCapture::isEchoing() const
+{
+    return echo;
+}
+
+std::string PacketCapture::toLog() const
+{
+    std::stringstream stream;
+
+    stream << "Echo to console: " << (echo ? "on" : "off") << std::endl << std::endl;
+
+    for (size_t i = 0; i < TYPES.size(); ++i) {
+        uint32_t rate = rates[i];
+
+        stream << Text::justifyL(TYPES[i], 18)
+               << Text::justifyL(rate == 0 ? "off" : rate == 1 ? "all" : "1/" + std::to_string(rate), 8)
+               << captured[i] << " / " << seen[i] << std::endl;
+    }
+
+    return stream.str();
+}
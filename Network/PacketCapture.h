@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Types.h"
+
+/**
+ * Leads the binary communication capture, the records follow.
+ */
+struct CaptureHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+/**
+ * Precedes the raw bytes of each captured packet (type and items, without the terminator).
+ */
+struct CaptureRecord
+{
+    int64_t timestamp;
+    Uid uid;
+    uint16_t length;
+    uint8_t incoming;
+    uint8_t type;
+};
+
+static_assert(sizeof(CaptureHeader) == 16, "capture header must keep its on-disk size");
+static_assert(sizeof(CaptureRecord) == 16, "capture records must keep their on-disk size");
+
+const char CAPTURE_MAGIC[8]{'U', 'P', 'S', 'C', 'A', 'P', '\0', '\0'};
+const uint32_t CAPTURE_VERSION{1};
+
+/**
+ * Decides which packets get into the communication capture.
+ * Every packet type has its own rate: 0 - not captured, 1 - every packet, N - one of N packets.
+ * The rates can be changed at runtime, the decision is lock free.
+ */
+class PacketCapture
+{
+public:
+    static const size_t MAX_TYPES{64};
+    static const uint8_t OTHER_TYPE{0};
+
+    // the index is the type id written to the capture, new types are only appended
+    static const std::vector<std::string> TYPES;
+
+    static uint8_t typeId(const std::string &type);
+    static const std::string &typeName(uint8_t id);
+
+private:
+    std::array<std::atomic<uint32_t>, MAX_TYPES> rates;
+    std::array<std::atomic<uint64_t>, MAX_TYPES> seen;
+    std::array<std::atomic<uint64_t>, MAX_TYPES> captured;
+    std::atomic<bool> echo;
+
+public:
+    PacketCapture();
+    PacketCapture(const PacketCapture &capture) = delete;
+
+    bool sample(uint8_t type);
+
+    void setRate(uint8_t type, uint32_t rate);
+    uint32_t getRate(uint8_t type) const;
+    void setEcho(bool echo);
+    bool isEchoing() const;
+
+    std::string toLog() const;
+};
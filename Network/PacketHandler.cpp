@@ -27,7 +27,7 @@ void PacketHandler::validateItemsCount(Packet packet, size_t count)
     }
 }
 
-void PacketHandler::handleIncomingPacket(Uid uid, const Packet &packet)
+bool PacketHandler::handleIncomingPacket(Uid uid, const Packet &packet)
 {
     auto typeHandler = PACKET_HANDLERS.find(packet.getType());
 
@@ -39,7 +39,7 @@ void PacketHandler::handleIncomingPacket(Uid uid, const Packet &packet)
     Handler handler = typeHandler->second;
 
     try {
-        (this->*handler)(uid, packet);
+        return (this->*handler)(uid, packet);
     }
     catch (AlreadyLoggedException &exception) {
         handleOutgoingPacket(uid, Packet{"already_logged"});
@@ -72,8 +72,10 @@ void PacketHandler::handleIncomingPacket(Uid uid, const Packet &packet)
         handleOutgoingPacket(uid, Packet{"game_ended"});
     }
     catch (GameException &exception) {
-        app.getLogger().log("game exception problem: " + std::string(exception.what()), Logger::Level::Error);
+        LOG_ERROR(app.getLogger(), "game exception problem: ", exception.what());
     }
+
+    return false;
 }
 
 void PacketHandler::handleOutgoingPacket(Uid uid, const Packet &packet)
@@ -87,7 +89,18 @@ void PacketHandler::handleOutgoingPacket(Uid uid, const Packet &packet)
     }
 }
 
-void PacketHandler::handleLogin(Uid uid, Packet packet)
+void PacketHandler::handleOutgoingPackets(Uid uid, const std::vector<Packet> &packets)
+{
+    try {
+        Connection &connection = app.getConnection(uid);
+        connection.send(packets);
+    }
+    catch (ConnectionNotExistsException &exception){
+        // can not send packets
+    }
+}
+
+bool PacketHandler::handleLogin(Uid uid, Packet packet)
 {
     auto items = packet.getItems();
 
@@ -105,54 +118,107 @@ void PacketHandler::handleLogin(Uid uid, Packet packet)
     else {
         handleOutgoingPacket(uid, Packet{"login_failed", {"format"}});
     }
+
+    return true;
 }
 
-void PacketHandler::handlePoke(Uid uid, Packet packet)
+bool PacketHandler::handlePoke(Uid uid, Packet packet)
 {
     validateItemsCount(std::move(packet), 0);
     handleOutgoingPacket(uid, Packet{"poke_back"});
+
+    return true;
 }
 
-void PacketHandler::handlePokeBack(Uid uid, Packet packet)
+bool PacketHandler::handlePokeBack(Uid uid, Packet packet)
 {
-    validateItemsCount(std::move(packet), 0);
+    ClockSync &clockSync = app.getConnection(uid).getClockSync();
+    Timestamp now = app.getCurrentTimestamp();
+
+    // the client time in the poke_back is optional, without it only the round trip is measured
+    if (packet.getItems().empty()) {
+        clockSync.pokeReturned(now);
+    }
+    else {
+        validateItemsCount(packet, 1);
+        clockSync.pokeReturned(now, strToTimestamp(packet.getItems()[0]));
+    }
+
+    return true;
 }
 
-void PacketHandler::handleJoin(Uid uid, Packet packet)
+bool PacketHandler::handleJoin(Uid uid, Packet packet)
 {
     validateItemsCount(std::move(packet), 0);
     app.joinGame(uid);
+
+    return true;
 }
 
-void PacketHandler::handleLeave(Uid uid, Packet packet)
+bool PacketHandler::handleSpectate(Uid uid, Packet packet)
+{
+    validateItemsCount(packet, 1);
+
+    Uid gameUid;
+
+    try {
+        gameUid = std::stoi(packet.getItems()[0]);
+    }
+    catch (std::logic_error &exception) {
+        throw MalformedPacketException{"invalid game uid"};
+    }
+
+    app.spectateGame(uid, gameUid);
+
+    return true;
+}
+
+bool PacketHandler::handleLeave(Uid uid, Packet packet)
 {
     validateItemsCount(std::move(packet), 0);
     app.leaveGame(uid);
+
+    return true;
 }
 
-void PacketHandler::handleTime(Uid uid, Packet packet)
+bool PacketHandler::handleTime(Uid uid, Packet packet)
 {
     validateItemsCount(packet, 1);
 
-    packet.addItem(timestampToStr(app.getCurrentTimestamp()));
+    Timestamp now = app.getCurrentTimestamp();
+
+    packet.addItem(timestampToStr(now));
     handleOutgoingPacket(uid, packet);
+
+    return true;
 }
 
-void PacketHandler::handleReady(Uid uid, Packet packet)
+bool PacketHandler::handleReady(Uid uid, Packet packet)
 {
     validateItemsCount(std::move(packet), 0);
     app.getConnectionGame(uid).eventPlayerReady(uid);
+
+    return true;
 }
 
-void PacketHandler::handleRestart(Uid uid, Packet packet)
+bool PacketHandler::handleRestart(Uid uid, Packet packet)
 {
     validateItemsCount(std::move(packet), 0);
     app.getConnectionGame(uid).eventPlayerRestart(uid);
+
+    return true;
 }
 
-void PacketHandler::handleState(Uid uid, Packet packet)
+bool PacketHandler::handleState(Uid uid, Packet packet)
 {
     validateItemsCount(packet, PlayerState::ITEMS_COUNT);
     PlayerState state{packet.getItems()};
-    app.getConnectionGame(uid).eventPlayerUpdate(uid, state);
+
+    // normalize the client timestamp to the server clock
+    ClockSync &clockSync = app.getConnection(uid).getClockSync();
+    Timestamp now = app.getCurrentTimestamp();
+
+    PlayerState normalized{clockSync.toServerTime(state.timestamp(), now), state.position(), state.direction()};
+
+    return app.getConnectionGame(uid).eventPlayerUpdate(uid, normalized, clockSync.getJitter());
 }
@@ -11,7 +11,8 @@ class PacketHandler
 {
     App &app;
 
-    typedef void (PacketHandler::*Handler)(Uid, Packet);
+    // a handler returns whether the packet took effect, the game may reject a state
+    typedef bool (PacketHandler::*Handler)(Uid, Packet);
 
     const std::unordered_map<std::string, Handler> PACKET_HANDLERS{
         // connection test
@@ -20,6 +21,7 @@ class PacketHandler
         // connection management
         {"login", &PacketHandler::handleLogin},
         {"join", &PacketHandler::handleJoin},
+        {"spectate", &PacketHandler::handleSpectate},
         // game
         {"time", &PacketHandler::handleTime},
         {"ready", &PacketHandler::handleReady},
@@ -28,22 +30,24 @@ class PacketHandler
         {"leave", &PacketHandler::handleLeave},
     };
 
-    void handleLogin(Uid uid, Packet packet);
-    void handlePoke(Uid uid, Packet packet);
-    void handlePokeBack(Uid uid, Packet packet);
-    void handleJoin(Uid uid, Packet packet);
-    void handleLeave(Uid uid, Packet packet);
-    void handleTime(Uid uid, Packet packet);
-    void handleReady(Uid uid, Packet packet);
-    void handleRestart(Uid uid, Packet packet);
-    void handleState(Uid uid, Packet packet);
+    bool handleLogin(Uid uid, Packet packet);
+    bool handlePoke(Uid uid, Packet packet);
+    bool handlePokeBack(Uid uid, Packet packet);
+    bool handleJoin(Uid uid, Packet packet);
+    bool handleSpectate(Uid uid, Packet packet);
+    bool handleLeave(Uid uid, Packet packet);
+    bool handleTime(Uid uid, Packet packet);
+    bool handleReady(Uid uid, Packet packet);
+    bool handleRestart(Uid uid, Packet packet);
+    bool handleState(Uid uid, Packet packet);
 
     void validateItemsCount(Packet packet, size_t count);
 
 public:
     explicit PacketHandler(App &app);
-    void handleIncomingPacket(Uid uid, const Packet &packet);
+    bool handleIncomingPacket(Uid uid, const Packet &packet);
     void handleOutgoingPacket(Uid uid, const Packet &packet);
+    void handleOutgoingPackets(Uid uid, const std::vector<Packet> &packets);
 };
 
 
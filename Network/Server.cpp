@@ -9,7 +9,8 @@
 
 Server::Server(App &app, Port port, std::string ip)
     : app(app),
-      port(port)
+      port(port),
+      socket(-1)
 {
     // set up address structure
     memset(&address, 0, sizeof(address));
@@ -61,7 +62,7 @@ Server::before()
 
     if (socket == -1) {
         std::string message = "cannot create a socket for listening: " + std::string{std::strerror(errno)};
-        app.getLogger().log(message, Logger::Level::Error);
+        LOG_ERROR(app.getLogger(), message);
         throw ServerException(message);
     }
 
@@ -75,7 +76,7 @@ Server::before()
 
     if (returnValue == -1) {
         std::string message = "can not set the socket option to reuse address: " + std::string{std::strerror(errno)};
-        app.getLogger().log(message, Logger::Level::Error);
+        LOG_ERROR(app.getLogger(), message);
         throw ServerException(message);
     }
 
@@ -84,16 +85,16 @@ Server::before()
 
     if (returnValue != 0) {
         std::string message = "can not bind the server address to the socket: " + std::string{strerror(errno)};
-        app.getLogger().log(message, Logger::Level::Error);
+        LOG_ERROR(app.getLogger(), message);
         throw ServerException(message);
     }
 
-    // start listening on the socket
-    returnValue = ::listen(socket, 5);
+    // start listening on the socket, a popular match brings many spectators at once
+    returnValue = ::listen(socket, SOMAXCONN);
 
     if (returnValue != 0) {
         std::string message = "can not listen on the socket: " + std::string{strerror(errno)};
-        app.getLogger().log(message, Logger::Level::Error);
+        LOG_ERROR(app.getLogger(), message);
         throw ServerException(message);
     }
 }
@@ -101,7 +102,7 @@ Server::before()
 void
 Server::run()
 {
-    app.getLogger().log("server running");
+    LOG_DEFAULT(app.getLogger(), "server running");
 
     // loop for accepting the new connections
     while (!shouldStop()) {
@@ -119,9 +120,11 @@ Server::run()
                 break;
             }
 
-            app.getLogger()
-                .log("error while accepting the connection: " + std::string{std::strerror(errno)},
-                     Logger::Level::Error);
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_ERROR(app.getLogger(), "error while accepting the connection: ", std::strerror(errno));
             return;
         }
 
@@ -129,14 +132,13 @@ Server::run()
         try {
             Connection &connection = app.registerConnection(clientSocket, clientAddress);
 
-            app.getLogger()
-                .log("connection accepted: uid = " + std::to_string(connection.getUid())
-                         + " ip = " + connection.getIp()
-                         + " port = " + std::to_string(connection.getPort()), Logger::Level::Success);
+            LOG_SUCCESS(app.getLogger(),
+                        "connection accepted: uid = ", connection.getUid(),
+                        " ip = ", connection.getAdress().sin_addr,
+                        " port = ", connection.getPort());
         }
         catch (ServerFullException &exception) {
-            app.getLogger()
-                .log("connection refused: server full", Logger::Level::Warning);
+            LOG_WARNING(app.getLogger(), "connection refused: server full");
         }
     }
 }
@@ -154,7 +156,7 @@ Server::after()
 {
     ::close(socket);
     socket = -1;
-    app.getLogger().log("server stopped");
+    LOG_DEFAULT(app.getLogger(), "server stopped");
 }
 
 std::string
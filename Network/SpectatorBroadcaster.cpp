@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <sys/uio.h>
+
+#include "SpectatorBroadcaster.h"
+#include "Connection.h"
+#include "../App.h"
+
+SpectatorBroadcaster::SpectatorBroadcaster(App &app)
+    : app(app)
+{}
+
+SpectatorBroadcaster::Frame SpectatorBroadcaster::serialize(const std::vector<Packet> &packets)
+{
+    auto contents = std::make_shared<std::string>();
+
+    for (auto &packet : packets) {
+        *contents += packet.serialize();
+    }
+
+    return contents;
+}
+
+void SpectatorBroadcaster::push(Command command)
+{
+    auto lock = acquireLock();
+
+    commands.push_back(std::move(command));
+    notifyOne();
+}
+
+void SpectatorBroadcaster::addSpectator(Uid game, Uid spectator, Frame snapshot)
+{
+    Connection &connection = app.getConnection(spectator);
+
+    auto lock = acquireLock();
+
+    // from now on the sends of the connection are queued here, one being written is finished first
+    owned.insert(spectator);
+    connection.setSpectating(true);
+
+    commands.push_back(Command{CommandType::Subscribe, game, spectator, std::move(snapshot), 0, true});
+    notifyOne();
+}
+
+void SpectatorBroadcaster::removeSpectator(Uid spectator)
+{
+    push(Command{CommandType::Unsubscribe, -1, spectator, nullptr, 0, false});
+}
+
+bool SpectatorBroadcaster::forward(Uid spectator, const std::string &contents, size_t packetsCount)
+{
+    auto lock = acquireLock();
+
+    if (!owned.count(spectator)) {
+        // already handed back, the connection writes itself
+        return false;
+    }
+
+    commands.push_back(Command{
+        CommandType::Send, -1, spectator, std::make_shared<std::string>(contents), packetsCount, true});
+    notifyOne();
+
+    return true;
+}
+
+void SpectatorBroadcaster::publishFrame(Uid game, Frame frame, size_t packetsCount, bool essential)
+{
+    push(Command{CommandType::Publish, game, -1, std::move(frame), packetsCount, essential});
+}
+
+void SpectatorBroadcaster::closeGame(Uid game)
+{
+    push(Command{CommandType::Close, game, -1, nullptr, 0, false});
+}
+
+void SpectatorBroadcaster::subscribe(Uid game, Uid spectator, const Frame &snapshot)
+{
+    unsubscribe(spectator);
+
+    // the snapshot follows whatever is still queued for the spectator
+    Spectator &subscribed = spectators[spectator];
+    subscribed.game = game;
+    subscribed.backlog.push_back(Pending{snapshot, 0});
+    subscribed.backlogBytes += snapshot->size();
+
+    gamesSpectators[game].push_back(spectator);
+}
+
+void SpectatorBroadcaster::unsubscribe(Uid spectator)
+{
+    auto found = spectators.find(spectator);
+
+    if (found == spectators.end()) {
+        return;
+    }
+
+    auto game = gamesSpectators.find(found->second.game);
+
+    if (game != gamesSpectators.end()) {
+        auto &uids = game->second;
+        uids.erase(std::remove(uids.begin(), uids.end(), spectator), uids.end());
+
+        if (uids.empty()) {
+            gamesSpectators.erase(game);
+        }
+    }
+
+    // the backlog is still sent, the spectator is released once it is empty
+    found->second.game = -1;
+}
+
+void SpectatorBroadcaster::send(Uid spectator, const Frame &frame)
+{
+    Spectator &target = spectators[spectator];
+    target.backlog.push_back(Pending{frame, 0});
+    target.backlogBytes += frame->size();
+}
+
+void SpectatorBroadcaster::close(Uid game)
+{
+    auto found = gamesSpectators.find(game);
+
+    if (found == gamesSpectators.end()) {
+        return;
+    }
+
+    // the spectators still get the rest of the game, game_ended included
+    for (Uid spectator : found->second) {
+        spectators[spectator].game = -1;
+    }
+
+    gamesSpectators.erase(found);
+}
+
+bool SpectatorBroadcaster::flush(Connection &connection, Spectator &spectator)
+{
+    const size_t MAX_BUFFERS{16};
+
+    while (!spectator.backlog.empty()) {
+        iovec buffers[MAX_BUFFERS];
+        size_t count{0};
+
+        for (auto &pending : spectator.backlog) {
+            if (count == MAX_BUFFERS) {
+                break;
+            }
+
+            buffers[count].iov_base = const_cast<char *>(pending.frame->data() + pending.offset);
+            buffers[count].iov_len = pending.frame->size() - pending.offset;
+            count++;
+        }
+
+        ssize_t sent = connection.sendNonBlocking(buffers, count);
+
+        if (sent < 0) {
+            return false;
+        }
+
+        if (sent == 0) {
+            // socket buffer full, the rest waits for the next round
+            return true;
+        }
+
+        auto remaining = static_cast<size_t>(sent);
+        spectator.backlogBytes -= remaining;
+
+        while (remaining > 0) {
+            Pending &pending = spectator.backlog.front();
+            size_t left = pending.frame->size() - pending.offset;
+
+            if (remaining < left) {
+                pending.offset += remaining;
+                break;
+            }
+
+            remaining -= left;
+            spectator.backlog.pop_front();
+        }
+    }
+
+    return true;
+}
+
+void SpectatorBroadcaster::cut(Connection &connection, const Spectator &spectator, bool failed)
+{
+    // the backlog can be discarded only between two packets, otherwise the client would read a broken one
+    bool midPacket = !spectator.backlog.empty() && spectator.backlog.front().offset > 0;
+
+    if (failed || midPacket) {
+        connection.stop(false);
+    }
+}
+
+void SpectatorBroadcaster::drop(Uid spectator)
+{
+    LOG_WARNING(app.getLogger(), spectator, " - spectator too slow - dropped");
+    app.getStats().addSpectatorsDropped(1);
+    unsubscribe(spectator);
+
+    auto found = spectators.find(spectator);
+
+    if (found != spectators.end()) {
+        found->second.backlog.clear();
+        found->second.backlogBytes = 0;
+    }
+}
+
+void SpectatorBroadcaster::publish(const Command &command)
+{
+    auto found = gamesSpectators.find(command.game);
+
+    if (found == gamesSpectators.end()) {
+        return;
+    }
+
+    std::vector<Uid> dropped;
+    uint64_t skipped{0};
+
+    app.forEachConnection(found->second, [&](Connection &connection) {
+        Spectator &spectator = spectators[connection.getUid()];
+
+        if (!spectator.backlog.empty() && !command.essential) {
+            // degraded, a lagging spectator gets only the ball and score events
+            skipped++;
+        } else {
+            spectator.backlog.push_back(Pending{command.frame, 0});
+            spectator.backlogBytes += command.frame->size();
+            app.getStats().addPacketsSent(command.packetsCount);
+        }
+
+        bool failed = !flush(connection, spectator);
+
+        if (failed || spectator.backlogBytes > BACKLOG_LIMIT) {
+            cut(connection, spectator, failed);
+            dropped.push_back(connection.getUid());
+        }
+    });
+
+    for (Uid spectator : dropped) {
+        drop(spectator);
+    }
+
+    app.getStats().addSpectatorFramesSkipped(skipped);
+}
+
+void SpectatorBroadcaster::flushLagging()
+{
+    std::vector<Uid> lagging;
+
+    for (auto &spectator : spectators) {
+        if (!spectator.second.backlog.empty()) {
+            lagging.push_back(spectator.first);
+        }
+    }
+
+    if (lagging.empty()) {
+        return;
+    }
+
+    std::vector<Uid> dropped;
+    std::unordered_set<Uid> closed{lagging.begin(), lagging.end()};
+
+    app.forEachConnection(lagging, [&](Connection &connection) {
+        closed.erase(connection.getUid());
+        Spectator &spectator = spectators[connection.getUid()];
+
+        if (!flush(connection, spectator)) {
+            cut(connection, spectator, true);
+            dropped.push_back(connection.getUid());
+        }
+    });
+
+    for (Uid spectator : dropped) {
+        drop(spectator);
+    }
+
+    // the backlog of a closed connection is never sent, it is released as empty
+    for (Uid spectator : closed) {
+        unsubscribe(spectator);
+        spectators[spectator].backlog.clear();
+        spectators[spectator].backlogBytes = 0;
+    }
+}
+
+void SpectatorBroadcaster::release()
+{
+    std::vector<Uid> idle;
+
+    for (auto &spectator : spectators) {
+        if (spectator.second.game == -1 && spectator.second.backlog.empty()) {
+            idle.push_back(spectator.first);
+        }
+    }
+
+    if (idle.empty()) {
+        return;
+    }
+
+    std::unordered_set<Uid> closed{idle.begin(), idle.end()};
+
+    app.forEachConnection(idle, [&](Connection &connection) {
+        Uid uid = connection.getUid();
+        closed.erase(uid);
+
+        auto lock = acquireLock();
+
+        // a send queued meanwhile is written first, the connection gets its writes back after it
+        bool queued = std::any_of(commands.begin(), commands.end(), [uid](const Command &command) {
+            return command.spectator == uid;
+        });
+
+        if (!queued) {
+            owned.erase(uid);
+            connection.setSpectating(false);
+            spectators.erase(uid);
+        }
+    });
+
+    // nobody writes to a closed connection any more
+    auto lock = acquireLock();
+
+    for (Uid uid : closed) {
+        owned.erase(uid);
+        spectators.erase(uid);
+    }
+}
+
+void SpectatorBroadcaster::run()
+{
+    while (!shouldStop()) {
+        {
+            auto lock = acquireLock();
+            waitFor(lock, FLUSH_PERIOD, [this]() {
+                return shouldStop() || !commands.empty();
+            });
+
+            processing.swap(commands);
+        }
+
+        for (auto &command : processing) {
+            switch (command.type) {
+            case CommandType::Subscribe: {
+                subscribe(command.game, command.spectator, command.frame);
+                break;
+            }
+            case CommandType::Unsubscribe: {
+                unsubscribe(command.spectator);
+                break;
+            }
+            case CommandType::Publish: {
+                publish(command);
+                break;
+            }
+            case CommandType::Send: {
+                send(command.spectator, command.frame);
+                break;
+            }
+            case CommandType::Close: {
+                close(command.game);
+                break;
+            }
+            }
+        }
+
+        processing.clear();
+
+        flushLagging();
+        release();
+    }
+}
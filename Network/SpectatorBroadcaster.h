@@ -0,0 +1,107 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Packet.h"
+#include "../Types.h"
+#include "../Utils/Thread.h"
+
+class App;
+class Connection;
+
+/**
+ * Fans the event stream of games out to their spectators.
+ * A game serializes each frame once, the same buffer is then sent to every spectator of the game
+ * with non-blocking sends from this thread, so that spectators never slow down the players.
+ * A spectator that can not keep up skips the frames with player states only (degraded)
+ * and is dropped when its backlog exceeds BACKLOG_LIMIT.
+ *
+ * While subscribed, the broadcaster is the only writer of the spectator's socket, the other packets
+ * for it are queued behind its frames. The writes are handed back to the connection only once
+ * the backlog is sent, and a spectator dropped in the middle of a packet is disconnected.
+ */
+class SpectatorBroadcaster: public Thread
+{
+public:
+    typedef std::shared_ptr<const std::string> Frame;
+
+    const size_t BACKLOG_LIMIT{64 * 1024};
+    const std::chrono::milliseconds FLUSH_PERIOD{50};
+
+private:
+    enum class CommandType
+    {
+        Subscribe,
+        Unsubscribe,
+        Publish,
+        Send,
+        Close
+    };
+
+    struct Command
+    {
+        CommandType type;
+        Uid game;
+        Uid spectator;
+        Frame frame;
+        size_t packetsCount;
+        bool essential;
+    };
+
+    struct Pending
+    {
+        Frame frame;
+        size_t offset;
+    };
+
+    struct Spectator
+    {
+        // not watching any game, only the backlog is being sent
+        Uid game{-1};
+        std::deque<Pending> backlog;
+        size_t backlogBytes{0};
+    };
+
+    App &app;
+
+    std::vector<Command> commands;
+    std::vector<Command> processing;
+
+    // spectators whose writes the broadcaster owns, guarded by the lock like the commands
+    std::unordered_set<Uid> owned;
+
+    // owned by the broadcaster thread only
+    std::unordered_map<Uid, Spectator> spectators;
+    std::unordered_map<Uid, std::vector<Uid>> gamesSpectators;
+
+    void push(Command command);
+    void subscribe(Uid game, Uid spectator, const Frame &snapshot);
+    void unsubscribe(Uid spectator);
+    void send(Uid spectator, const Frame &frame);
+    void close(Uid game);
+    void publish(const Command &command);
+    void flushLagging();
+    void release();
+
+    bool flush(Connection &connection, Spectator &spectator);
+    void cut(Connection &connection, const Spectator &spectator, bool failed);
+    void drop(Uid spectator);
+
+public:
+    explicit SpectatorBroadcaster(App &app);
+
+    static Frame serialize(const std::vector<Packet> &packets);
+
+    void addSpectator(Uid game, Uid spectator, Frame snapshot);
+    void removeSpectator(Uid spectator);
+    bool forward(Uid spectator, const std::string &contents, size_t packetsCount);
+    void publishFrame(Uid game, Frame frame, size_t packetsCount, bool essential);
+    void closeGame(Uid game);
+
+    void run() override;
+};
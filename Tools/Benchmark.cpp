@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "Benchmark.h"
+#include "../Utils/Text.h"
+
+namespace
+{
+    std::string fixed(double value)
+    {
+        std::stringstream stream;
+        stream << std::fixed << std::setprecision(1) << value;
+        return stream.str();
+    }
+
+    std::string jsonString(const std::string &string)
+    {
+        std::string escaped{"\""};
+
+        for (char character : string) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+            }
+            escaped += character;
+        }
+
+        return escaped + "\"";
+    }
+}
+
+Benchmark::Benchmark(Options options)
+    : options(std::move(options))
+{
+    this->options.repetitions = std::max(1u, this->options.repetitions);
+}
+
+int64_t Benchmark::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Benchmark::isSelected(const std::string &name) const
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+void Benchmark::measure(const std::string &name, size_t threads, const std::function<int64_t(uint64_t)> &run)
+{
+    // warm up the caches and find how many iterations last the minimal time
+    uint64_t iterations{1};
+
+    while (run(iterations) < options.minMicros * 1000 && iterations < (1ull << 40)) {
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+
+    for (unsigned i = 0; i < options.repetitions; ++i) {
+        samples.push_back(static_cast<double>(run(iterations)) / iterations);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    results.push_back({name, threads, iterations, samples[samples.size() / 2], samples.front(), samples.back()});
+}
+
+void Benchmark::run(const std::string &name, const Body &body)
+{
+    if (!isSelected(name)) {
+        return;
+    }
+
+    measure(name, 1, [&body](uint64_t iterations) {
+        int64_t start = now();
+        body(iterations);
+        return now() - start;
+    });
+}
+
+void Benchmark::runConcurrent(const std::string &name, size_t threads, const Body &body)
+{
+    if (!isSelected(name)) {
+        return;
+    }
+
+    measure(name, threads, [&body, threads](uint64_t iterations) {
+        std::atomic<size_t> waiting{threads};
+        std::vector<std::thread> workers;
+
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&body, &waiting, iterations]() {
+                // all the threads start together, so that they really contend
+                waiting.fetch_sub(1);
+                while (waiting.load() > 0) {
+                    std::this_thread::yield();
+                }
+
+                body(iterations);
+            });
+        }
+
+        while (waiting.load() > 0) {
+            std::this_thread::yield();
+        }
+
+        int64_t start = now();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        return now() - start;
+    });
+}
+
+const std::vector<Benchmark::Result> &Benchmark::getResults() const
+{
+    return results;
+}
+
+void Benchmark::writeTable(std::ostream &stream) const
+{
+    stream << Text::justifyL("benchmark", 48)
+           << Text::justifyL("iterations", 14)
+           << Text::justifyL("ns/op", 12)
+           << Text::justifyL("min", 12)
+           << "max" << std::endl;
+    stream << Text::hline(98) << std::endl;
+
+    for (auto &result : results) {
+        stream << Text::justifyL(result.name, 48)
+               << Text::justifyL(std::to_string(result.iterations), 14)
+               << Text::justifyL(fixed(result.nanosPerOp), 12)
+               << Text::justifyL(fixed(result.nanosMin), 12)
+               << fixed(result.nanosMax) << std::endl;
+    }
+}
+
+void Benchmark::writeJson(std::ostream &stream, const std::string &label) const
+{
+    std::time_t time = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&time));
+
+    stream << "{\n";
+    stream << "  \"context\": {\n";
+    stream << "    \"label\": " << jsonString(label) << ",\n";
+    stream << "    \"date\": " << jsonString(date) << ",\n";
+    stream << "    \"cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    stream << "    \"min_time_us\": " << options.minMicros << ",\n";
+    stream << "    \"repetitions\": " << options.repetitions << "\n";
+    stream << "  },\n";
+    stream << "  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+
+        stream << (i ? "," : "") << "\n    {"
+               << "\"name\": " << jsonString(result.name) << ", "
+               << "\"threads\": " << result.threads << ", "
+               << "\"iterations\": " << result.iterations << ", "
+               << std::fixed << std::setprecision(2)
+               << "\"ns_per_op\": " << result.nanosPerOp << ", "
+               << "\"ns_min\": " << result.nanosMin << ", "
+               << "\"ns_max\": " << result.nanosMax << "}";
+    }
+
+    stream << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal microbenchmark runner. Every case is a body running the given number of iterations,
+ * the iterations are doubled until one run lasts the minimal time, then the run is repeated
+ * and the median time per iteration is reported.
+ */
+class Benchmark
+{
+public:
+    struct Options
+    {
+        std::string filter{};
+        int64_t minMicros{200 * 1000};
+        unsigned repetitions{5};
+    };
+
+    struct Result
+    {
+        std::string name;
+        size_t threads;
+        uint64_t iterations;
+        double nanosPerOp;
+        double nanosMin;
+        double nanosMax;
+    };
+
+    typedef std::function<void(uint64_t iterations)> Body;
+
+    // keeps the value alive, so that the compiler can not drop the computation of it
+    template<typename T>
+    static void keep(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+private:
+    Options options;
+    std::vector<Result> results;
+
+    static int64_t now();
+
+    bool isSelected(const std::string &name) const;
+    void measure(const std::string &name, size_t threads, const std::function<int64_t(uint64_t)> &run);
+
+public:
+    explicit Benchmark(Options options);
+
+    void run(const std::string &name, const Body &body);
+
+    // every thread runs the iterations at once, the time per iteration is the one seen by a single thread
+    void runConcurrent(const std::string &name, size_t threads, const Body &body);
+
+    const std::vector<Result> &getResults() const;
+
+    void writeTable(std::ostream &stream) const;
+    void writeJson(std::ostream &stream, const std::string &label) const;
+};
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "LatencyBenchmark.h"
+#include "../Exceptions.h"
+#include "../Game/Physics.h"
+
+const Timestamp LatencyBenchmark::NUDGE_MILLIS;
+const Timestamp LatencyBenchmark::SETUP_TIMEOUT;
+const int LatencyBenchmark::TICK_MILLIS;
+
+namespace
+{
+    LoadGenerator::Options backgroundOptions(const LatencyBenchmark::Options &options)
+    {
+        LoadGenerator::Options background;
+        background.port = options.port;
+        background.clients = options.games * 2;
+        background.threads = options.threads;
+        background.stateRate = options.stateRate;
+        background.duration = options.duration;
+        background.seed = options.seed;
+
+        return background;
+    }
+
+    BallState parseBallState(const Packet &packet)
+    {
+        auto &items = packet.getItems();
+
+        if (items.size() != 5) {
+            throw std::invalid_argument("ball state must have 5 items");
+        }
+
+        return BallState{
+            strToTimestamp(items[0]),
+            items[1] == "left" ? Side::Left : Side::Right,
+            static_cast<Position>(std::stoi(items[2])),
+            static_cast<Angle>(std::stoi(items[3])),
+            static_cast<Speed>(std::stoi(items[4]))};
+    }
+}
+
+PlayerState LatencyBenchmark::Probe::stateAt(Timestamp timestamp) const
+{
+    if (timestamp >= resting.timestamp()) {
+        return {timestamp, resting.position(), PlayerDirection::Stop};
+    }
+
+    Position position = expectedPlayerPosition(moving.position(), moving.direction(), timestamp - moving.timestamp());
+    return {timestamp, position, moving.direction()};
+}
+
+LatencyBenchmark::LatencyBenchmark(Options options)
+    : options(options),
+      logs{options.logDirectory},
+      app{options.port, "127.0.0.1", options.games * 2 + 2 + 8, App::DEFAULT_BROADCAST_RATE, "", 0, "", logs.getPath()},
+      background{backgroundOptions(options)},
+      resolutionLead{0},
+      statesSuperseded{0},
+      errorPackets{0}
+{
+    // the packets are still captured, only not printed over the progress
+    app.getLogger().getCapture().setEcho(false);
+
+    left.nickname = "probeLeft";
+    right.nickname = "probeRight";
+}
+
+const Histogram &LatencyBenchmark::getStateLatency() const
+{
+    return stateLatency;
+}
+
+const Histogram &LatencyBenchmark::getHitLatency() const
+{
+    return hitLatency;
+}
+
+uint64_t LatencyBenchmark::getStatesSuperseded() const
+{
+    return statesSuperseded;
+}
+
+uint64_t LatencyBenchmark::getErrorPackets() const
+{
+    return errorPackets;
+}
+
+const LoadGenerator &LatencyBenchmark::getBackground() const
+{
+    return background;
+}
+
+LatencyBenchmark::Probe &LatencyBenchmark::getOpponent(Probe &probe)
+{
+    return &probe == &left ? right : left;
+}
+
+bool LatencyBenchmark::isPlaying() const
+{
+    return left.ballComing || right.ballComing;
+}
+
+void LatencyBenchmark::connect(Probe &probe)
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    Timestamp deadline = app.getCurrentTimestamp() + SETUP_TIMEOUT;
+
+    // the server of the app starts listening on its own thread
+    while (true) {
+        probe.socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (probe.socket == -1) {
+            throw ConnectionException("can not create the probe socket");
+        }
+
+        if (::connect(probe.socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+            break;
+        }
+
+        ::close(probe.socket);
+        probe.socket = -1;
+
+        if (app.getCurrentTimestamp() > deadline) {
+            throw ConnectionException("can not connect the probe to the server");
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+
+    int parameter = 1;
+    ::setsockopt(probe.socket, IPPROTO_TCP, TCP_NODELAY, &parameter, sizeof(parameter));
+
+    send(probe, Packet{"login", {probe.nickname}});
+}
+
+void LatencyBenchmark::send(Probe &probe, const Packet &packet)
+{
+    std::string contents = packet.serialize();
+
+    if (::send(probe.socket, contents.data(), contents.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(contents.size())) {
+        throw ConnectionException("the probe " + probe.nickname + " can not send");
+    }
+}
+
+void LatencyBenchmark::receive(Probe &probe)
+{
+    char buffer[4096];
+    ssize_t bytesRead = ::recv(probe.socket, buffer, sizeof(buffer), 0);
+
+    if (bytesRead == -1 && errno == EINTR) {
+        return;
+    }
+
+    if (bytesRead <= 0) {
+        throw ConnectionException("the probe " + probe.nickname + " was disconnected");
+    }
+
+    for (ssize_t i = 0; i < bytesRead; ++i) {
+        if (buffer[i] == Packet::TERMINATOR) {
+            handle(probe, Packet::parse(probe.input));
+            probe.input.clear();
+        }
+        else {
+            probe.input += buffer[i];
+        }
+    }
+}
+
+void LatencyBenchmark::handle(Probe &probe, const Packet &packet)
+{
+    // taken first, so that the handling does not count
+    Clock &clock = app.getClock();
+    int64_t receivedAt = clock.monotonicMicros();
+
+    const std::string &type = packet.getType();
+
+    if (type == "opponent_state") {
+        Probe &opponent = getOpponent(probe);
+        auto sent = opponent.statesSent.find(strToTimestamp(packet.getItems().at(0)));
+
+        if (sent == opponent.statesSent.end()) {
+            return;
+        }
+
+        stateLatency.record(receivedAt - sent->second);
+
+        // the older states were coalesced into this one
+        statesSuperseded += static_cast<uint64_t>(std::distance(opponent.statesSent.begin(), sent));
+        opponent.statesSent.erase(opponent.statesSent.begin(), std::next(sent));
+    }
+    else if (type == "ball_released" || type == "ball_hit") {
+        BallState ballState = parseBallState(packet);
+
+        if (type == "ball_hit") {
+            // the hit carries the ball as it arrived, the game resolves it ahead of the arrival
+            int64_t resolvedAt = clock.toMonotonic(ballState.timestamp() - resolutionLead) * 1000;
+            hitLatency.record(std::max<int64_t>(0, receivedAt - resolvedAt));
+        }
+
+        planMovement(probe, ballState, type == "ball_released");
+    }
+    else if (type == "poke") {
+        send(probe, Packet{"poke_back", {timestampToStr(app.getCurrentTimestamp())}});
+    }
+    else if (type == "logged") {
+        send(probe, Packet{"join"});
+    }
+    else if (type == "joined") {
+        probe.side = packet.getItems().at(0) == "left" ? Side::Left : Side::Right;
+        probe.joined = true;
+    }
+    else if (type == "new_round") {
+        send(probe, Packet{"ready"});
+    }
+    else if (type == "game_over") {
+        send(probe, Packet{"restart"});
+    }
+    else if (type == "opponent_left" || type == "game_ended") {
+        throw GameException("the game of the probes ended");
+    }
+    else if (type == "impossible_state" || type == "malformed_packet" || type == "not_in_game") {
+        ++errorPackets;
+    }
+}
+
+void LatencyBenchmark::sendState(Probe &probe, const PlayerState &state)
+{
+    // the server accepts only newer states
+    if (state.timestamp() <= probe.lastStateAt) {
+        return;
+    }
+
+    probe.lastStateAt = state.timestamp();
+    probe.statesSent[state.timestamp()] = app.getClock().monotonicMicros();
+
+    send(probe, Packet{"state", state.itemize()});
+}
+
+void LatencyBenchmark::planMovement(Probe &probe, const BallState &ballState, bool fromCenter)
+{
+    Side toSide = ballState.side() == Side::Left ? Side::Right : Side::Left;
+
+    probe.ballComing = probe.side == toSide;
+
+    if (!probe.ballComing) {
+        return;
+    }
+
+    BallState arrival = ballArrival(ballState, fromCenter, toSide);
+    int aim = std::max<int>(PLAYER_POSITION_MIN, std::min<int>(PLAYER_POSITION_MAX, arrival.position()));
+
+    Timestamp at = std::max(app.getCurrentTimestamp(), probe.lastStateAt + 1);
+    PlayerState current = probe.stateAt(at);
+
+    if (aim == current.position()) {
+        return;
+    }
+
+    PlayerDirection direction = aim > current.position() ? PlayerDirection::Up : PlayerDirection::Down;
+    auto travel = static_cast<Timestamp>(std::ceil(std::abs(aim - current.position()) / PLAYER_SPEED_PER_MS));
+
+    probe.moving = PlayerState{at, current.position(), direction};
+    probe.resting = PlayerState{
+        at + travel,
+        expectedPlayerPosition(current.position(), direction, travel),
+        PlayerDirection::Stop};
+    probe.restingSent = false;
+
+    sendState(probe, probe.moving);
+}
+
+void LatencyBenchmark::tick(Probe &probe)
+{
+    Timestamp now = app.getCurrentTimestamp();
+
+    // the stop exactly where the movement ends, the server predicts the paddle until then
+    if (!probe.restingSent && now >= probe.resting.timestamp()) {
+        probe.restingSent = true;
+        sendState(probe, probe.resting);
+    }
+
+    // the ball heads to the opponent, the paddle goes up and down by turns to produce states
+    if (!probe.ballComing && probe.restingSent && probe.joined && now >= probe.nextNudgeAt) {
+        Timestamp at = std::max(now, probe.lastStateAt + 1);
+        PlayerState current = probe.stateAt(at);
+        PlayerDirection direction = probe.nudge;
+
+        probe.nudge = direction == PlayerDirection::Up ? PlayerDirection::Down : PlayerDirection::Up;
+        probe.nextNudgeAt = at + options.nudgePeriod;
+
+        probe.moving = PlayerState{at, current.position(), direction};
+        probe.resting = PlayerState{
+            at + NUDGE_MILLIS,
+            expectedPlayerPosition(current.position(), direction, NUDGE_MILLIS),
+            PlayerDirection::Stop};
+        probe.restingSent = false;
+
+        sendState(probe, probe.moving);
+    }
+}
+
+void LatencyBenchmark::pump(int timeoutMillis)
+{
+    pollfd sockets[2]{};
+    Probe *probes[2]{&left, &right};
+    nfds_t count{0};
+
+    for (Probe *probe : probes) {
+        if (probe->socket != -1) {
+            sockets[count].fd = probe->socket;
+            sockets[count].events = POLLIN;
+            ++count;
+        }
+    }
+
+    if (::poll(sockets, count, timeoutMillis) <= 0) {
+        return;
+    }
+
+    for (nfds_t i = 0; i < count; ++i) {
+        if (sockets[i].revents) {
+            receive(sockets[i].fd == left.socket ? left : right);
+        }
+    }
+}
+
+void LatencyBenchmark::setUp()
+{
+    app.setInteractive(false);
+    app.start();
+
+    // the probes are paired with each other before the background clients join
+    connect(left);
+
+    Timestamp deadline = app.getCurrentTimestamp() + SETUP_TIMEOUT;
+
+    while (!left.joined && app.getCurrentTimestamp() < deadline) {
+        pump(TICK_MILLIS);
+    }
+
+    connect(right);
+
+    while (!isPlaying() && app.getCurrentTimestamp() < deadline) {
+        pump(TICK_MILLIS);
+    }
+
+    if (!isPlaying()) {
+        throw GameException("the probes did not start a game");
+    }
+
+    app.forEachGame([this](Game &game) {
+        resolutionLead = game.TIME_THRESHOLD.count();
+    });
+
+    if (options.games) {
+        load = std::thread{[this]() {
+            std::ostream discard{nullptr};
+            background.run(discard);
+        }};
+    }
+}
+
+void LatencyBenchmark::measure(std::ostream &progress)
+{
+    Timestamp start = app.getCurrentTimestamp();
+    Timestamp nextProgressAt = start + 1000;
+
+    while (app.getCurrentTimestamp() < start + options.duration) {
+        pump(TICK_MILLIS);
+        tick(left);
+        tick(right);
+
+        if (app.getCurrentTimestamp() >= nextProgressAt) {
+            nextProgressAt += 1000;
+
+            progress << "t=" << (nextProgressAt - start) / 1000 - 1 << "s"
+                     << " states: " << stateLatency.getCount()
+                     << " p50 " << stateLatency.getPercentile(0.5) << " us"
+                     << " p99 " << stateLatency.getPercentile(0.99) << " us"
+                     << " | hits: " << hitLatency.getCount()
+                     << " p50 " << hitLatency.getPercentile(0.5) << " us"
+                     << " p99 " << hitLatency.getPercentile(0.99) << " us"
+                     << " | background packets: " << background.get(LoadGenerator::PacketsSent)
+                     << std::endl;
+        }
+    }
+}
+
+void LatencyBenchmark::tearDown()
+{
+    for (Probe *probe : {&left, &right}) {
+        if (probe->socket != -1) {
+            ::close(probe->socket);
+            probe->socket = -1;
+        }
+    }
+
+    // the background load runs out its duration
+    if (load.joinable()) {
+        load.join();
+    }
+
+    // the threads of the app must end before it is destroyed
+    app.stop(true);
+}
+
+void LatencyBenchmark::run(std::ostream &progress)
+{
+    try {
+        setUp();
+        measure(progress);
+    }
+    catch (std::exception &exception) {
+        tearDown();
+        throw;
+    }
+
+    tearDown();
+}
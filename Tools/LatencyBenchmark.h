@@ -0,0 +1,111 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "LoadGenerator.h"
+#include "LogDirectory.h"
+#include "../App.h"
+#include "../Utils/Histogram.h"
+
+/**
+ * Runs the server in-process on loopback and plays one game on it with two instrumented clients,
+ * while the load generator keeps other games busy in the background. Both clients read the clock of the app,
+ * so the send and receive times of a packet are comparable to the microsecond.
+ *
+ * Measured are the time from a client sending its state to the opponent receiving it as opponent_state,
+ * and the time from the scheduled resolution of the ball (its arrival ahead by the game's time threshold)
+ * to the delivery of ball_hit. The lag compensation of the resolution is counted in, on loopback it stays
+ * within a millisecond.
+ */
+class LatencyBenchmark
+{
+public:
+    struct Options
+    {
+        Port port{8291};
+        size_t games{0};
+        size_t threads{2};
+        unsigned stateRate{30};
+        Timestamp duration{30 * 1000};
+        Timestamp nudgePeriod{50};
+        unsigned seed{1};
+        std::string logDirectory{};
+    };
+
+    // a nudge moves the paddle that long and stops it, each one is two broadcast states
+    static const Timestamp NUDGE_MILLIS{20};
+    static const Timestamp SETUP_TIMEOUT{5000};
+    static const int TICK_MILLIS{1};
+
+private:
+    struct Probe
+    {
+        std::string nickname;
+        int socket{-1};
+        Side side{Side::Left};
+        bool joined{false};
+        std::string input;
+
+        PlayerState moving{};
+        PlayerState resting{};
+        bool restingSent{true};
+        Timestamp lastStateAt{0};
+
+        // while the ball heads to the opponent the paddle is free to be nudged
+        bool ballComing{false};
+        Timestamp nextNudgeAt{0};
+        PlayerDirection nudge{PlayerDirection::Up};
+
+        // client timestamp of the states not delivered to the opponent yet -> monotonic micros of sending
+        std::map<Timestamp, int64_t> statesSent;
+
+        PlayerState stateAt(Timestamp timestamp) const;
+    };
+
+    Options options;
+    LogDirectory logs;
+    App app;
+    LoadGenerator background;
+    std::thread load;
+
+    Probe left;
+    Probe right;
+    Timestamp resolutionLead;
+
+    Histogram stateLatency;
+    Histogram hitLatency;
+    uint64_t statesSuperseded;
+    uint64_t errorPackets;
+
+    void connect(Probe &probe);
+    void send(Probe &probe, const Packet &packet);
+    void receive(Probe &probe);
+    void handle(Probe &probe, const Packet &packet);
+    void sendState(Probe &probe, const PlayerState &state);
+    void planMovement(Probe &probe, const BallState &ballState, bool fromCenter);
+    void tick(Probe &probe);
+    void pump(int timeoutMillis);
+
+    void setUp();
+    void measure(std::ostream &progress);
+    void tearDown();
+
+    Probe &getOpponent(Probe &probe);
+    bool isPlaying() const;
+
+public:
+    explicit LatencyBenchmark(Options options);
+    LatencyBenchmark(const LatencyBenchmark &benchmark) = delete;
+
+    // runs for the whole duration, printing a progress line every second
+    void run(std::ostream &progress);
+
+    const Histogram &getStateLatency() const;
+    const Histogram &getHitLatency() const;
+    uint64_t getStatesSuperseded() const;
+    uint64_t getErrorPackets() const;
+    const LoadGenerator &getBackground() const;
+};
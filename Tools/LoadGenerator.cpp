@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "LoadGenerator.h"
+#include "../Game/Physics.h"
+#include "../Utils/Histogram.h"
+#include "../Utils/Text.h"
+
+const int LoadGenerator::TICK_MILLIS;
+const Timestamp LoadGenerator::TIME_PROBE_PERIOD;
+const size_t LoadGenerator::EVENTS_COUNT;
+
+namespace
+{
+    // everything the server answers when the client got the protocol wrong
+    bool isErrorPacket(const std::string &type)
+    {
+        static const std::vector<std::string> types{
+            "malformed_packet", "unknown_packet", "impossible_state", "login_failed",
+            "already_logged", "not_logged", "already_in_game", "not_in_game"};
+
+        return std::find(types.begin(), types.end(), type) != types.end();
+    }
+
+    BallState parseBallState(const Packet &packet)
+    {
+        auto &items = packet.getItems();
+
+        if (items.size() != 5) {
+            throw std::invalid_argument("ball state must have 5 items");
+        }
+
+        return BallState{
+            strToTimestamp(items[0]),
+            items[1] == "left" ? Side::Left : Side::Right,
+            static_cast<Position>(std::stoi(items[2])),
+            static_cast<Angle>(std::stoi(items[3])),
+            static_cast<Speed>(std::stoi(items[4]))};
+    }
+}
+
+PlayerState LoadGenerator::Client::stateAt(Timestamp timestamp) const
+{
+    if (timestamp >= resting.timestamp()) {
+        return {timestamp, resting.position(), PlayerDirection::Stop};
+    }
+
+    Position position = expectedPlayerPosition(moving.position(), moving.direction(), timestamp - moving.timestamp());
+    return {timestamp, position, moving.direction()};
+}
+
+LoadGenerator::LoadGenerator(Options options)
+    : options(std::move(options)),
+      stopping{false}
+{}
+
+Timestamp LoadGenerator::now()
+{
+    // the server maps its clock to the wall clock, the states are sent in the same time base
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t LoadGenerator::monotonicMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t LoadGenerator::get(Counter counter) const
+{
+    return counters.get(counter);
+}
+
+void LoadGenerator::mergeRtt(Histogram &histogram) const
+{
+    rtt.mergeInto(histogram);
+}
+
+void LoadGenerator::open(Worker &worker, Client &client)
+{
+    client.socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (client.socket == -1) {
+        counters.add(Failed, 1);
+        client.phase = Phase::Closed;
+        return;
+    }
+
+    int parameter = 1;
+    ::setsockopt(client.socket, IPPROTO_TCP, TCP_NODELAY, &parameter, sizeof(parameter));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    ::inet_pton(AF_INET, options.ip.c_str(), &address.sin_addr);
+
+    int returnValue = ::connect(client.socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+
+    if (returnValue == -1 && errno != EINPROGRESS) {
+        counters.add(Failed, 1);
+        ::close(client.socket);
+        client.phase = Phase::Closed;
+        return;
+    }
+
+    // writable once connected
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = &client;
+    ::epoll_ctl(worker.epoll, EPOLL_CTL_ADD, client.socket, &event);
+    client.waitingWritable = true;
+}
+
+void LoadGenerator::close(Worker &worker, Client &client)
+{
+    if (client.phase == Phase::Closed) {
+        return;
+    }
+
+    counters.add(client.phase == Phase::Connecting ? Failed : Disconnected, 1);
+
+    ::epoll_ctl(worker.epoll, EPOLL_CTL_DEL, client.socket, nullptr);
+    ::close(client.socket);
+    client.phase = Phase::Closed;
+}
+
+void LoadGenerator::send(Worker &worker, Client &client, const Packet &packet)
+{
+    client.output += packet.serialize();
+    counters.add(PacketsSent, 1);
+
+    if (!client.waitingWritable) {
+        flush(worker, client);
+    }
+}
+
+void LoadGenerator::flush(Worker &worker, Client &client)
+{
+    while (!client.output.empty()) {
+        ssize_t sent = ::send(client.socket, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+
+        if (sent == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            close(worker, client);
+            return;
+        }
+
+        counters.add(BytesSent, static_cast<uint64_t>(sent));
+        client.output.erase(0, static_cast<size_t>(sent));
+    }
+
+    // the rest goes once the socket drains
+    bool waitingWritable = !client.output.empty();
+
+    if (waitingWritable != client.waitingWritable) {
+        epoll_event event{};
+        event.events = EPOLLIN | (waitingWritable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.ptr = &client;
+        ::epoll_ctl(worker.epoll, EPOLL_CTL_MOD, client.socket, &event);
+        client.waitingWritable = waitingWritable;
+    }
+}
+
+void LoadGenerator::receive(Worker &worker, Client &client)
+{
+    char buffer[4096];
+
+    while (client.phase != Phase::Closed) {
+        ssize_t bytesRead = ::recv(client.socket, buffer, sizeof(buffer), 0);
+
+        if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        if (bytesRead <= 0) {
+            close(worker, client);
+            return;
+        }
+
+        counters.add(BytesReceived, static_cast<uint64_t>(bytesRead));
+
+        for (ssize_t i = 0; i < bytesRead; ++i) {
+            if (buffer[i] == Packet::TERMINATOR) {
+                counters.add(PacketsReceived, 1);
+
+                try {
+                    handle(worker, client, Packet::parse(client.input));
+                }
+                catch (std::exception &exception) {
+                    counters.add(ErrorPackets, 1);
+                }
+
+                client.input.clear();
+
+                if (client.phase == Phase::Closed) {
+                    return;
+                }
+            }
+            else {
+                client.input += buffer[i];
+            }
+        }
+    }
+}
+
+void LoadGenerator::handle(Worker &worker, Client &client, const Packet &packet)
+{
+    const std::string &type = packet.getType();
+
+    if (type == "poke") {
+        send(worker, client, Packet{"poke_back", {timestampToStr(now())}});
+    }
+    else if (type == "logged") {
+        send(worker, client, Packet{"join"});
+    }
+    else if (type == "joined") {
+        client.side = packet.getItems().at(0) == "left" ? Side::Left : Side::Right;
+    }
+    else if (type == "new_round") {
+        client.phase = Phase::Lobby;
+        send(worker, client, Packet{"ready"});
+    }
+    else if (type == "ball_released" || type == "ball_hit") {
+        if (type == "ball_released" && client.side == Side::Left) {
+            counters.add(Serves, 1);
+        }
+        if (type == "ball_hit" && client.side == Side::Left) {
+            counters.add(Rallies, 1);
+        }
+
+        client.phase = Phase::Playing;
+        planMovement(worker, client, parseBallState(packet), type == "ball_released");
+    }
+    else if (type == "game_over") {
+        client.phase = Phase::Lobby;
+        counters.add(GamesOver, client.side == Side::Left ? 1 : 0);
+        send(worker, client, Packet{"restart"});
+    }
+    else if (type == "opponent_left" || type == "game_ended") {
+        // the game is gone, look for another one
+        client.phase = Phase::Lobby;
+        send(worker, client, Packet{"join"});
+    }
+    else if (type == "time") {
+        if (client.timeProbeSentAt) {
+            rtt.record(monotonicMicros() - client.timeProbeSentAt);
+            client.timeProbeSentAt = 0;
+        }
+    }
+    else if (isErrorPacket(type)) {
+        counters.add(ErrorPackets, 1);
+    }
+}
+
+void LoadGenerator::sendState(Worker &worker, Client &client, const PlayerState &state)
+{
+    // the server accepts only newer states
+    if (state.timestamp() <= client.lastStateAt) {
+        return;
+    }
+
+    client.lastStateAt = state.timestamp();
+    send(worker, client, Packet{"state", state.itemize()});
+}
+
+void LoadGenerator::planMovement(Worker &worker, Client &client, const BallState &ballState, bool fromCenter)
+{
+    Side toSide = ballState.side() == Side::Left ? Side::Right : Side::Left;
+
+    if (client.side != toSide) {
+        return;
+    }
+
+    BallState arrival = ballArrival(ballState, fromCenter, toSide);
+    int aim = arrival.position();
+
+    if (std::uniform_real_distribution<double>{0, 1}(client.randomGenerator) >= options.skill) {
+        // miss on purpose, aim a paddle height away from the ball
+        aim += std::bernoulli_distribution{0.5}(client.randomGenerator) ? PLAYER_HEIGHT : -PLAYER_HEIGHT;
+    }
+
+    aim = std::max<int>(PLAYER_POSITION_MIN, std::min<int>(PLAYER_POSITION_MAX, aim));
+
+    Timestamp at = std::max(now(), client.lastStateAt + 1);
+    PlayerState current = client.stateAt(at);
+
+    if (aim == current.position()) {
+        return;
+    }
+
+    PlayerDirection direction = aim > current.position() ? PlayerDirection::Up : PlayerDirection::Down;
+    auto travel = static_cast<Timestamp>(std::ceil(std::abs(aim - current.position()) / PLAYER_SPEED_PER_MS));
+
+    client.moving = PlayerState{at, current.position(), direction};
+    client.resting = PlayerState{
+        at + travel,
+        expectedPlayerPosition(current.position(), direction, travel),
+        PlayerDirection::Stop};
+    client.restingSent = false;
+
+    sendState(worker, client, client.moving);
+}
+
+void LoadGenerator::tick(Worker &worker, Client &client)
+{
+    if (client.phase == Phase::Closed || client.phase == Phase::Connecting) {
+        return;
+    }
+
+    Timestamp now = LoadGenerator::now();
+
+    if (now >= client.nextTimeProbeAt && !client.timeProbeSentAt) {
+        client.timeProbeSentAt = monotonicMicros();
+        client.nextTimeProbeAt = now + TIME_PROBE_PERIOD;
+        send(worker, client, Packet{"time", {timestampToStr(now)}});
+    }
+
+    if (client.phase != Phase::Playing) {
+        return;
+    }
+
+    // the stop exactly where the movement ends, the server predicts the paddle until then
+    if (!client.restingSent && now >= client.resting.timestamp()) {
+        client.restingSent = true;
+        sendState(worker, client, client.resting);
+    }
+
+    if (options.stateRate && now >= client.nextStateAt) {
+        client.nextStateAt = now + 1000 / options.stateRate;
+        sendState(worker, client, client.stateAt(now));
+    }
+}
+
+void LoadGenerator::runWorker(size_t index)
+{
+    Worker worker;
+    worker.epoll = ::epoll_create1(EPOLL_CLOEXEC);
+
+    for (size_t i = index; i < options.clients; i += options.threads) {
+        auto client = std::unique_ptr<Client>(new Client{});
+        client->index = i;
+        client->randomGenerator.seed(options.seed + static_cast<unsigned>(i));
+        client->nextTimeProbeAt = now() + static_cast<Timestamp>(client->randomGenerator() % TIME_PROBE_PERIOD);
+
+        open(worker, *client);
+        worker.clients.push_back(std::move(client));
+    }
+
+    epoll_event events[EVENTS_COUNT];
+
+    while (!stopping) {
+        int count = ::epoll_wait(worker.epoll, events, EVENTS_COUNT, TICK_MILLIS);
+
+        for (int i = 0; i < count; ++i) {
+            auto &client = *static_cast<Client *>(events[i].data.ptr);
+
+            if (client.phase == Phase::Closed) {
+                continue;
+            }
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close(worker, client);
+                continue;
+            }
+
+            if (client.phase == Phase::Connecting && (events[i].events & EPOLLOUT)) {
+                client.phase = Phase::Lobby;
+                counters.add(Connected, 1);
+                send(worker, client, Packet{"login", {"lg" + std::to_string(client.index)}});
+            }
+            else if (events[i].events & EPOLLOUT) {
+                flush(worker, client);
+            }
+
+            if (events[i].events & EPOLLIN) {
+                receive(worker, client);
+            }
+        }
+
+        for (auto &client : worker.clients) {
+            tick(worker, *client);
+        }
+    }
+
+    for (auto &client : worker.clients) {
+        if (client->phase != Phase::Closed) {
+            ::close(client->socket);
+        }
+    }
+
+    ::close(worker.epoll);
+}
+
+void LoadGenerator::run(std::ostream &progress)
+{
+    std::vector<std::thread> workers;
+
+    for (size_t i = 0; i < options.threads; ++i) {
+        workers.emplace_back(&LoadGenerator::runWorker, this, i);
+    }
+
+    progress << Text::justifyL("second", 8) << Text::justifyL("clients", 10)
+             << Text::justifyL("sent/s", 10) << Text::justifyL("received/s", 12)
+             << Text::justifyL("errors", 8) << Text::justifyL("rallies", 10)
+             << Text::justifyL("rtt p50 us", 12) << "rtt p99 us" << std::endl;
+
+    uint64_t lastSent{0};
+    uint64_t lastReceived{0};
+
+    for (Timestamp second = 1; second * 1000 <= options.duration; ++second) {
+        std::this_thread::sleep_for(std::chrono::seconds{1});
+
+        Histogram rttMerged;
+        mergeRtt(rttMerged);
+
+        uint64_t sent = get(PacketsSent);
+        uint64_t received = get(PacketsReceived);
+
+        progress << Text::justifyL(std::to_string(second), 8)
+                 << Text::justifyL(std::to_string(get(Connected) - get(Disconnected)), 10)
+                 << Text::justifyL(std::to_string(sent - lastSent), 10)
+                 << Text::justifyL(std::to_string(received - lastReceived), 12)
+                 << Text::justifyL(std::to_string(get(ErrorPackets)), 8)
+                 << Text::justifyL(std::to_string(get(Rallies)), 10)
+                 << Text::justifyL(std::to_string(rttMerged.getPercentile(0.5)), 12)
+                 << rttMerged.getPercentile(0.99) << std::endl;
+
+        lastSent = sent;
+        lastReceived = received;
+    }
+
+    stopping = true;
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Types.h"
+#include "../Game/BallState.h"
+#include "../Game/PlayerState.h"
+#include "../Network/Packet.h"
+#include "../Utils/ShardedCounters.h"
+#include "../Utils/ShardedHistogram.h"
+
+/**
+ * Drives many protocol accurate clients against a running server over real sockets. Every worker thread
+ * multiplexes its share of the clients with epoll, the clients log in, pair into games, answer the pokes
+ * and stream their paddle states, moving to where the ball will arrive.
+ */
+class LoadGenerator
+{
+public:
+    struct Options
+    {
+        std::string ip{"127.0.0.1"};
+        Port port{8191};
+        size_t clients{1000};
+        size_t threads{4};
+        unsigned stateRate{30};
+        Timestamp duration{60 * 1000};
+        double skill{0.9};
+        unsigned seed{1};
+    };
+
+    enum Counter
+    {
+        Connected,
+        Disconnected,
+        Failed,
+        PacketsSent,
+        PacketsReceived,
+        BytesSent,
+        BytesReceived,
+        ErrorPackets,
+        Serves,
+        Rallies,
+        GamesOver,
+        COUNTERS_COUNT
+    };
+
+    static const int TICK_MILLIS{5};
+    static const Timestamp TIME_PROBE_PERIOD{1000};
+    static const size_t EVENTS_COUNT{256};
+
+private:
+    enum class Phase
+    {
+        Connecting,
+        Lobby,
+        Playing,
+        Closed
+    };
+
+    struct Client
+    {
+        size_t index;
+        int socket{-1};
+        Phase phase{Phase::Connecting};
+        Side side{Side::Left};
+        std::string input;
+        std::string output;
+        bool waitingWritable{false};
+
+        // the paddle moves until the resting state, like the scripted players of the simulation
+        PlayerState moving{};
+        PlayerState resting{};
+        bool restingSent{true};
+        Timestamp lastStateAt{0};
+        Timestamp nextStateAt{0};
+
+        Timestamp nextTimeProbeAt{0};
+        int64_t timeProbeSentAt{0};
+
+        std::default_random_engine randomGenerator{};
+
+        PlayerState stateAt(Timestamp timestamp) const;
+    };
+
+    struct Worker
+    {
+        int epoll{-1};
+        std::vector<std::unique_ptr<Client>> clients;
+    };
+
+    Options options;
+    ShardedCounters<COUNTERS_COUNT> counters;
+    ShardedHistogram rtt;
+    std::atomic<bool> stopping;
+
+    static Timestamp now();
+    static int64_t monotonicMicros();
+
+    void open(Worker &worker, Client &client);
+    void close(Worker &worker, Client &client);
+    void send(Worker &worker, Client &client, const Packet &packet);
+    void flush(Worker &worker, Client &client);
+    void receive(Worker &worker, Client &client);
+    void handle(Worker &worker, Client &client, const Packet &packet);
+    void sendState(Worker &worker, Client &client, const PlayerState &state);
+    void planMovement(Worker &worker, Client &client, const BallState &ballState, bool fromCenter);
+    void tick(Worker &worker, Client &client);
+    void runWorker(size_t index);
+
+public:
+    explicit LoadGenerator(Options options);
+    LoadGenerator(const LoadGenerator &generator) = delete;
+
+    uint64_t get(Counter counter) const;
+    void mergeRtt(Histogram &histogram) const;
+
+    // runs for the whole duration, printing a progress line every second
+    void run(std::ostream &progress);
+};
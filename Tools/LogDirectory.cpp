@@ -0,0 +1,53 @@
+#include "LogDirectory.h"
+
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <utility>
+
+#include "../Exceptions.h"
+
+LogDirectory::LogDirectory(std::string path)
+    : path{std::move(path)},
+      temporary{this->path.empty()}
+{
+    if (temporary) {
+        char pattern[] = "/tmp/ups-logs.XXXXXX";
+
+        if (!::mkdtemp(pattern)) {
+            throw LoggerException("can not create a temporary directory for the logs");
+        }
+
+        this->path = pattern;
+    }
+}
+
+LogDirectory::~LogDirectory()
+{
+    if (!temporary) {
+        return;
+    }
+
+    DIR *directory = ::opendir(path.c_str());
+
+    if (!directory) {
+        return;
+    }
+
+    // the logger writes only plain files and links to them
+    while (dirent *entry = ::readdir(directory)) {
+        std::string name{entry->d_name};
+
+        if (name != "." && name != "..") {
+            ::unlink((path + "/" + name).c_str());
+        }
+    }
+
+    ::closedir(directory);
+    ::rmdir(path.c_str());
+}
+
+const std::string &LogDirectory::getPath() const
+{
+    return path;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Directory the in-process server of a tool logs to. Without a path a temporary one is created
+ * and removed together with the logs once the tool is done, so that the tool never rotates away
+ * the logs of a real server in the working directory.
+ */
+class LogDirectory
+{
+    std::string path;
+    bool temporary;
+
+public:
+    explicit LogDirectory(std::string path = "");
+    LogDirectory(const LogDirectory &directory) = delete;
+    ~LogDirectory();
+
+    const std::string &getPath() const;
+};
@@ -0,0 +1,169 @@
+#include <iomanip>
+#include <sstream>
+
+#include "Replay.h"
+#include "../Exceptions.h"
+
+ReplayedGame::ReplayedGame(App &app, Uid uid)
+    : Game(app, uid),
+      packets{0}
+{}
+
+void ReplayedGame::sendPacket(Uid, Packet)
+{
+    packets++;
+}
+
+void ReplayedGame::sendPackets(Uid, const std::vector<Packet> &packets)
+{
+    this->packets += packets.size();
+}
+
+uint64_t ReplayedGame::getPacketsCount() const
+{
+    return packets;
+}
+
+Replay::Replay(App &app, VirtualClock &clock, const ReplayReader &reader, std::ostream &output, bool verbose)
+    : app(app),
+      clock(clock),
+      reader(reader),
+      output(output),
+      verbose{verbose}
+{}
+
+std::string Replay::elapsed(Timestamp at) const
+{
+    std::ostringstream stream;
+    stream << "+" << std::fixed << std::setprecision(3) << (at - reader.getHeader().createdAt) / 1000.0 << " s";
+
+    return stream.str();
+}
+
+void Replay::mismatch(const ReplayEvent &event, const std::string &message)
+{
+    result.mismatches++;
+    output << elapsed(event.at) << " MISMATCH " << message << " (recorded: " << event.toLog() << ")" << std::endl;
+}
+
+void Replay::checkBall(ReplayedGame &game, const ReplayEvent &event)
+{
+    BallState expected = event.toBallState();
+    BallState replayed = game.getFutureBallState();
+
+    if (replayed.timestamp() != expected.timestamp()
+        || replayed.side() != expected.side()
+        || replayed.position() != expected.position()
+        || replayed.angle() != expected.angle()
+        || replayed.speed() != expected.speed()) {
+
+        mismatch(event, "ball arrives " + sideToStr(replayed.side())
+            + " at " + timestampToStr(replayed.timestamp())
+            + " " + ballPositionToStr(replayed.position()));
+    }
+}
+
+void Replay::apply(ReplayedGame &game, const ReplayEvent &event)
+{
+    Side side = event.getSide();
+
+    switch (event.getType()) {
+    case ReplayEventType::Seed: {
+        game.seed(static_cast<unsigned>(event.value));
+        break;
+    }
+    case ReplayEventType::Join: {
+        try {
+            app.login(event.value, "player" + std::to_string(event.value));
+        }
+        catch (AlreadyLoggedException &exception) {
+            // rejoined after a restart of the replay
+        }
+
+        game.eventPlayerJoin(event.value);
+        break;
+    }
+    case ReplayEventType::Ready: {
+        game.eventPlayerReady(game.getPlayerUid(side));
+        break;
+    }
+    case ReplayEventType::Serve: {
+        checkBall(game, event);
+        break;
+    }
+    case ReplayEventType::Update: {
+        bool accepted = game.eventPlayerUpdate(game.getPlayerUid(side), event.toPlayerState(), event.value);
+
+        if (accepted != static_cast<bool>(event.flags)) {
+            mismatch(event, std::string{"update "} + (accepted ? "accepted" : "rejected"));
+        }
+        break;
+    }
+    case ReplayEventType::Hit:
+    case ReplayEventType::Miss: {
+        BallState ball = game.getFutureBallState();
+        Position paddle = game.getPlayerStateAt(ball.side(), ball.timestamp()).position();
+
+        // the game resolves the ball itself, exactly like its thread did on the server
+        game.update(event.at);
+
+        if (paddle != event.paddle) {
+            mismatch(event, "paddle judged at " + std::to_string(paddle));
+        }
+
+        if (event.getType() == ReplayEventType::Hit) {
+            checkBall(game, event);
+            break;
+        }
+
+        result.points++;
+        result.scoreLeft = game.getPlayerScore(Side::Left);
+        result.scoreRight = game.getPlayerScore(Side::Right);
+
+        if (result.scoreLeft != event.value >> 16 || result.scoreRight != (event.value & 0xffff)) {
+            mismatch(event, "score " + scoreToStr(result.scoreLeft) + ":" + scoreToStr(result.scoreRight));
+        }
+
+        output << elapsed(event.at) << " point " << result.points << ": " << sideToStr(side) << " wins "
+               << scoreToStr(result.scoreLeft) << ":" << scoreToStr(result.scoreRight)
+               << ", ball " << ballPositionToStr(ball.position()) << " paddle " << paddle << std::endl;
+        break;
+    }
+    case ReplayEventType::Restart: {
+        game.eventPlayerRestart(game.getPlayerUid(side));
+        break;
+    }
+    case ReplayEventType::Leave: {
+        game.eventPlayerLeave(game.getPlayerUid(side));
+        break;
+    }
+    }
+}
+
+Replay::Result Replay::run()
+{
+    const ReplayHeader &header = reader.getHeader();
+
+    clock.set(header.createdAt);
+    ReplayedGame game{app, header.gameUid};
+
+    for (const ReplayEvent &event : reader) {
+        result.events++;
+
+        // the events are applied at the times the server applied them
+        clock.set(event.at);
+
+        if (verbose) {
+            output << elapsed(event.at) << " " << event.toLog() << std::endl;
+        }
+
+        try {
+            apply(game, event);
+        }
+        catch (GameException &exception) {
+            mismatch(event, std::string{"rejected: "} + exception.what());
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <ostream>
+
+#include "../App.h"
+#include "../Game/Game.h"
+#include "../Game/Replay.h"
+#include "../Utils/Clock.h"
+
+/**
+ * Game without sockets, the packets of a replayed game are only counted.
+ */
+class ReplayedGame: public Game
+{
+    uint64_t packets;
+
+protected:
+    void sendPacket(Uid uid, Packet packet) override;
+    void sendPackets(Uid uid, const std::vector<Packet> &packets) override;
+
+public:
+    ReplayedGame(App &app, Uid uid);
+
+    uint64_t getPacketsCount() const;
+};
+
+/**
+ * Re-runs a recorded game through the Game logic on a virtual clock set to the recorded times
+ * and checks that every ball transition and point comes out as it did on the server.
+ */
+class Replay
+{
+public:
+    struct Result
+    {
+        uint64_t events{0};
+        uint64_t points{0};
+        uint64_t mismatches{0};
+        Score scoreLeft{0};
+        Score scoreRight{0};
+    };
+
+private:
+    App &app;
+    VirtualClock &clock;
+    const ReplayReader &reader;
+    std::ostream &output;
+    bool verbose;
+
+    Result result;
+
+    std::string elapsed(Timestamp at) const;
+    void mismatch(const ReplayEvent &event, const std::string &message);
+    void checkBall(ReplayedGame &game, const ReplayEvent &event);
+    void apply(ReplayedGame &game, const ReplayEvent &event);
+
+public:
+    Replay(App &app, VirtualClock &clock, const ReplayReader &reader, std::ostream &output, bool verbose = false);
+
+    Result run();
+};
@@ -0,0 +1,301 @@
+#include <chrono>
+#include <cmath>
+
+#include "Simulation.h"
+#include "../Exceptions.h"
+
+const Timestamp Simulation::VIRTUAL_EPOCH;
+
+SimulatedGame::SimulatedGame(App &app, Simulation &simulation, size_t index)
+    : Game(app, static_cast<Uid>(index)),
+      simulation(simulation),
+      index(index)
+{}
+
+void SimulatedGame::sendPacket(Uid uid, Packet packet)
+{
+    simulation.deliver(index, uid, packet);
+}
+
+void SimulatedGame::sendPackets(Uid uid, const std::vector<Packet> &packets)
+{
+    for (auto &packet : packets) {
+        simulation.deliver(index, uid, packet);
+    }
+}
+
+bool Simulation::Input::operator>(const Input &input) const
+{
+    // inputs at the same time keep the order in which they were scheduled
+    return at != input.at ? at > input.at : sequence > input.sequence;
+}
+
+Simulation::Simulation(App &app, VirtualClock &clock, Options options)
+    : app(app),
+      clock(clock),
+      options(options),
+      inputsSequence{0},
+      batch{clock.timestamp()}
+{}
+
+void Simulation::schedule(Timestamp at, Uid uid, InputType type, PlayerState state)
+{
+    inputs.push(Input{at, inputsSequence++, uid, type, state, players[uid].plan});
+}
+
+PlayerState Simulation::Player::stateAt(Timestamp timestamp) const
+{
+    if (timestamp >= resting.timestamp()) {
+        return resting;
+    }
+
+    Position position = expectedPlayerPosition(moving.position(), moving.direction(), timestamp - moving.timestamp());
+    return {timestamp, position, moving.direction()};
+}
+
+void Simulation::planMovement(Player &player, Uid uid, const BallState &ballState, bool fromCenter)
+{
+    Side toSide = ballState.side() == Side::Left ? Side::Right : Side::Left;
+
+    if (player.side != toSide) {
+        return;
+    }
+
+    BallState arrival = ballArrival(ballState, fromCenter, toSide);
+    int aim = arrival.position();
+
+    if (std::uniform_real_distribution<double>{0, 1}(player.randomGenerator) >= options.skill) {
+        // miss on purpose, aim a paddle height away from the ball
+        aim += std::bernoulli_distribution{0.5}(player.randomGenerator) ? PLAYER_HEIGHT : -PLAYER_HEIGHT;
+    }
+
+    aim = std::max<int>(PLAYER_POSITION_MIN, std::min<int>(PLAYER_POSITION_MAX, aim));
+
+    // a new plan cancels the inputs of the previous one
+    player.plan++;
+
+    Timestamp at = std::max(clock.timestamp(), player.lastSent + 1);
+    PlayerState current = player.stateAt(at);
+
+    if (aim == current.position()) {
+        return;
+    }
+
+    PlayerDirection direction = aim > current.position() ? PlayerDirection::Up : PlayerDirection::Down;
+    auto travel = static_cast<Timestamp>(std::ceil(std::abs(aim - current.position()) / PLAYER_SPEED_PER_MS));
+
+    player.moving = PlayerState{at, current.position(), direction};
+    player.resting = PlayerState{
+        at + travel,
+        expectedPlayerPosition(current.position(), direction, travel),
+        PlayerDirection::Stop};
+    player.lastSent = at + travel;
+
+    schedule(at, uid, InputType::State, player.moving);
+    schedule(at + travel, uid, InputType::State, player.resting);
+}
+
+void Simulation::markDirty(size_t game)
+{
+    if (!dirty[game]) {
+        dirty[game] = true;
+        dirtyGames.push_back(game);
+    }
+}
+
+void Simulation::refreshRow(size_t game)
+{
+    SimulatedGame &simulatedGame = *games[game];
+
+    if (simulatedGame.getPhase() != GamePhase::Playing) {
+        batch.setIdle(game);
+        return;
+    }
+
+    // the paddle is stored as it will be at the arrival, so that the kernel judges exactly like the game
+    BallState futureBallState = simulatedGame.getFutureBallState();
+    batch.setBall(game, futureBallState);
+    batch.setPlayer(game, simulatedGame.getPlayerStateAt(futureBallState.side(), futureBallState.timestamp()));
+}
+
+void Simulation::applyInput(const Input &input)
+{
+    Player &player = players[input.uid];
+
+    if (input.type == InputType::State && input.plan != player.plan) {
+        return;
+    }
+
+    SimulatedGame &game = *games[player.game];
+
+    try {
+        switch (input.type) {
+        case InputType::State: {
+            game.eventPlayerUpdate(input.uid, input.state);
+            break;
+        }
+        case InputType::Ready: {
+            game.eventPlayerReady(input.uid);
+            break;
+        }
+        case InputType::Restart: {
+            game.eventPlayerRestart(input.uid);
+            break;
+        }
+        }
+    }
+    catch (GameException &exception) {
+        // input arrived in a wrong phase, a real client would get no answer either
+        result.rejectedInputs++;
+    }
+
+    markDirty(player.game);
+}
+
+void Simulation::deliver(size_t, Uid uid, const Packet &packet)
+{
+    // called by the games with their lock held, only schedules the reactions
+    result.packets++;
+
+    Player &player = players[uid];
+    const std::string &type = packet.getType();
+    Timestamp now = clock.timestamp();
+
+    if (type == "new_round") {
+        schedule(now + options.reaction, uid, InputType::Ready);
+    }
+    else if (type == "game_over") {
+        if (player.side == Side::Left) {
+            result.gamesOver++;
+        }
+        schedule(now + options.reaction, uid, InputType::Restart);
+    }
+    else if (type == "ball_released" || type == "ball_hit") {
+        auto &items = packet.getItems();
+        BallState ballState{
+            strToTimestamp(items[0]),
+            items[1] == "left" ? Side::Left : Side::Right,
+            static_cast<Position>(std::stoi(items[2])),
+            static_cast<Angle>(std::stoi(items[3])),
+            static_cast<Speed>(std::stoi(items[4]))};
+
+        planMovement(player, uid, ballState, type == "ball_released");
+    }
+    else if (type == "your_state") {
+        PlayerState state{packet.getItems()};
+        PlayerState expected = player.stateAt(state.timestamp());
+
+        if (state.position() != expected.position() || state.direction() != expected.direction()) {
+            // the server corrected the paddle, continue from its state
+            result.rejectedInputs++;
+            player.plan++;
+            player.moving = state;
+            player.resting = state;
+        }
+    }
+}
+
+Simulation::Result Simulation::run()
+{
+    auto wallStart = std::chrono::steady_clock::now();
+    Timestamp now = clock.timestamp();
+
+    games.reserve(options.games);
+    players.reserve(options.games * 2);
+    batch.reserve(options.games);
+    dirty.assign(options.games, false);
+
+    for (size_t i = 0; i < options.games; ++i) {
+        games.emplace_back(new SimulatedGame{app, *this, i});
+        batch.add();
+
+        for (Side side : {Side::Left, Side::Right}) {
+            auto uid = static_cast<Uid>(players.size());
+
+            Player player{i, side};
+            player.randomGenerator.seed(options.seed * 7919 + uid);
+            players.push_back(player);
+
+            app.login(uid, "player" + std::to_string(uid));
+        }
+    }
+
+    for (size_t i = 0; i < options.games; ++i) {
+        games[i]->seed(options.seed + static_cast<unsigned>(i));
+
+        for (Uid uid : {static_cast<Uid>(2 * i), static_cast<Uid>(2 * i + 1)}) {
+            games[i]->eventPlayerJoin(uid);
+            schedule(now, uid, InputType::Ready);
+        }
+    }
+
+    const Timestamp threshold = games.empty() ? 0 : games.front()->TIME_THRESHOLD.count();
+    const Timestamp end = now + options.duration;
+    std::vector<PhysicsBatch::Resolution> resolutions;
+    std::vector<size_t> framesKept;
+    std::vector<bool> framePending(options.games, false);
+
+    while (now < end) {
+
+        // scripted inputs
+        while (!inputs.empty() && inputs.top().at <= now) {
+            Input input = inputs.top();
+            inputs.pop();
+            applyInput(input);
+        }
+
+        // frames of the games with pending player states
+        for (size_t game : dirtyGames) {
+            dirty[game] = false;
+            refreshRow(game);
+
+            if (!framePending[game]) {
+                framePending[game] = true;
+                pendingFrames.push_back(game);
+            }
+        }
+        dirtyGames.clear();
+
+        framesKept.clear();
+        for (size_t game : pendingFrames) {
+            if (games[game]->eventFrame(now)) {
+                framesKept.push_back(game);
+            } else {
+                framePending[game] = false;
+            }
+        }
+        pendingFrames.swap(framesKept);
+
+        // ball resolutions of all games at once
+        resolutions.clear();
+        batch.resolve(now, threshold, resolutions);
+
+        for (auto &resolution : resolutions) {
+            SimulatedGame &game = *games[resolution.index];
+
+            if (resolution.hit) {
+                game.eventBallHit();
+                result.rallies++;
+            } else {
+                Side side = game.getFutureBallState().side();
+                game.eventBallMiss(side == Side::Left ? Side::Right : Side::Left);
+                result.points++;
+            }
+
+            refreshRow(resolution.index);
+        }
+
+        clock.advance(options.step);
+        now = clock.timestamp();
+    }
+
+    for (auto &game : games) {
+        result.checksum = result.checksum * 31 + game->getPlayerScore(Side::Left);
+        result.checksum = result.checksum * 31 + game->getPlayerScore(Side::Right);
+    }
+
+    result.virtualTime = options.duration;
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    return result;
+}
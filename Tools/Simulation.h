@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "../App.h"
+#include "../Game/Game.h"
+#include "../Game/Physics.h"
+#include "../Utils/Clock.h"
+
+class Simulation;
+
+/**
+ * Game without sockets, its outgoing packets are delivered to the scripted players of the simulation.
+ */
+class SimulatedGame: public Game
+{
+    Simulation &simulation;
+    size_t index;
+
+protected:
+    void sendPacket(Uid uid, Packet packet) override;
+    void sendPackets(Uid uid, const std::vector<Packet> &packets) override;
+
+public:
+    SimulatedGame(App &app, Simulation &simulation, size_t index);
+};
+
+/**
+ * Drives many games in-process on a virtual clock with seeded randomness and scripted paddle inputs.
+ * Ball resolutions of all games are found by the batched physics kernel,
+ * only the resulting hit / miss events are dispatched to the games.
+ */
+class Simulation
+{
+public:
+    struct Options
+    {
+        size_t games{1000};
+        unsigned seed{1};
+        Timestamp duration{10 * 60 * 1000};
+        Timestamp step{5};
+        Timestamp reaction{100};
+        double skill{0.9};
+    };
+
+    struct Result
+    {
+        uint64_t rallies{0};
+        uint64_t points{0};
+        uint64_t gamesOver{0};
+        uint64_t packets{0};
+        uint64_t rejectedInputs{0};
+        Timestamp virtualTime{0};
+        double wallSeconds{0};
+        uint64_t checksum{0};
+    };
+
+    // arbitrary fixed wall clock mapping, so that the runs are reproducible
+    static const Timestamp VIRTUAL_EPOCH{1500000000000};
+
+private:
+    enum class InputType
+    {
+        State,
+        Ready,
+        Restart
+    };
+
+    struct Input
+    {
+        Timestamp at;
+        uint64_t sequence;
+        Uid uid;
+        InputType type;
+        PlayerState state;
+        uint64_t plan;
+
+        bool operator>(const Input &input) const;
+    };
+
+    struct Player
+    {
+        size_t game;
+        Side side;
+
+        // the planned movement, moving until the resting state
+        PlayerState moving{};
+        PlayerState resting{};
+        Timestamp lastSent{0};
+        uint64_t plan{0};
+
+        std::default_random_engine randomGenerator{};
+
+        PlayerState stateAt(Timestamp timestamp) const;
+    };
+
+    App &app;
+    VirtualClock &clock;
+    Options options;
+    Result result;
+
+    std::vector<std::unique_ptr<SimulatedGame>> games;
+    std::vector<Player> players;
+    std::priority_queue<Input, std::vector<Input>, std::greater<Input>> inputs;
+    uint64_t inputsSequence;
+
+    PhysicsBatch batch;
+    std::vector<bool> dirty;
+    std::vector<size_t> dirtyGames;
+    std::vector<size_t> pendingFrames;
+
+    void schedule(Timestamp at, Uid uid, InputType type, PlayerState state = PlayerState{});
+    void planMovement(Player &player, Uid uid, const BallState &ballState, bool fromCenter);
+    void markDirty(size_t game);
+    void refreshRow(size_t game);
+    void applyInput(const Input &input);
+
+public:
+    Simulation(App &app, VirtualClock &clock, Options options);
+
+    void deliver(size_t game, Uid uid, const Packet &packet);
+    Result run();
+};
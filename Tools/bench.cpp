@@ -0,0 +1,390 @@
+#include <iostream>
+#include <fstream>
+#include <getopt.h>
+#include <cstdlib>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Benchmark.h"
+#include "LogDirectory.h"
+#include "../App.h"
+#include "../Exceptions.h"
+#include "../Game/Game.h"
+#include "../Game/Physics.h"
+
+/**
+ * Game without sockets, its outgoing packets are thrown away, so that only the game logic is measured.
+ */
+class BenchmarkGame: public Game
+{
+protected:
+    void sendPacket(Uid, Packet packet) override
+    {
+        Benchmark::keep(packet);
+    }
+
+    void sendPackets(Uid, const std::vector<Packet> &packets) override
+    {
+        Benchmark::keep(packets);
+    }
+
+public:
+    using Game::Game;
+};
+
+void printHelp(char *name)
+{
+    std::cout << "Microbenchmarks of the protocol and game logic hot paths." << std::endl;
+    std::cout << "Meant for an optimized build (-DCMAKE_BUILD_TYPE=Release), the JSON output is compared across commits."
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-f filter] [-m millis] [-r repetitions] [-t threads] [-j file] [-l label]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-f filter" << std::endl;
+    std::cout << "\t\tdefault = all" << std::endl;
+    std::cout << "\t\tRuns only the benchmarks whose name contains the filter." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-m millis" << std::endl;
+    std::cout << "\t\tdefault = 200" << std::endl;
+    std::cout << "\t\tMinimal duration of one measured run." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-r repetitions" << std::endl;
+    std::cout << "\t\tdefault = 5" << std::endl;
+    std::cout << "\t\tMeasured runs of every benchmark, the median one is reported." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t threads" << std::endl;
+    std::cout << "\t\tdefault = number of cores" << std::endl;
+    std::cout << "\t\tHighest number of threads of the contention benchmarks, doubled from 1." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-j file" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tWrites the results as JSON too." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-l label" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tLabel of the run in the JSON output, typically the commit." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+void benchmarkPackets(Benchmark &benchmark)
+{
+    const std::string contents{"state;1500000000123;-120;up"};
+    const Packet state = Packet::parse(contents);
+    const Packet ballHit{"ball_hit", BallState{1500000000123, Side::Right, -215, 37, 1240}.itemize()};
+
+    benchmark.run("Packet::parse/state", [&contents](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(Packet::parse(contents));
+        }
+    });
+
+    benchmark.run("Packet::serialize/state", [&state](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(state.serialize());
+        }
+    });
+
+    benchmark.run("Packet::serialize/ball_hit", [&ballHit](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(ballHit.serialize());
+        }
+    });
+
+    benchmark.run("Packet::toLog/ball_hit", [&ballHit](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(ballHit.toLog());
+        }
+    });
+}
+
+void benchmarkConverters(Benchmark &benchmark)
+{
+    const std::string timestamp{"1500000000123"};
+    const std::string position{"-120"};
+    const std::string direction{"down"};
+
+    benchmark.run("strToTimestamp", [&timestamp](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(strToTimestamp(timestamp));
+        }
+    });
+
+    benchmark.run("strToPlayerPosition", [&position](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(strToPlayerPosition(position));
+        }
+    });
+
+    benchmark.run("strToPlayerDirection", [&direction](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(strToPlayerDirection(direction));
+        }
+    });
+
+    benchmark.run("timestampToStr", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(timestampToStr(1500000000000 + static_cast<Timestamp>(i & 1023)));
+        }
+    });
+
+    benchmark.run("playerPositionToStr", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(playerPositionToStr(static_cast<Position>(i % 700) - 350));
+        }
+    });
+
+    benchmark.run("directionToStr", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(directionToStr(static_cast<PlayerDirection>(i % 3)));
+        }
+    });
+
+    benchmark.run("sideToStr", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(sideToStr(i & 1 ? Side::Left : Side::Right));
+        }
+    });
+}
+
+void benchmarkStates(Benchmark &benchmark)
+{
+    const std::vector<std::string> items = Packet::parse("state;1500000000123;-120;up").getItems();
+    const PlayerState playerState{items};
+    const BallState ballState{1500000000123, Side::Right, -215, 37, 1240};
+
+    benchmark.run("PlayerState/items", [&items](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(PlayerState{items});
+        }
+    });
+
+    benchmark.run("PlayerState::itemize", [&playerState](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(playerState.itemize());
+        }
+    });
+
+    benchmark.run("BallState", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(BallState{1500000000123, Side::Right, static_cast<Position>(i & 255), 37, 1240});
+        }
+    });
+
+    benchmark.run("BallState::itemize", [&ballState](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(ballState.itemize());
+        }
+    });
+}
+
+void benchmarkGame(Benchmark &benchmark, App &app)
+{
+    const BallState ballState{1500000000123, Side::Right, -215, 37, 1240};
+    const PlayerState playerState{1500000000123, -120, PlayerDirection::Up};
+
+    // the physics behind Game::nextBallState, Game::expectedPlayerState and Game::canHit
+    benchmark.run("ballArrival", [&ballState](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(ballArrival(ballState, false, Side::Left));
+        }
+    });
+
+    benchmark.run("expectedPlayerPosition", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(expectedPlayerPosition(-120, PlayerDirection::Up, static_cast<Timestamp>(i & 4095)));
+        }
+    });
+
+    benchmark.run("canHitBall", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(canHitBall(static_cast<Position>(i & 511) - 256, -215));
+        }
+    });
+
+    // the same through the game, with its locking and bookkeeping
+    const Uid left{1000};
+    const Uid right{1001};
+
+    app.login(left, "left");
+    app.login(right, "right");
+
+    BenchmarkGame game{app, 0};
+    game.seed(1);
+    game.eventPlayerJoin(left);
+    game.eventPlayerJoin(right);
+    game.eventPlayerReady(left);
+    game.eventPlayerReady(right);
+
+    benchmark.run("Game::getPlayerStateAt", [&game, &playerState](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Benchmark::keep(game.getPlayerStateAt(Side::Left, playerState.timestamp() + static_cast<Timestamp>(i & 4095)));
+        }
+    });
+
+    benchmark.run("Game::eventBallHit", [&game](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            game.eventBallHit();
+        }
+    });
+}
+
+void benchmarkDispatch(Benchmark &benchmark, App &app)
+{
+    // a real connection over a socket pair, the replies are drained by a thread
+    int sockets[2];
+
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        throw ConnectionException("can not create the socket pair");
+    }
+
+    std::thread drain([&sockets]() {
+        char buffer[4096];
+        while (::recv(sockets[1], buffer, sizeof(buffer), 0) > 0) {
+        }
+    });
+
+    Connection &connection = app.registerConnection(sockets[0], sockaddr_in{});
+    Uid uid = connection.getUid();
+    PacketHandler &packetHandler = app.getPacketHandler();
+
+    const Packet poke{"poke"};
+    const Packet time{"time", {"1500000000123"}};
+    const Packet login{"login", {"no"}};
+
+    benchmark.run("PacketHandler/poke", [&packetHandler, &poke, uid](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            packetHandler.handleIncomingPacket(uid, poke);
+        }
+    });
+
+    benchmark.run("PacketHandler/time", [&packetHandler, &time, uid](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            packetHandler.handleIncomingPacket(uid, time);
+        }
+    });
+
+    benchmark.run("PacketHandler/login_failed", [&packetHandler, &login, uid](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            packetHandler.handleIncomingPacket(uid, login);
+        }
+    });
+
+    // the connection closes its socket, which ends the draining
+    connection.stop(true);
+    drain.join();
+    ::close(sockets[1]);
+}
+
+void benchmarkStats(Benchmark &benchmark, size_t maxThreads)
+{
+    Stats stats;
+
+    for (size_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        benchmark.runConcurrent("Stats::addPacketsSent/threads:" + std::to_string(threads), threads,
+                                [&stats](uint64_t iterations) {
+                                    for (uint64_t i = 0; i < iterations; ++i) {
+                                        stats.addPacketsSent(1);
+                                        stats.addBytesSent(64);
+                                    }
+                                });
+
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Benchmark::Options options;
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::string jsonFile;
+    std::string label;
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "hf:m:r:t:j:l:")) != -1) {
+            switch (opt) {
+            case 'f': {
+                options.filter = optarg;
+                break;
+            }
+            case 'm': {
+                options.minMicros = std::stoll(std::string{optarg}) * 1000;
+                break;
+            }
+            case 'r': {
+                options.repetitions = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 't': {
+                maxThreads = std::max(1ul, std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'j': {
+                jsonFile = optarg;
+                break;
+            }
+            case 'l': {
+                label = optarg;
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        Benchmark benchmark{options};
+
+        {
+            // the log of the app is flushed when it ends, before the results are printed and its directory goes
+            LogDirectory logs;
+            App app{App::DEFAULT_PORT, "", App::DEFAUL_MAX_CONNECTIONS, App::DEFAULT_BROADCAST_RATE, "", 0, "", logs.getPath()};
+
+            // the handled packets are still captured, only not printed
+            app.getLogger().getCapture().setEcho(false);
+
+            benchmarkPackets(benchmark);
+            benchmarkConverters(benchmark);
+            benchmarkStates(benchmark);
+            benchmarkGame(benchmark, app);
+            benchmarkDispatch(benchmark, app);
+            benchmarkStats(benchmark, maxThreads);
+        }
+
+        std::cout << std::endl;
+        benchmark.writeTable(std::cout);
+
+        if (!jsonFile.empty()) {
+            std::ofstream json{jsonFile};
+
+            if (!json) {
+                throw std::runtime_error("can not write " + jsonFile);
+            }
+
+            benchmark.writeJson(json, label);
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
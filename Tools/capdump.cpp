@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <set>
+
+#include "../Network/PacketCapture.h"
+
+void printHelp(char *name)
+{
+    std::cout << "Renders a binary communication capture as text." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-t type]... [-u uid] file" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t type" << std::endl;
+    std::cout << "\t\tPrint only the packets of the type, can be repeated." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-u uid" << std::endl;
+    std::cout << "\t\tPrint only the packets of the connection." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+std::string formatTimestamp(int64_t micros)
+{
+    std::time_t seconds = static_cast<std::time_t>(micros / 1000000);
+    std::tm time{};
+    localtime_r(&seconds, &time);
+
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &time);
+
+    std::ostringstream stream;
+    stream << date << "." << std::setw(6) << std::setfill('0') << micros % 1000000;
+
+    return stream.str();
+}
+
+int main(int argc, char *argv[])
+{
+    std::set<uint8_t> types;
+    bool filterUid{false};
+    Uid uid{0};
+
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ht:u:")) != -1) {
+        switch (opt) {
+        case 't': {
+            types.insert(PacketCapture::typeId(optarg));
+            break;
+        }
+        case 'u': {
+            filterUid = true;
+            uid = static_cast<Uid>(std::stol(std::string{optarg}));
+            break;
+        }
+        case 'h': {
+            printHelp(argv[0]);
+            exit(EXIT_SUCCESS);
+        }
+        default: {
+            exit(EXIT_FAILURE);
+        }
+        }
+    }
+
+    if (optind != argc - 1) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    std::ifstream file{argv[optind], std::ios::in | std::ios::binary};
+
+    if (!file.is_open()) {
+        std::cout << "error: can not open " << argv[optind] << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    CaptureHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (!file || std::memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != CAPTURE_VERSION) {
+        std::cout << "error: " << argv[optind] << " is not a supported capture" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    CaptureRecord record{};
+    std::string contents;
+
+    while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+        contents.resize(record.length);
+
+        if (!file.read(&contents[0], record.length)) {
+            // cut off by a crash of the server
+            break;
+        }
+
+        if ((!types.empty() && !types.count(record.type)) || (filterUid && record.uid != uid)) {
+            continue;
+        }
+
+        std::cout << formatTimestamp(record.timestamp)
+                  << (record.incoming ? " <- " : " -> ")
+                  << record.uid << " " << contents << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+#include <thread>
+
+#include "LatencyBenchmark.h"
+#include "../Utils/Text.h"
+
+void printHelp(char *name)
+{
+    std::cout << "End-to-end latency benchmark, two instrumented clients play against an in-process server on loopback."
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-p port] [-g games] [-t threads] [-r rate] [-d seconds] [-n millis] [-s seed] [-l directory]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-p port" << std::endl;
+    std::cout << "\t\tdefault = 8291" << std::endl;
+    std::cout << "\t\tLoopback port of the in-process server." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-g games" << std::endl;
+    std::cout << "\t\tdefault = 0" << std::endl;
+    std::cout << "\t\tBackground games played by the load generator meanwhile." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t threads" << std::endl;
+    std::cout << "\t\tdefault = 2" << std::endl;
+    std::cout << "\t\tThreads of the load generator." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-r rate" << std::endl;
+    std::cout << "\t\tdefault = 30" << std::endl;
+    std::cout << "\t\tState packets per second of every background client." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-d seconds" << std::endl;
+    std::cout << "\t\tdefault = 30" << std::endl;
+    std::cout << "\t\tDuration of the measurement." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-n millis" << std::endl;
+    std::cout << "\t\tdefault = 50" << std::endl;
+    std::cout << "\t\tPeriod of the paddle nudges of the probes while the ball heads away." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-s seed" << std::endl;
+    std::cout << "\t\tdefault = 1" << std::endl;
+    std::cout << "\t\tSeed of the background clients." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-l directory" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tKeep the server logs in the directory, otherwise they go to a temporary one removed at the end." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+void printDistribution(const std::string &name, const Histogram &histogram)
+{
+    std::cout << Text::justifyL(name, 32)
+              << Text::justifyL(std::to_string(histogram.getCount()), 10)
+              << Text::justifyL(std::to_string(histogram.getPercentile(0.5)), 10)
+              << Text::justifyL(std::to_string(histogram.getPercentile(0.9)), 10)
+              << Text::justifyL(std::to_string(histogram.getPercentile(0.99)), 10)
+              << Text::justifyL(std::to_string(histogram.getPercentile(0.999)), 10)
+              << histogram.getMax() << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    LatencyBenchmark::Options options;
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "hp:g:t:r:d:n:s:l:")) != -1) {
+            switch (opt) {
+            case 'p': {
+                options.port = static_cast<Port>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'g': {
+                options.games = std::stoul(std::string{optarg});
+                break;
+            }
+            case 't': {
+                options.threads = std::max(1ul, std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'r': {
+                options.stateRate = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'd': {
+                options.duration = std::stoll(std::string{optarg}) * 1000;
+                break;
+            }
+            case 'n': {
+                options.nudgePeriod = std::max<Timestamp>(2 * LatencyBenchmark::NUDGE_MILLIS, std::stoll(std::string{optarg}));
+                break;
+            }
+            case 's': {
+                options.seed = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'l': {
+                options.logDirectory = optarg;
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        Histogram stateLatency;
+        Histogram hitLatency;
+        uint64_t backgroundSent, backgroundReceived, backgroundErrors, statesSuperseded, errorPackets;
+
+        {
+            LatencyBenchmark benchmark{options};
+            benchmark.run(std::cout);
+
+            stateLatency.merge(benchmark.getStateLatency());
+            hitLatency.merge(benchmark.getHitLatency());
+
+            const LoadGenerator &background = benchmark.getBackground();
+            backgroundSent = background.get(LoadGenerator::PacketsSent);
+            backgroundReceived = background.get(LoadGenerator::PacketsReceived);
+            backgroundErrors = background.get(LoadGenerator::ErrorPackets);
+            statesSuperseded = benchmark.getStatesSuperseded();
+            errorPackets = benchmark.getErrorPackets();
+
+            // the log of the in-process server is flushed when the benchmark ends, before the results are printed and its directory goes
+        }
+
+        double seconds = options.duration / 1000.0;
+
+        std::cout << std::endl;
+        std::cout << "background games: " << options.games
+                  << ", packets sent: " << backgroundSent / seconds << "/s"
+                  << ", received: " << backgroundReceived / seconds << "/s"
+                  << ", errors: " << backgroundErrors << std::endl;
+        std::cout << "probe states superseded: " << statesSuperseded
+                  << ", error packets: " << errorPackets << std::endl;
+        std::cout << std::endl;
+
+        std::cout << Text::justifyL("latency [us]", 32)
+                  << Text::justifyL("count", 10)
+                  << Text::justifyL("p50", 10)
+                  << Text::justifyL("p90", 10)
+                  << Text::justifyL("p99", 10)
+                  << Text::justifyL("p99.9", 10)
+                  << "max" << std::endl;
+        std::cout << Text::hline(92) << std::endl;
+
+        printDistribution("state -> opponent_state", stateLatency);
+        printDistribution("resolution -> ball_hit", hitLatency);
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
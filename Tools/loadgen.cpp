@@ -0,0 +1,140 @@
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+#include <thread>
+
+#include "LoadGenerator.h"
+#include "../Utils/Histogram.h"
+
+void printHelp(char *name)
+{
+    std::cout << "Load generator, simulates many protocol accurate clients playing against a running server." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-i ip] [-p port] [-c clients] [-t threads] [-r rate] [-d seconds] [-k skill] [-s seed]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-i ip" << std::endl;
+    std::cout << "\t\tdefault = 127.0.0.1" << std::endl;
+    std::cout << "\t\tAddress of the server." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-p port" << std::endl;
+    std::cout << "\t\tdefault = 8191" << std::endl;
+    std::cout << "\t\tPort of the server." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-c clients" << std::endl;
+    std::cout << "\t\tdefault = 1000" << std::endl;
+    std::cout << "\t\tNumber of simulated clients, the server must accept that many connections (its -c)." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t threads" << std::endl;
+    std::cout << "\t\tdefault = number of cores" << std::endl;
+    std::cout << "\t\tWorker threads, each one multiplexes its share of the clients." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-r rate" << std::endl;
+    std::cout << "\t\tdefault = 30" << std::endl;
+    std::cout << "\t\tState packets per second of every playing client, 0 sends only the movement changes." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-d seconds" << std::endl;
+    std::cout << "\t\tdefault = 60" << std::endl;
+    std::cout << "\t\tDuration of the load." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-k skill" << std::endl;
+    std::cout << "\t\tdefault = 0.9" << std::endl;
+    std::cout << "\t\tProbability that a client goes for the ball." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-s seed" << std::endl;
+    std::cout << "\t\tdefault = 1" << std::endl;
+    std::cout << "\t\tSeed of the clients." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    LoadGenerator::Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "hi:p:c:t:r:d:k:s:")) != -1) {
+            switch (opt) {
+            case 'i': {
+                options.ip = optarg;
+                break;
+            }
+            case 'p': {
+                options.port = static_cast<Port>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'c': {
+                options.clients = std::stoul(std::string{optarg});
+                break;
+            }
+            case 't': {
+                options.threads = std::max(1ul, std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'r': {
+                options.stateRate = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'd': {
+                options.duration = std::stoll(std::string{optarg}) * 1000;
+                break;
+            }
+            case 'k': {
+                options.skill = std::stod(std::string{optarg});
+                break;
+            }
+            case 's': {
+                options.seed = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        LoadGenerator generator{options};
+        generator.run(std::cout);
+
+        Histogram rtt;
+        generator.mergeRtt(rtt);
+
+        double seconds = options.duration / 1000.0;
+
+        std::cout << std::endl;
+        std::cout << "clients connected: " << generator.get(LoadGenerator::Connected) << std::endl;
+        std::cout << "clients failed to connect: " << generator.get(LoadGenerator::Failed) << std::endl;
+        std::cout << "clients disconnected: " << generator.get(LoadGenerator::Disconnected) << std::endl;
+        std::cout << "packets sent: " << generator.get(LoadGenerator::PacketsSent)
+                  << " (" << generator.get(LoadGenerator::PacketsSent) / seconds << "/s)" << std::endl;
+        std::cout << "packets received: " << generator.get(LoadGenerator::PacketsReceived)
+                  << " (" << generator.get(LoadGenerator::PacketsReceived) / seconds << "/s)" << std::endl;
+        std::cout << "bytes sent: " << generator.get(LoadGenerator::BytesSent) << std::endl;
+        std::cout << "bytes received: " << generator.get(LoadGenerator::BytesReceived) << std::endl;
+        std::cout << "error packets: " << generator.get(LoadGenerator::ErrorPackets) << std::endl;
+        std::cout << "serves: " << generator.get(LoadGenerator::Serves) << std::endl;
+        std::cout << "rallies: " << generator.get(LoadGenerator::Rallies) << std::endl;
+        std::cout << "games over: " << generator.get(LoadGenerator::GamesOver) << std::endl;
+        std::cout << "rtt: " << rtt.toLog("us") << std::endl;
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
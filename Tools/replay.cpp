@@ -0,0 +1,90 @@
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+
+#include "Replay.h"
+#include "LogDirectory.h"
+#include "../Exceptions.h"
+
+void printHelp(char *name)
+{
+    std::cout << "Replays recorded games through the game logic and reports every point." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-v] [-l directory] file..." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-l directory" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tKeep the server logs in the directory, otherwise they go to a temporary one removed at the end." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-v";
+    std::cout << "\t\tPrint every recorded event" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose{false};
+    std::string logDirectory;
+
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hvl:")) != -1) {
+        switch (opt) {
+        case 'v': {
+            verbose = true;
+            break;
+        }
+        case 'l': {
+            logDirectory = optarg;
+            break;
+        }
+        case 'h': {
+            printHelp(argv[0]);
+            exit(EXIT_SUCCESS);
+        }
+        default: {
+            exit(EXIT_FAILURE);
+        }
+        }
+    }
+
+    if (optind >= argc) {
+        printHelp(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t mismatches{0};
+
+    try {
+        // the recorded timestamps are used as they are, without a wall clock offset
+        LogDirectory logs{logDirectory};
+        App app{App::DEFAULT_PORT, "", App::DEFAUL_MAX_CONNECTIONS, App::DEFAULT_BROADCAST_RATE, "", 0, "", logs.getPath()};
+        VirtualClock clock{0, 0};
+        app.setClock(clock);
+
+        for (int i = optind; i < argc; ++i) {
+            ReplayReader reader{argv[i]};
+
+            std::cout << argv[i] << ": game " << reader.getHeader().gameUid
+                      << ", " << reader.size() << " events" << std::endl;
+
+            Replay replay{app, clock, reader, std::cout, verbose};
+            Replay::Result result = replay.run();
+
+            std::cout << "points: " << result.points
+                      << ", final score " << scoreToStr(result.scoreLeft) << ":" << scoreToStr(result.scoreRight)
+                      << ", mismatches: " << result.mismatches << std::endl;
+
+            mismatches += result.mismatches;
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
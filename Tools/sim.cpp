@@ -0,0 +1,124 @@
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+
+#include "Simulation.h"
+#include "LogDirectory.h"
+
+void printHelp(char *name)
+{
+    std::cout << "Headless deterministic simulation of many games on a virtual clock." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-g games] [-d seconds] [-s seed] [-t step] [-k skill] [-l directory]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-g games" << std::endl;
+    std::cout << "\t\tdefault = 1000" << std::endl;
+    std::cout << "\t\tNumber of simulated games." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-d seconds" << std::endl;
+    std::cout << "\t\tdefault = 600" << std::endl;
+    std::cout << "\t\tSimulated (virtual) time." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-s seed" << std::endl;
+    std::cout << "\t\tdefault = 1" << std::endl;
+    std::cout << "\t\tSeed of the ball and of the scripted players." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t step" << std::endl;
+    std::cout << "\t\tdefault = 5" << std::endl;
+    std::cout << "\t\tVirtual clock step in milliseconds." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-k skill" << std::endl;
+    std::cout << "\t\tdefault = 0.9" << std::endl;
+    std::cout << "\t\tProbability that a scripted player goes for the ball." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-l directory" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tKeep the server logs in the directory, otherwise they go to a temporary one removed at the end." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    Simulation::Options options;
+    std::string logDirectory;
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "hg:d:s:t:k:l:")) != -1) {
+            switch (opt) {
+            case 'g': {
+                options.games = std::stoul(std::string{optarg});
+                break;
+            }
+            case 'd': {
+                options.duration = std::stoll(std::string{optarg}) * 1000;
+                break;
+            }
+            case 's': {
+                options.seed = static_cast<unsigned>(std::stoul(std::string{optarg}));
+                break;
+            }
+            case 't': {
+                options.step = std::max(1ll, std::stoll(std::string{optarg}));
+                break;
+            }
+            case 'k': {
+                options.skill = std::stod(std::string{optarg});
+                break;
+            }
+            case 'l': {
+                logDirectory = optarg;
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        Simulation::Result result;
+
+        {
+            // the logs are flushed when the app ends, before their directory goes
+            LogDirectory logs{logDirectory};
+            App app{App::DEFAULT_PORT, "", App::DEFAUL_MAX_CONNECTIONS, App::DEFAULT_BROADCAST_RATE, "", 0, "", logs.getPath()};
+            VirtualClock clock{0, Simulation::VIRTUAL_EPOCH};
+            app.setClock(clock);
+
+            Simulation simulation{app, clock, options};
+            result = simulation.run();
+        }
+
+        std::cout << "games: " << options.games << std::endl;
+        std::cout << "virtual time: " << result.virtualTime / 1000.0 << " s" << std::endl;
+        std::cout << "wall time: " << result.wallSeconds << " s" << std::endl;
+        std::cout << "speed-up: " << result.virtualTime / 1000.0 / result.wallSeconds << "x" << std::endl;
+        std::cout << "rallies: " << result.rallies << std::endl;
+        std::cout << "rallies per wall minute: " << result.rallies / result.wallSeconds * 60 << std::endl;
+        std::cout << "points: " << result.points << std::endl;
+        std::cout << "games over: " << result.gamesOver << std::endl;
+        std::cout << "packets: " << result.packets << std::endl;
+        std::cout << "rejected inputs: " << result.rejectedInputs << std::endl;
+        std::cout << "checksum: " << result.checksum << std::endl;
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
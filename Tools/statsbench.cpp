@@ -0,0 +1,134 @@
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../Utils/Lockable.h"
+#include "../Utils/Stats.h"
+#include "../Utils/Text.h"
+
+/**
+ * The counters as they were before the sharding, every add takes the lock shared by all threads.
+ */
+class LockedCounters: public Lockable
+{
+    uint64_t packetsSent{0};
+    uint64_t bytesSent{0};
+
+public:
+    void addPacketsSent(uint64_t count)
+    {
+        auto lock = acquireLock();
+        packetsSent += count;
+    }
+
+    void addBytesSent(uint64_t count)
+    {
+        auto lock = acquireLock();
+        bytesSent += count;
+    }
+};
+
+void printHelp(char *name)
+{
+    std::cout << "Contention microbenchmark of the stats counters, locked against sharded." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-t threads] [-n operations]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-t threads" << std::endl;
+    std::cout << "\t\tdefault = 64" << std::endl;
+    std::cout << "\t\tHighest number of counting threads, doubled from 1." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-n operations" << std::endl;
+    std::cout << "\t\tdefault = 200000" << std::endl;
+    std::cout << "\t\tSent packets counted by each thread, each one is two counter updates." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+template<typename Counters>
+double measure(Counters &counters, size_t threadsCount, uint64_t operations)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < threadsCount; ++i) {
+        threads.emplace_back([&counters, operations]() {
+            for (uint64_t j = 0; j < operations; ++j) {
+                counters.addPacketsSent(1);
+                counters.addBytesSent(64);
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // millions of sent packets counted per second by all the threads together
+    return threadsCount * operations / seconds / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxThreads{64};
+    uint64_t operations{200000};
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "ht:n:")) != -1) {
+            switch (opt) {
+            case 't': {
+                maxThreads = std::max(1ul, std::stoul(std::string{optarg}));
+                break;
+            }
+            case 'n': {
+                operations = std::stoull(std::string{optarg});
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::cout << Text::justifyL("threads", 10)
+              << Text::justifyL("locked Mops/s", 16)
+              << Text::justifyL("sharded Mops/s", 16)
+              << "speed-up" << std::endl;
+    std::cout << Text::hline(50) << std::endl;
+
+    for (size_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        LockedCounters locked;
+        Stats sharded;
+
+        double lockedRate = measure(locked, threads, operations);
+        double shardedRate = measure(sharded, threads, operations);
+
+        std::cout << Text::justifyL(std::to_string(threads), 10)
+                  << Text::justifyL(std::to_string(lockedRate), 16)
+                  << Text::justifyL(std::to_string(shardedRate), 16)
+                  << shardedRate / lockedRate << "x" << std::endl;
+
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
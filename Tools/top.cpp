@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <cstring>
+#include <unordered_map>
+
+#include "../Utils/MetricsSegment.h"
+#include "../Utils/Text.h"
+
+void printHelp(char *name)
+{
+    std::cout << "Live view of the metrics a server publishes with -M, read from shared memory." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << name << " [-M name] [-i milliseconds] [-N rows] [-n count]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-M name" << std::endl;
+    std::cout << "\t\tdefault = ups" << std::endl;
+    std::cout << "\t\tName of the segment in /dev/shm." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-i milliseconds" << std::endl;
+    std::cout << "\t\tdefault = 1000" << std::endl;
+    std::cout << "\t\tRefresh interval." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-N rows" << std::endl;
+    std::cout << "\t\tdefault = 10" << std::endl;
+    std::cout << "\t\tConnections and games shown." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-n count" << std::endl;
+    std::cout << "\t\tdefault = 0" << std::endl;
+    std::cout << "\t\tNumber of refreshes, 0 runs until interrupted." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-h";
+    std::cout << "\t\tPrint help" << std::endl;
+}
+
+const char *phaseName(uint8_t phase)
+{
+    static const char *names[]{"new", "waiting", "playing", "game over", "end"};
+    return phase < sizeof(names) / sizeof(names[0]) ? names[phase] : "?";
+}
+
+void printSnapshot(const std::string &name,
+                   const MetricsSegment::Snapshot &snapshot,
+                   const std::unordered_map<std::string, uint64_t> &previous,
+                   double elapsedSeconds,
+                   size_t rows)
+{
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::cout << "ups-top - " << MetricsSegment::pathOf(name) << " - pid " << snapshot.pid
+              << " - updated " << (now - snapshot.updatedAt) / 1000 << " ms ago" << std::endl;
+    std::cout << Text::hline(70) << std::endl;
+
+    std::cout << Text::justifyL("metric", 40) << Text::justifyL("value", 16) << "per second" << std::endl;
+
+    for (auto &metric : snapshot.metrics) {
+        std::cout << Text::justifyL(metric.name, 40) << Text::justifyL(std::to_string(metric.value), 16);
+
+        auto found = previous.find(metric.name);
+
+        if (!metric.gauge && found != previous.end() && elapsedSeconds > 0) {
+            std::cout << static_cast<uint64_t>((metric.value - found->second) / elapsedSeconds);
+        }
+
+        std::cout << std::endl;
+    }
+
+    std::vector<ConnectionEntry> connections = snapshot.connections;
+    std::sort(connections.begin(), connections.end(), [](const ConnectionEntry &a, const ConnectionEntry &b) {
+        return a.bytesReceived + a.bytesSent > b.bytesReceived + b.bytesSent;
+    });
+
+    std::cout << std::endl;
+    std::cout << "connections: " << connections.size() << std::endl;
+    std::cout << Text::justifyL("uid", 10) << Text::justifyL("nickname", 18)
+              << Text::justifyL("game", 10) << Text::justifyL("bytes in", 14)
+              << Text::justifyL("bytes out", 14) << "rtt ms" << std::endl;
+
+    for (size_t i = 0; i < std::min(rows, connections.size()); ++i) {
+        auto &connection = connections[i];
+
+        std::cout << Text::justifyL(std::to_string(connection.uid), 10)
+                  << Text::justifyL(std::string{connection.nickname, strnlen(connection.nickname, 16)}, 18)
+                  << Text::justifyL(connection.game >= 0 ? std::to_string(connection.game) : "-", 10)
+                  << Text::justifyL(std::to_string(connection.bytesReceived), 14)
+                  << Text::justifyL(std::to_string(connection.bytesSent), 14)
+                  << connection.rtt << std::endl;
+    }
+
+    std::vector<GameEntry> games = snapshot.games;
+    std::sort(games.begin(), games.end(), [](const GameEntry &a, const GameEntry &b) {
+        return a.sendRate > b.sendRate;
+    });
+
+    std::cout << std::endl;
+    std::cout << "games: " << games.size() << std::endl;
+    std::cout << Text::justifyL("uid", 10) << Text::justifyL("phase", 12)
+              << Text::justifyL("score", 10) << Text::justifyL("rallies", 10)
+              << Text::justifyL("updates/s", 12) << "packets/s" << std::endl;
+
+    for (size_t i = 0; i < std::min(rows, games.size()); ++i) {
+        auto &game = games[i];
+
+        std::cout << Text::justifyL(std::to_string(game.uid), 10)
+                  << Text::justifyL(phaseName(game.phase), 12)
+                  << Text::justifyL(std::to_string(game.scoreLeft) + ":" + std::to_string(game.scoreRight), 10)
+                  << Text::justifyL(std::to_string(game.rallies), 10)
+                  << Text::justifyL(std::to_string(game.updateRate), 12)
+                  << game.sendRate << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string name{"ups"};
+    std::chrono::milliseconds interval{1000};
+    size_t rows{10};
+    unsigned long count{0};
+
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, "hM:i:N:n:")) != -1) {
+            switch (opt) {
+            case 'M': {
+                name = optarg;
+                break;
+            }
+            case 'i': {
+                interval = std::chrono::milliseconds{std::max(10ul, std::stoul(std::string{optarg}))};
+                break;
+            }
+            case 'N': {
+                rows = std::stoul(std::string{optarg});
+                break;
+            }
+            case 'n': {
+                count = std::stoul(std::string{optarg});
+                break;
+            }
+            case 'h': {
+                printHelp(argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            default: {
+                exit(EXIT_FAILURE);
+            }
+            }
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "error: invalid argument" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        MetricsSegment segment = MetricsSegment::attach(name);
+        MetricsSegment::Snapshot snapshot;
+        std::unordered_map<std::string, uint64_t> previous;
+        int64_t previousAt{0};
+
+        for (unsigned long i = 0; count == 0 || i < count; ++i) {
+            if (i > 0) {
+                std::this_thread::sleep_for(interval);
+            }
+
+            if (!segment.read(snapshot)) {
+                // the server is writing all the time, try again on the next refresh
+                continue;
+            }
+
+            double elapsedSeconds = previousAt ? (snapshot.updatedAt - previousAt) / 1e6 : 0;
+
+            // clear the terminal only when it is one
+            if (isatty(STDOUT_FILENO)) {
+                std::cout << "\033[H\033[2J";
+            }
+
+            printSnapshot(name, snapshot, previous, elapsedSeconds, rows);
+            std::cout << std::endl;
+
+            previous.clear();
+            for (auto &metric : snapshot.metrics) {
+                previous[metric.name] = metric.value;
+            }
+            previousAt = snapshot.updatedAt;
+        }
+    }
+    catch (std::exception &exception) {
+        std::cout << "Exception: " << exception.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
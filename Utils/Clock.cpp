@@ -0,0 +1,97 @@
+#include <ctime>
+
+#include "Clock.h"
+
+namespace
+{
+Timestamp readClock(clockid_t clock)
+{
+    timespec time{};
+    clock_gettime(clock, &time);
+
+    return static_cast<Timestamp>(time.tv_sec) * 1000 + time.tv_nsec / 1000000;
+}
+}
+
+Timestamp Clock::timestamp() const
+{
+    return monotonic() + wallOffset();
+}
+
+Timestamp Clock::coarseTimestamp() const
+{
+    return coarseMonotonic() + wallOffset();
+}
+
+Timestamp Clock::toTimestamp(Timestamp monotonic) const
+{
+    return monotonic + wallOffset();
+}
+
+Timestamp Clock::toMonotonic(Timestamp timestamp) const
+{
+    return timestamp - wallOffset();
+}
+
+SystemClock::SystemClock()
+    : offset{readClock(CLOCK_REALTIME) - readClock(CLOCK_MONOTONIC)}
+{}
+
+Timestamp SystemClock::monotonic() const
+{
+    return readClock(CLOCK_MONOTONIC);
+}
+
+int64_t SystemClock::monotonicMicros() const
+{
+    timespec time{};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+Timestamp SystemClock::coarseMonotonic() const
+{
+    // served from the vDSO without a syscall, updated once per kernel tick
+    return readClock(CLOCK_MONOTONIC_COARSE);
+}
+
+Timestamp SystemClock::wallOffset() const
+{
+    return offset;
+}
+
+VirtualClock::VirtualClock(Timestamp start, Timestamp offset)
+    : now{start},
+      offset{offset}
+{}
+
+void VirtualClock::set(Timestamp monotonic)
+{
+    now = monotonic;
+}
+
+void VirtualClock::advance(Timestamp milliseconds)
+{
+    now += milliseconds;
+}
+
+Timestamp VirtualClock::monotonic() const
+{
+    return now;
+}
+
+int64_t VirtualClock::monotonicMicros() const
+{
+    return now * 1000;
+}
+
+Timestamp VirtualClock::coarseMonotonic() const
+{
+    return now;
+}
+
+Timestamp VirtualClock::wallOffset() const
+{
+    return offset;
+}
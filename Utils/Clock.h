@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+
+#include "../Game/GameTypes.h"
+
+/**
+ * Time source of the application.
+ *
+ * Game timing runs on a monotonic base, so wall clock steps do not move the ball.
+ * Protocol timestamps are the monotonic time mapped to the wall clock once, when the clock is created.
+ * The coarse reading is for hot paths which can live with the resolution of a scheduler tick.
+ */
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    virtual Timestamp monotonic() const = 0;
+    virtual int64_t monotonicMicros() const = 0;
+    virtual Timestamp coarseMonotonic() const = 0;
+    virtual Timestamp wallOffset() const = 0;
+
+    Timestamp timestamp() const;
+    Timestamp coarseTimestamp() const;
+
+    Timestamp toTimestamp(Timestamp monotonic) const;
+    Timestamp toMonotonic(Timestamp timestamp) const;
+};
+
+class SystemClock: public Clock
+{
+    Timestamp offset;
+
+public:
+    SystemClock();
+
+    Timestamp monotonic() const override;
+    int64_t monotonicMicros() const override;
+    Timestamp coarseMonotonic() const override;
+    Timestamp wallOffset() const override;
+};
+
+class VirtualClock: public Clock
+{
+    std::atomic<Timestamp> now;
+    Timestamp offset;
+
+public:
+    explicit VirtualClock(Timestamp start = 0, Timestamp offset = 0);
+
+    void set(Timestamp monotonic);
+    void advance(Timestamp milliseconds);
+
+    Timestamp monotonic() const override;
+    int64_t monotonicMicros() const override;
+    Timestamp coarseMonotonic() const override;
+    Timestamp wallOffset() const override;
+};
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <sstream>
+
+#include "Histogram.h"
+
+const size_t Histogram::SUB_BUCKETS_COUNT;
+
+size_t Histogram::bucketIndex(int64_t value)
+{
+    if (value < static_cast<int64_t>(SUB_BUCKETS_COUNT)) {
+        return value < 0 ? 0 : static_cast<size_t>(value);
+    }
+
+    auto unsignedValue = static_cast<uint64_t>(value);
+    int shift = 63 - __builtin_clzll(unsignedValue) - SUB_BUCKET_BITS;
+
+    return (shift + 1) * SUB_BUCKETS_COUNT + ((unsignedValue >> shift) - SUB_BUCKETS_COUNT);
+}
+
+int64_t Histogram::bucketValue(size_t index)
+{
+    if (index < SUB_BUCKETS_COUNT) {
+        return static_cast<int64_t>(index);
+    }
+
+    int shift = static_cast<int>(index / SUB_BUCKETS_COUNT) - 1;
+    uint64_t base = (SUB_BUCKETS_COUNT + index % SUB_BUCKETS_COUNT) << shift;
+
+    // middle of the bucket range
+    return static_cast<int64_t>(base + ((uint64_t{1} << shift) >> 1));
+}
+
+Histogram::Histogram()
+    : max{0},
+      sum{0}
+{
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(int64_t value)
+{
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    int64_t currentMax = max.load(std::memory_order_relaxed);
+    while (value > currentMax && !max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed)) {}
+}
+
+void Histogram::merge(const Histogram &histogram)
+{
+    for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+        uint64_t count = histogram.buckets[i].load(std::memory_order_relaxed);
+
+        if (count) {
+            buckets[i].fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+
+    sum.fetch_add(histogram.getSum(), std::memory_order_relaxed);
+
+    int64_t otherMax = histogram.getMax();
+    int64_t currentMax = max.load(std::memory_order_relaxed);
+    while (otherMax > currentMax && !max.compare_exchange_weak(currentMax, otherMax, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::getCount() const
+{
+    uint64_t count{0};
+
+    for (auto &bucket : buckets) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+int64_t Histogram::getMax() const
+{
+    return max.load(std::memory_order_relaxed);
+}
+
+int64_t Histogram::getSum() const
+{
+    return sum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getCountBelow(int64_t value) const
+{
+    // exact only for the values which start a bucket, e.g. the powers of two
+    uint64_t count{0};
+
+    for (size_t i = 0; i < bucketIndex(value); ++i) {
+        count += buckets[i].load(std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+int64_t Histogram::getPercentile(double percentile) const
+{
+    uint64_t count = getCount();
+
+    if (count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(percentile * (count - 1)) + 1;
+    uint64_t seen{0};
+
+    for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+
+        if (seen >= rank) {
+            return std::min(bucketValue(i), getMax());
+        }
+    }
+
+    return getMax();
+}
+
+std::string Histogram::toLog(const std::string &unit) const
+{
+    std::stringstream stream;
+
+    stream << "count " << getCount()
+           << ", p50 " << getPercentile(0.5) << " " << unit
+           << ", p99 " << getPercentile(0.99) << " " << unit
+           << ", p999 " << getPercentile(0.999) << " " << unit
+           << ", max " << getMax() << " " << unit;
+
+    return stream.str();
+}
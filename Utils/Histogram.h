@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+/**
+ * Log-bucketed histogram of non-negative values (HDR style, 16 sub-buckets per power of two).
+ * Recording is a single relaxed atomic increment, percentiles are computed on read.
+ */
+class Histogram
+{
+public:
+    static const int SUB_BUCKET_BITS{4};
+    static const size_t SUB_BUCKETS_COUNT{1u << SUB_BUCKET_BITS};
+    static const size_t BUCKETS_COUNT{(64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS_COUNT};
+
+    static size_t bucketIndex(int64_t value);
+    static int64_t bucketValue(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS_COUNT> buckets;
+    std::atomic<int64_t> max;
+    std::atomic<int64_t> sum;
+
+public:
+    Histogram();
+    Histogram(const Histogram &histogram) = delete;
+
+    void record(int64_t value);
+    void merge(const Histogram &histogram);
+
+    uint64_t getCount() const;
+    int64_t getMax() const;
+    int64_t getSum() const;
+    uint64_t getCountBelow(int64_t value) const;
+    int64_t getPercentile(double percentile) const;
+
+    std::string toLog(const std::string &unit) const;
+};
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <map>
+#include <memory>
+
+#include "LockProfiler.h"
+
+namespace
+{
+    std::mutex sitesMutex;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<LockSite>> sites;
+
+    std::string demangle(const char *name)
+    {
+        int status;
+        char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+        if (status != 0) {
+            return name;
+        }
+
+        std::string result{demangled};
+        std::free(demangled);
+
+        return result;
+    }
+}
+
+thread_local const void *LockProfiler::releasedMutex{nullptr};
+thread_local LockSite *LockProfiler::releasedSite{nullptr};
+
+LockSite::LockSite(std::string lock, std::string site)
+    : lock(std::move(lock)),
+      site(std::move(site))
+{}
+
+bool LockProfiler::isEnabled()
+{
+#ifdef UPS_LOCK_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+int64_t LockProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LockSite &LockProfiler::site(const char *lock, const char *site)
+{
+    // the names are stable pointers, so the threads look their sites up without the registry lock
+    thread_local std::map<std::pair<const char *, const char *>, LockSite *> cache;
+
+    auto cached = cache.find({lock, site});
+
+    if (cached != cache.end()) {
+        return *cached->second;
+    }
+
+    std::string lockName = demangle(lock);
+    std::lock_guard<std::mutex> guard{sitesMutex};
+
+    auto &found = sites[{lockName, site}];
+
+    if (!found) {
+        found.reset(new LockSite{lockName, site});
+    }
+
+    cache[{lock, site}] = found.get();
+
+    return *found;
+}
+
+void LockProfiler::released(const void *mutex, LockSite &site)
+{
+    releasedMutex = mutex;
+    releasedSite = &site;
+}
+
+LockSite *LockProfiler::releasedFrom(const void *mutex)
+{
+    return releasedMutex == mutex ? releasedSite : nullptr;
+}
+
+std::vector<LockProfiler::Report> LockProfiler::report()
+{
+    std::vector<Report> reports;
+    std::lock_guard<std::mutex> guard{sitesMutex};
+
+    for (auto &entry : sites) {
+        LockSite &site = *entry.second;
+        Histogram wait;
+        Histogram hold;
+
+        site.wait.mergeInto(wait);
+        site.hold.mergeInto(hold);
+
+        reports.push_back(Report{
+            site.lock,
+            site.site,
+            wait.getCount(),
+            site.contended.get(0),
+            wait.getSum(),
+            wait.getPercentile(0.99),
+            wait.getMax(),
+            hold.getSum(),
+            hold.getPercentile(0.99),
+            hold.getMax()});
+    }
+
+    return reports;
+}
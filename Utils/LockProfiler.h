@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ShardedCounters.h"
+#include "ShardedHistogram.h"
+
+/**
+ * Acquisitions of one lock from one call site, the wait and hold times are in nanoseconds.
+ */
+struct LockSite
+{
+    std::string lock;
+    std::string site;
+    ShardedHistogram wait;
+    ShardedHistogram hold;
+    ShardedCounters<1> contended;
+
+    LockSite(std::string lock, std::string site);
+};
+
+/**
+ * Registry of the lock sites, filled only in builds configured with UPS_LOCK_PROFILING.
+ */
+class LockProfiler
+{
+public:
+    struct Report
+    {
+        std::string lock;
+        std::string site;
+        uint64_t acquisitions;
+        uint64_t contended;
+        int64_t waitSum;
+        int64_t waitP99;
+        int64_t waitMax;
+        int64_t holdSum;
+        int64_t holdP99;
+        int64_t holdMax;
+    };
+
+private:
+    // the site the calling thread last released a mutex from, a condition variable wait locks it again from there
+    static thread_local const void *releasedMutex;
+    static thread_local LockSite *releasedSite;
+
+public:
+    static bool isEnabled();
+    static int64_t now();
+
+    // the names must outlive the profiler (literals or type names), mangled type names are demangled
+    static LockSite &site(const char *lock, const char *site);
+
+    static void released(const void *mutex, LockSite &site);
+    static LockSite *releasedFrom(const void *mutex);
+
+    static std::vector<Report> report();
+};
+
+/**
+ * Mutex timing its acquisitions when profiling, a plain forwarding wrapper otherwise.
+ * Recursive mutexes are timed from their outermost acquisition.
+ */
+template<typename Mutex>
+class ProfiledMutex
+{
+    Mutex mutex;
+    const char *name;
+
+#ifdef UPS_LOCK_PROFILING
+    // written only by the holder
+    LockSite *holder{nullptr};
+    int64_t acquiredAt{0};
+    unsigned depth{0};
+
+    void acquired(LockSite &site, int64_t start)
+    {
+        if (depth++ == 0) {
+            int64_t now = LockProfiler::now();
+            site.wait.record(now - start);
+            holder = &site;
+            acquiredAt = now;
+        }
+    }
+#endif
+
+public:
+    explicit ProfiledMutex(const char *name)
+        : name{name}
+    {}
+
+    ProfiledMutex(const ProfiledMutex &mutex) = delete;
+
+    const char *getName() const
+    {
+        return name;
+    }
+
+#ifdef UPS_LOCK_PROFILING
+    void lock(LockSite &site)
+    {
+        int64_t start = LockProfiler::now();
+
+        if (!mutex.try_lock()) {
+            site.contended.add(0, 1);
+            mutex.lock();
+        }
+
+        acquired(site, start);
+    }
+
+    void lock()
+    {
+        LockSite *site = LockProfiler::releasedFrom(this);
+        lock(site ? *site : LockProfiler::site(name, "lock"));
+    }
+
+    bool try_lock()
+    {
+        int64_t start = LockProfiler::now();
+
+        if (!mutex.try_lock()) {
+            return false;
+        }
+
+        acquired(LockProfiler::site(name, "try_lock"), start);
+        return true;
+    }
+
+    void unlock()
+    {
+        if (--depth == 0) {
+            holder->hold.record(LockProfiler::now() - acquiredAt);
+            LockProfiler::released(this, *holder);
+        }
+
+        mutex.unlock();
+    }
+#else
+    void lock()
+    {
+        mutex.lock();
+    }
+
+    bool try_lock()
+    {
+        return mutex.try_lock();
+    }
+
+    void unlock()
+    {
+        mutex.unlock();
+    }
+#endif
+
+    // the caller is the call site of the acquisition
+    std::unique_lock<ProfiledMutex> acquire(const char *function = __builtin_FUNCTION())
+    {
+#ifdef UPS_LOCK_PROFILING
+        lock(LockProfiler::site(name, function));
+        return std::unique_lock<ProfiledMutex>{*this, std::adopt_lock};
+#else
+        // the call site is recorded only by profiling builds
+        (void) function;
+        return std::unique_lock<ProfiledMutex>{*this};
+#endif
+    }
+};
@@ -1,9 +1,23 @@
+#include <typeinfo>
+
 #include "Lockable.h"
 
+#ifdef UPS_LOCK_PROFILING
+Lockable::Lockable()
+    : mutex{"Lockable"}
+{}
+
+Lock Lockable::acquireLock(const char *function) const
+{
+    mutex.lock(LockProfiler::site(typeid(*this).name(), function));
+    return Lock{mutex, std::adopt_lock};
+}
+#else
 Lock Lockable::acquireLock() const
 {
     return Lock(mutex);
 }
+#endif
 
 void Lockable::wait(Lock &lock) const
 {
@@ -25,12 +39,12 @@ bool Lockable::waitFor(Lock &lock, Duration duration, Predicate predicate) const
     return conditionVariable.wait_for(lock, duration, predicate);
 }
 
-WaitStatus Lockable::waitUntil(Lock &lock, TimePoint &timePoint) const
+WaitStatus Lockable::waitUntil(Lock &lock, const TimePoint &timePoint) const
 {
     return conditionVariable.wait_until(lock, timePoint);
 }
 
-bool Lockable::waitUntil(Lock &lock, TimePoint &timePoint, Predicate predicate) const
+bool Lockable::waitUntil(Lock &lock, const TimePoint &timePoint, Predicate predicate) const
 {
     return conditionVariable.wait_until(lock, timePoint, predicate);
 }
@@ -4,19 +4,37 @@
 #include <condition_variable>
 #include <chrono>
 
-typedef std::unique_lock<std::mutex> Lock;
+#include "LockProfiler.h"
+
+// profiling builds time every acquisition, a condition variable then has to work with any lockable
+#ifdef UPS_LOCK_PROFILING
+typedef ProfiledMutex<std::mutex> LockableMutex;
+typedef std::condition_variable_any ConditionVariable;
+#else
+typedef std::mutex LockableMutex;
+typedef std::condition_variable ConditionVariable;
+#endif
+
+typedef std::unique_lock<LockableMutex> Lock;
 typedef std::function<bool()> Predicate;
 typedef std::chrono::nanoseconds Duration;
-typedef std::chrono::system_clock::time_point& TimePoint;
+typedef std::chrono::steady_clock::time_point TimePoint;
 typedef std::cv_status WaitStatus;
 
 class Lockable
 {
-    mutable std::condition_variable conditionVariable;
-    mutable std::mutex mutex;
+    mutable ConditionVariable conditionVariable;
+    mutable LockableMutex mutex;
 
 public:
+#ifdef UPS_LOCK_PROFILING
+    Lockable();
+
+    // the lock is reported by the class of the object and the calling function
+    virtual Lock acquireLock(const char *function = __builtin_FUNCTION()) const final;
+#else
     virtual Lock acquireLock() const final;
+#endif
 
     virtual void wait(Lock &lock) const final;
     virtual void wait(Lock &lock, std::function<bool()> predicate) const final;
@@ -24,8 +42,8 @@ public:
     virtual WaitStatus waitFor(Lock &lock, Duration duration) const final;
     virtual bool waitFor(Lock &lock, Duration duration, Predicate predicate) const final;
 
-    virtual WaitStatus waitUntil(Lock &lock, TimePoint &timePoint) const final;
-    virtual bool waitUntil(Lock &lock, TimePoint &timePoint, Predicate predicate) const final;
+    virtual WaitStatus waitUntil(Lock &lock, const TimePoint &timePoint) const final;
+    virtual bool waitUntil(Lock &lock, const TimePoint &timePoint, Predicate predicate) const final;
 
     virtual void notifyOne() const final;
     virtual void notifyAll() const final;
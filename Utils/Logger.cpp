@@ -1,37 +1,307 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "Logger.h"
 #include "Text.h"
 #include "../Exceptions.h"
 
-Logger::Logger(std::string baseLogFile, std::string communicationLogFile, std::string statsFile)
-    : baseLogFileName(baseLogFile),
-      communicationLogFileName(communicationLogFile),
-      statsFileName(statsFile)
+std::atomic<uint64_t> Logger::lastLoggerId{0};
+thread_local Logger::ThreadRing Logger::threadRing;
+
+Logger::Ring::Ring(size_t capacity)
+    : records(capacity),
+      mask{capacity - 1}
+{}
+
+Logger::ThreadRing::~ThreadRing()
 {
-    this->baseLogFile.open(baseLogFile, std::ios::out);
-    if (!this->baseLogFile.is_open()) {
-        throw LoggerException("can not open file " + baseLogFile + " for writing");
+    // the thread is gone, the flusher frees the ring once it is drained
+    if (ring) {
+        ring->closed = true;
     }
+}
 
-    this->communicationLogFile.open(communicationLogFile, std::ios::out);
-    if (!this->communicationLogFile.is_open()) {
-        throw LoggerException("can not open file " + communicationLogFile + " for writing");
+Logger::Logger(std::string baseLogFile, std::string communicationLogFile, std::string statsFile, Options options)
+    : id{++lastLoggerId},
+      options(options),
+      baseLogFileName(baseLogFile),
+      communicationLogFileName(communicationLogFile),
+      statsFileName(statsFile),
+      sequence{0},
+      recordsDropped{0},
+      flushRequested{false},
+      recordsDroppedReported{0},
+      statsFd{-1}
+{
+    if (options.ringCapacity == 0 || (options.ringCapacity & (options.ringCapacity - 1)) != 0) {
+        throw LoggerException("ring capacity must be a power of two");
     }
 
-    this->statsFile.open(statsFile, std::ios::out);
-    if (!this->statsFile.is_open()) {
+    baseLog.reset(new SegmentedLog{baseLogFile, options.segments});
+
+    // every capture segment starts with its own header, so that each one is a complete capture
+    CaptureHeader header{};
+    std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    communicationLog.reset(new SegmentedLog{
+        communicationLogFile,
+        options.segments,
+        std::string{reinterpret_cast<const char *>(&header), sizeof(header)}});
+
+    statsFd = ::open(statsFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (statsFd == -1) {
         throw LoggerException("can not open file " + statsFile + " for writing");
     }
+
+    // the flusher runs for the whole life of the logger, so that nothing is logged into a void
+    start();
+}
+
+Logger::Logger(std::string baseLogFile, std::string communicationLogFile, std::string statsFile)
+    : Logger(std::move(baseLogFile), std::move(communicationLogFile), std::move(statsFile), Options{})
+{}
+
+Logger::Ring &Logger::getRing()
+{
+    if (threadRing.loggerId != id) {
+        auto ring = std::make_shared<Ring>(options.ringCapacity);
+
+        {
+            std::lock_guard<std::mutex> lock{ringsMutex};
+            rings.push_back(ring);
+        }
+
+        if (threadRing.ring) {
+            threadRing.ring->closed = true;
+        }
+
+        threadRing.loggerId = id;
+        threadRing.ring = ring;
+    }
+
+    return *threadRing.ring;
+}
+
+Logger::Record *Logger::claim(Ring &ring)
+{
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+
+    while (head - ring.tail.load(std::memory_order_acquire) >= ring.records.size()) {
+        if (options.overflowPolicy == OverflowPolicy::Drop || shouldStop()) {
+            recordsDropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        // block until the flusher makes room
+        if (!flushRequested.exchange(true)) {
+            notifyOne();
+        }
+
+        std::this_thread::yield();
+    }
+
+    Record *record = &ring.records[head & ring.mask];
+    record->sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+
+    return record;
+}
+
+void Logger::commit(Ring &ring)
+{
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint16_t Logger::append(Record &record, uint16_t length, const char *data, size_t size)
+{
+    // longer texts are cut off, a record never allocates
+    size_t copied = std::min<size_t>(size, Record::TEXT_SIZE - length);
+    std::memcpy(record.text + length, data, copied);
+
+    return static_cast<uint16_t>(length + copied);
+}
+
+uint16_t Logger::appendFixed(Record &record, uint16_t length, Field field, const void *data, size_t size)
+{
+    // a field which does not fit is left out as a whole
+    if (length + 1 + size > Record::TEXT_SIZE) {
+        return length;
+    }
+
+    record.text[length] = static_cast<char>(field);
+    std::memcpy(record.text + length + 1, data, size);
+
+    return static_cast<uint16_t>(length + 1 + size);
+}
+
+uint16_t Logger::appendText(Record &record, uint16_t length, const char *data, size_t size)
+{
+    if (static_cast<size_t>(length) + 2 > Record::TEXT_SIZE) {
+        return length;
+    }
+
+    // texts are cut off to the remaining space
+    auto copied = static_cast<uint8_t>(std::min<size_t>(size, Record::TEXT_SIZE - length - 2));
+
+    record.text[length] = static_cast<char>(Field::Text);
+    record.text[length + 1] = static_cast<char>(copied);
+    std::memcpy(record.text + length + 2, data, copied);
+
+    return static_cast<uint16_t>(length + 2 + copied);
+}
+
+uint16_t Logger::field(Record &record, uint16_t length, double value)
+{
+    return appendFixed(record, length, Field::Double, &value, sizeof(value));
+}
+
+uint16_t Logger::field(Record &record, uint16_t length, const char *value)
+{
+    return appendText(record, length, value, std::strlen(value));
+}
+
+uint16_t Logger::field(Record &record, uint16_t length, const std::string &value)
+{
+    return appendText(record, length, value.data(), value.size());
+}
+
+uint16_t Logger::field(Record &record, uint16_t length, const in_addr &value)
+{
+    return appendFixed(record, length, Field::Ipv4, &value, sizeof(value));
 }
 
 void Logger::log(const std::string &message, Level level)
+{
+    if (static_cast<int>(level) < UPS_LOG_LEVEL) {
+        return;
+    }
+
+    Ring &ring = getRing();
+    Record *record = claim(ring);
+
+    if (!record) {
+        return;
+    }
+
+    record->sink = Sink::Base;
+    record->level = static_cast<uint8_t>(level);
+    record->length = append(*record, 0, message.data(), message.size());
+
+    commit(ring);
+}
+
+void Logger::logCommunication(const Packet &packet, bool incoming, Uid uid)
+{
+    uint8_t type = PacketCapture::typeId(packet.getType());
+
+    // most of the high rate packets are skipped before anything is copied
+    if (!capture.sample(type)) {
+        return;
+    }
+
+    Ring &ring = getRing();
+    Record *record = claim(ring);
+
+    if (!record) {
+        return;
+    }
+
+    record->sink = Sink::Communication;
+    record->incoming = incoming;
+    record->uid = uid;
+    record->type = type;
+    record->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // the packet is copied as it is, without building its text representation
+    const char delimiter{Packet::DELIMITER};
+    const std::string &typeName = packet.getType();
+    uint16_t length = append(*record, 0, typeName.data(), typeName.size());
+
+    for (auto &item : packet.getItems()) {
+        length = append(*record, length, &delimiter, 1);
+        length = append(*record, length, item.data(), item.size());
+    }
+
+    record->length = length;
+
+    commit(ring);
+}
+
+void Logger::formatFields(const Record &record, std::string &text)
+{
+    char buffer[INET_ADDRSTRLEN];
+    size_t offset{0};
+
+    while (offset < record.length) {
+        auto field = static_cast<Field>(record.text[offset++]);
+
+        switch (field) {
+        case Field::Int: {
+            int64_t value;
+            std::memcpy(&value, record.text + offset, sizeof(value));
+            text += std::to_string(value);
+            offset += sizeof(value);
+            break;
+        }
+        case Field::UInt: {
+            uint64_t value;
+            std::memcpy(&value, record.text + offset, sizeof(value));
+            text += std::to_string(value);
+            offset += sizeof(value);
+            break;
+        }
+        case Field::Double: {
+            double value;
+            std::memcpy(&value, record.text + offset, sizeof(value));
+            std::snprintf(buffer, sizeof(buffer), "%g", value);
+            text += buffer;
+            offset += sizeof(value);
+            break;
+        }
+        case Field::Text: {
+            auto size = static_cast<uint8_t>(record.text[offset++]);
+            text.append(record.text + offset, size);
+            offset += size;
+            break;
+        }
+        case Field::Ipv4: {
+            in_addr value{};
+            std::memcpy(&value, record.text + offset, sizeof(value));
+            text += ::inet_ntop(AF_INET, &value, buffer, sizeof(buffer)) ? buffer : "?";
+            offset += sizeof(value);
+            break;
+        }
+        }
+    }
+}
+
+void Logger::format(const Record &record)
 {
     std::string color;
-    std::string prefix;
 
-    switch (level) {
+    if (record.sink == Sink::Communication) {
+        CaptureRecord captured{record.timestamp, record.uid, record.length, record.incoming, record.type};
+
+        communicationOutput.append(reinterpret_cast<const char *>(&captured), sizeof(captured));
+        communicationOutput.append(record.text, record.length);
+
+        if (capture.isEchoing()) {
+            consoleOutput += Text::decor(record.incoming ? Text::FG_BLUE : Text::FG_MAGENTA);
+            consoleOutput.append(record.incoming ? "<- " : "-> ").append(std::to_string(record.uid)).append(": ");
+            consoleOutput.append(record.text, record.length);
+            consoleOutput += Text::decor();
+            consoleOutput += '\n';
+        }
+        return;
+    }
+
+    switch (static_cast<Level>(record.level)) {
     case Level::Default: {
         color = Text::decor(Text::FG_DEFAULT);
         break;
@@ -42,55 +312,141 @@ void Logger::log(const std::string &message, Level level)
     }
     case Level::Warning: {
         color = Text::decor(Text::FG_YELLOW);
-        prefix = "Warning: ";
         break;
     }
     case Level::Error: {
         color = Text::decor(Text::FG_RED);
-        prefix = "ERROR: ";
         break;
     }
     }
 
-    std::lock_guard<std::mutex> lock{baseLogMutex};
+    if (record.sink == Sink::Fields) {
+        formatted.clear();
+        formatFields(record, formatted);
+    } else {
+        formatted.assign(record.text, record.length);
+    }
+
+    consoleOutput += color;
+    consoleOutput += formatted;
+    consoleOutput += Text::decor();
+    consoleOutput += '\n';
 
-    std::cout << color << message << Text::decor() << std::endl;
-    baseLogFile << message << std::endl;
+    baseOutput += formatted;
+    baseOutput += '\n';
 }
 
-void Logger::logCommunication(const Packet &packet, bool incoming, Uid id)
+size_t Logger::drain()
 {
-    std::string color;
-    std::string arrow;
+    std::vector<std::shared_ptr<Ring>> current;
 
-    if (incoming) {
-        color = Text::decor(Text::FG_BLUE);
-        arrow = "<-";
-    } else {
-        color = Text::decor(Text::FG_MAGENTA);
-        arrow = "->";
+    {
+        std::lock_guard<std::mutex> lock{ringsMutex};
+        current = rings;
+    }
+
+    for (auto &ring : current) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail) {
+            batch.push_back(ring->records[tail & ring->mask]);
+        }
+
+        ring->tail.store(head, std::memory_order_release);
     }
 
-    std::string serialized = packet.toLog();
+    {
+        // rings of finished threads are released once empty
+        std::lock_guard<std::mutex> lock{ringsMutex};
+
+        rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<Ring> &ring) {
+            return ring->closed && ring->tail == ring->head;
+        }), rings.end());
+    }
 
-    std::unique_lock<std::mutex> lock{communicationLogMutex};
+    // the records of the batch are written in the order they were logged
+    std::sort(batch.begin(), batch.end(), [](const Record &a, const Record &b) {
+        return a.sequence < b.sequence;
+    });
 
-    std::cout << color << arrow << " " << id << ": " << serialized << Text::decor() << std::endl;
-    communicationLogFile << arrow << " " << id << " " << serialized << std::endl;
+    for (auto &record : batch) {
+        format(record);
+    }
+
+    uint64_t dropped = recordsDropped.load(std::memory_order_relaxed);
+
+    if (dropped != recordsDroppedReported) {
+        std::string message = std::to_string(dropped - recordsDroppedReported) + " log records dropped";
+        consoleOutput += Text::decor(Text::FG_YELLOW) + message + Text::decor() + '\n';
+        baseOutput += message + '\n';
+        recordsDroppedReported = dropped;
+    }
+
+    // one write and one flush per batch instead of one per record
+    if (!consoleOutput.empty()) {
+        std::cout.write(consoleOutput.data(), consoleOutput.size());
+        std::cout.flush();
+    }
+
+    baseLog->write(baseOutput.data(), baseOutput.size());
+    communicationLog->write(communicationOutput.data(), communicationOutput.size());
+
+    size_t count = batch.size();
+
+    batch.clear();
+    consoleOutput.clear();
+    baseOutput.clear();
+    communicationOutput.clear();
+
+    return count;
 }
 
 void Logger::writeStats(const Stats &stats)
 {
+    std::string text = stats.toLog() + '\n';
+
     std::unique_lock<std::mutex> lock{statsMutex};
 
-    statsFile.close();
-    statsFile.open(statsFileName);
-    statsFile << stats.toLog() << std::endl;
+    // overwritten from the start and cut to the new length, the file is never reopened
+    if (::pwrite(statsFd, text.data(), text.size(), 0) == static_cast<ssize_t>(text.size())) {
+        ::ftruncate(statsFd, static_cast<off_t>(text.size()));
+    }
+}
+
+PacketCapture &Logger::getCapture()
+{
+    return capture;
+}
+
+uint64_t Logger::getDroppedCount() const
+{
+    return recordsDropped;
+}
+
+void Logger::run()
+{
+    while (!shouldStop()) {
+        drain();
+
+        auto lock = acquireLock();
+        waitFor(lock, options.flushPeriod, [this]() {
+            return shouldStop() || flushRequested;
+        });
+
+        flushRequested = false;
+    }
+}
+
+void Logger::after()
+{
+    // whatever was logged until the stop is still written
+    drain();
 }
 
 Logger::~Logger()
 {
-    baseLogFile.close();
-    communicationLogFile.close();
-    statsFile.close();
+    stop(true);
+
+    ::close(statsFd);
 }
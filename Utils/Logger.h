@@ -1,13 +1,60 @@
 #pragma once
 
 #include <string>
-#include <fstream>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <type_traits>
+#include <netinet/in.h>
 
+#include "Thread.h"
+#include "SegmentedLog.h"
 #include "../Utils/Stats.h"
 #include "../Network/Packet.h"
+#include "../Network/PacketCapture.h"
 #include "../Network/Connection.h"
 
-class Logger
+// lowest level compiled in: 0 default, 1 success, 2 warning, 3 error, 4 none
+#ifndef UPS_LOG_LEVEL
+#define UPS_LOG_LEVEL 0
+#endif
+
+// the arguments of a disabled level are not even evaluated
+#if UPS_LOG_LEVEL <= 0
+#define LOG_DEFAULT(logger, ...) (logger).write(Logger::Level::Default, __VA_ARGS__)
+#else
+#define LOG_DEFAULT(logger, ...) ((void) 0)
+#endif
+
+#if UPS_LOG_LEVEL <= 1
+#define LOG_SUCCESS(logger, ...) (logger).write(Logger::Level::Success, __VA_ARGS__)
+#else
+#define LOG_SUCCESS(logger, ...) ((void) 0)
+#endif
+
+#if UPS_LOG_LEVEL <= 2
+#define LOG_WARNING(logger, ...) (logger).write(Logger::Level::Warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(logger, ...) ((void) 0)
+#endif
+
+#if UPS_LOG_LEVEL <= 3
+#define LOG_ERROR(logger, ...) (logger).write(Logger::Level::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(logger, ...) ((void) 0)
+#endif
+
+/**
+ * Asynchronous logger, the calling threads only copy the record into their own lock-free ring,
+ * the flusher thread merges the rings and writes them in batches. Within a batch the records are sorted
+ * by the order they were logged in, a record committed only after its batch was drained
+ * comes with the next batch, behind newer records of other threads.
+ * The communication is written as a binary capture of the packets sampled by the PacketCapture.
+ * Both logs are split into rotated segments, the stats file is rewritten in place.
+ * Messages written through the LOG_* macros keep their arguments as typed fields,
+ * the text is built only by the flusher.
+ */
+class Logger: public Thread
 {
 public:
     enum class Level
@@ -18,24 +65,176 @@ public:
         Error
     };
 
+    enum class OverflowPolicy
+    {
+        Drop,
+        Block
+    };
+
+    struct Options
+    {
+        std::chrono::milliseconds flushPeriod{50};
+        size_t ringCapacity{512};
+        OverflowPolicy overflowPolicy{OverflowPolicy::Drop};
+        SegmentedLog::Options segments{};
+    };
+
 private:
+    enum class Sink: uint8_t
+    {
+        Base,
+        Fields,
+        Communication
+    };
+
+    enum class Field: uint8_t
+    {
+        Int,
+        UInt,
+        Double,
+        Text,
+        Ipv4
+    };
+
+    struct Record
+    {
+        static const size_t TEXT_SIZE{230};
+
+        uint64_t sequence;
+        int64_t timestamp;
+        Uid uid;
+        uint16_t length;
+        Sink sink;
+        uint8_t level;
+        bool incoming;
+        uint8_t type;
+        char text[TEXT_SIZE];
+    };
+
+    static_assert(sizeof(Record) == 256, "log records should fill whole cache lines");
+
+    /**
+     * Single producer, single consumer ring of one thread, the slots are reused without allocations.
+     */
+    struct Ring
+    {
+        std::vector<Record> records;
+        size_t mask;
+
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<bool> closed{false};
+
+        explicit Ring(size_t capacity);
+    };
+
+    struct ThreadRing
+    {
+        uint64_t loggerId{0};
+        std::shared_ptr<Ring> ring;
+
+        ~ThreadRing();
+    };
+
+    static std::atomic<uint64_t> lastLoggerId;
+    static thread_local ThreadRing threadRing;
+
+    const uint64_t id;
+    const Options options;
+
     std::string baseLogFileName;
     std::string communicationLogFileName;
     std::string statsFileName;
 
-    std::mutex baseLogMutex;
-    std::mutex communicationLogMutex;
+    std::mutex ringsMutex;
     std::mutex statsMutex;
 
-    std::fstream baseLogFile;
-    std::fstream communicationLogFile;
-    std::fstream statsFile;
+    PacketCapture capture;
+
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> recordsDropped;
+    std::atomic<bool> flushRequested;
+    uint64_t recordsDroppedReported;
+
+    std::vector<Record> batch;
+    std::string formatted;
+    std::string baseOutput;
+    std::string consoleOutput;
+    std::string communicationOutput;
+
+    std::unique_ptr<SegmentedLog> baseLog;
+    std::unique_ptr<SegmentedLog> communicationLog;
+    int statsFd;
+
+    static uint16_t append(Record &record, uint16_t length, const char *data, size_t size);
+    static uint16_t appendFixed(Record &record, uint16_t length, Field field, const void *data, size_t size);
+    static uint16_t appendText(Record &record, uint16_t length, const char *data, size_t size);
+
+    static uint16_t field(Record &record, uint16_t length, double value);
+    static uint16_t field(Record &record, uint16_t length, const char *value);
+    static uint16_t field(Record &record, uint16_t length, const std::string &value);
+    static uint16_t field(Record &record, uint16_t length, const in_addr &value);
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value, uint16_t>::type
+    field(Record &record, uint16_t length, T value)
+    {
+        if (std::is_signed<T>::value) {
+            auto widened = static_cast<int64_t>(value);
+            return appendFixed(record, length, Field::Int, &widened, sizeof(widened));
+        }
+
+        auto widened = static_cast<uint64_t>(value);
+        return appendFixed(record, length, Field::UInt, &widened, sizeof(widened));
+    }
+
+    Ring &getRing();
+    Record *claim(Ring &ring);
+    void commit(Ring &ring);
+
+    void format(const Record &record);
+    void formatFields(const Record &record, std::string &text);
+    size_t drain();
 
 public:
+    Logger(std::string baseLogFile, std::string communicationLogFile, std::string statsFile, Options options);
     Logger(std::string baseLogFile, std::string communicationLogFile, std::string statsFile);
     virtual ~Logger();
 
     void log(const std::string &message, Level level = Level::Default);
     void logCommunication(const Packet &packet, bool incoming, Uid uid);
     void writeStats(const Stats &stats);
+
+    /**
+     * Copies the arguments into the record as they are, numbers and addresses are formatted by the flusher.
+     * Meant to be called through the LOG_* macros.
+     */
+    template<typename... Args>
+    void write(Level level, const Args &... args)
+    {
+        Ring &ring = getRing();
+        Record *record = claim(ring);
+
+        if (!record) {
+            return;
+        }
+
+        record->sink = Sink::Fields;
+        record->level = static_cast<uint8_t>(level);
+
+        uint16_t length{0};
+        int expand[] = {0, (length = field(*record, length, args), 0)...};
+        (void) expand;
+
+        record->length = length;
+
+        commit(ring);
+    }
+
+    PacketCapture &getCapture();
+    uint64_t getDroppedCount() const;
+
+    void run() override;
+    void after() override;
 };
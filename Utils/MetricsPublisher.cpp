@@ -0,0 +1,106 @@
+#include <cstring>
+
+#include "MetricsPublisher.h"
+#include "../App.h"
+#include "../Exceptions.h"
+
+const size_t MetricsPublisher::METRICS_CAPACITY;
+
+MetricsPublisher::MetricsPublisher(App &app, std::string name)
+    : app(app),
+      name(std::move(name))
+{}
+
+bool MetricsPublisher::isEnabled() const
+{
+    return !name.empty();
+}
+
+const std::string &MetricsPublisher::getName() const
+{
+    return name;
+}
+
+void MetricsPublisher::before()
+{
+    // a refused connection is registered before it is rejected, so there may be one more
+    size_t connectionsCapacity = app.getMaxConnections() + 1;
+
+    segment.reset(new MetricsSegment{MetricsSegment::create(
+        name, METRICS_CAPACITY, connectionsCapacity, connectionsCapacity / 2 + 1)});
+
+    LOG_DEFAULT(app.getLogger(), "metrics published in ", MetricsSegment::pathOf(name));
+}
+
+void MetricsPublisher::publish()
+{
+    metrics.clear();
+    connections.clear();
+    games.clear();
+    playersGames.clear();
+
+    for (auto &metric : app.getStats().getMetrics()) {
+        MetricEntry entry{};
+        std::strncpy(entry.name, metric.name, sizeof(entry.name) - 1);
+        entry.gauge = metric.gauge;
+        entry.value = metric.value;
+        metrics.push_back(entry);
+    }
+
+    app.forEachGame([this](Game &game) {
+        GameEntry entry{};
+        entry.uid = game.getUid();
+        entry.phase = static_cast<uint8_t>(game.getPhase());
+        entry.scoreLeft = game.getPlayerScore(Side::Left);
+        entry.scoreRight = game.getPlayerScore(Side::Right);
+        entry.sendRate = game.getSendRate();
+        entry.updateRate = game.getUpdateRate();
+        entry.rallies = game.getRalliesCount();
+        games.push_back(entry);
+
+        playersGames[game.getPlayerUid(Side::Left)] = game.getUid();
+        playersGames[game.getPlayerUid(Side::Right)] = game.getUid();
+    });
+
+    app.forEachConnection([this](Connection &connection) {
+        ConnectionEntry entry{};
+        entry.uid = connection.getUid();
+        entry.rtt = connection.getClockSync().getRttPercentile(0.5);
+        entry.bytesReceived = connection.getBytesReceived();
+        entry.bytesSent = connection.getBytesSent();
+
+        auto found = playersGames.find(entry.uid);
+        entry.game = found != playersGames.end() ? found->second : -1;
+
+        try {
+            std::strncpy(entry.nickname, app.getNickname(entry.uid).c_str(), sizeof(entry.nickname) - 1);
+        }
+        catch (NoNicknameException &exception) {
+            // not logged yet
+        }
+
+        connections.push_back(entry);
+    });
+
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    segment->publish(now, metrics, connections, games);
+}
+
+void MetricsPublisher::run()
+{
+    while (!shouldStop()) {
+        publish();
+
+        auto lock = acquireLock();
+        waitFor(lock, PUBLISH_PERIOD, [this]() {
+            return shouldStop();
+        });
+    }
+}
+
+void MetricsPublisher::after()
+{
+    segment.reset();
+}
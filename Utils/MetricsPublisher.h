@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Thread.h"
+#include "MetricsSegment.h"
+
+class App;
+
+/**
+ * Copies the stats and the state of the connections and games into the shared memory segment periodically,
+ * the readers (ups-top) never touch the server process.
+ */
+class MetricsPublisher: public Thread
+{
+public:
+    const std::chrono::milliseconds PUBLISH_PERIOD{100};
+    static const size_t METRICS_CAPACITY{64};
+
+private:
+    App &app;
+    std::string name;
+    std::unique_ptr<MetricsSegment> segment;
+
+    std::vector<MetricEntry> metrics;
+    std::vector<ConnectionEntry> connections;
+    std::vector<GameEntry> games;
+    std::unordered_map<Uid, Uid> playersGames;
+
+    void publish();
+
+public:
+    MetricsPublisher(App &app, std::string name);
+
+    bool isEnabled() const;
+    const std::string &getName() const;
+
+    void before() override;
+    void run() override;
+    void after() override;
+};
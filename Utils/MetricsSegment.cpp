@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MetricsSegment.h"
+#include "../Exceptions.h"
+
+MetricsSegment::MetricsSegment(std::string path, bool writable)
+    : path(std::move(path)),
+      writable{writable},
+      size{0},
+      memory{nullptr}
+{}
+
+MetricsSegment::MetricsSegment(MetricsSegment &&segment) noexcept
+    : path(std::move(segment.path)),
+      writable{segment.writable},
+      size{segment.size},
+      memory{segment.memory}
+{
+    segment.memory = nullptr;
+}
+
+std::string MetricsSegment::pathOf(const std::string &name)
+{
+    return "/dev/shm/" + name;
+}
+
+MetricsSegment MetricsSegment::create(const std::string &name, size_t metrics, size_t connections, size_t games)
+{
+    MetricsSegment segment{pathOf(name), true};
+    segment.size = sizeof(MetricsHeader)
+        + metrics * sizeof(MetricEntry)
+        + connections * sizeof(ConnectionEntry)
+        + games * sizeof(GameEntry);
+
+    int fd = ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd == -1 || ::ftruncate(fd, static_cast<off_t>(segment.size)) != 0) {
+        std::string message = "can not create metrics segment " + segment.path + ": " + std::strerror(errno);
+        if (fd != -1) {
+            ::close(fd);
+        }
+        throw MetricsException(message);
+    }
+
+    void *memory = ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (memory == MAP_FAILED) {
+        throw MetricsException("can not map metrics segment " + segment.path + ": " + std::strerror(errno));
+    }
+
+    segment.memory = memory;
+
+    // the file is zero filled, so the sequence starts even and the counts empty
+    MetricsHeader &header = segment.header();
+    std::memcpy(header.magic, METRICS_MAGIC, sizeof(header.magic));
+    header.version = METRICS_VERSION;
+    header.pid = static_cast<uint32_t>(::getpid());
+    header.metricsCapacity = static_cast<uint32_t>(metrics);
+    header.connectionsCapacity = static_cast<uint32_t>(connections);
+    header.gamesCapacity = static_cast<uint32_t>(games);
+
+    return segment;
+}
+
+MetricsSegment MetricsSegment::attach(const std::string &name)
+{
+    MetricsSegment segment{pathOf(name), false};
+
+    int fd = ::open(segment.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        throw MetricsException("can not open metrics segment " + segment.path + ": " + std::strerror(errno));
+    }
+
+    struct stat status{};
+    ::fstat(fd, &status);
+    segment.size = static_cast<size_t>(status.st_size);
+
+    if (segment.size < sizeof(MetricsHeader)) {
+        ::close(fd);
+        throw MetricsException("metrics segment " + segment.path + " is too short");
+    }
+
+    void *memory = ::mmap(nullptr, segment.size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (memory == MAP_FAILED) {
+        throw MetricsException("can not map metrics segment " + segment.path + ": " + std::strerror(errno));
+    }
+
+    segment.memory = memory;
+
+    MetricsHeader &header = segment.header();
+    size_t expected = sizeof(MetricsHeader)
+        + header.metricsCapacity * sizeof(MetricEntry)
+        + header.connectionsCapacity * sizeof(ConnectionEntry)
+        + header.gamesCapacity * sizeof(GameEntry);
+
+    if (std::memcmp(header.magic, METRICS_MAGIC, sizeof(header.magic)) != 0) {
+        throw MetricsException(segment.path + " is not a metrics segment");
+    }
+
+    if (header.version != METRICS_VERSION) {
+        throw MetricsException("unsupported metrics segment version " + std::to_string(header.version));
+    }
+
+    if (expected > segment.size) {
+        throw MetricsException("metrics segment " + segment.path + " is truncated");
+    }
+
+    return segment;
+}
+
+MetricsHeader &MetricsSegment::header() const
+{
+    return *static_cast<MetricsHeader *>(memory);
+}
+
+MetricEntry *MetricsSegment::metrics() const
+{
+    return reinterpret_cast<MetricEntry *>(static_cast<char *>(memory) + sizeof(MetricsHeader));
+}
+
+ConnectionEntry *MetricsSegment::connections() const
+{
+    return reinterpret_cast<ConnectionEntry *>(metrics() + header().metricsCapacity);
+}
+
+GameEntry *MetricsSegment::games() const
+{
+    return reinterpret_cast<GameEntry *>(connections() + header().connectionsCapacity);
+}
+
+void MetricsSegment::publish(int64_t now,
+                             const std::vector<MetricEntry> &metrics,
+                             const std::vector<ConnectionEntry> &connections,
+                             const std::vector<GameEntry> &games)
+{
+    MetricsHeader &header = this->header();
+
+    auto metricsCount = static_cast<uint32_t>(std::min<size_t>(metrics.size(), header.metricsCapacity));
+    auto connectionsCount = static_cast<uint32_t>(std::min<size_t>(connections.size(), header.connectionsCapacity));
+    auto gamesCount = static_cast<uint32_t>(std::min<size_t>(games.size(), header.gamesCapacity));
+
+    // odd sequence, the readers retry until the write is over
+    uint64_t sequence = header.sequence.load(std::memory_order_relaxed);
+    header.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header.updatedAt = now;
+    header.metricsCount = metricsCount;
+    header.connectionsCount = connectionsCount;
+    header.gamesCount = gamesCount;
+
+    std::memcpy(this->metrics(), metrics.data(), metricsCount * sizeof(MetricEntry));
+    std::memcpy(this->connections(), connections.data(), connectionsCount * sizeof(ConnectionEntry));
+    std::memcpy(this->games(), games.data(), gamesCount * sizeof(GameEntry));
+
+    header.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool MetricsSegment::read(Snapshot &snapshot) const
+{
+    MetricsHeader &header = this->header();
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        uint64_t sequence = header.sequence.load(std::memory_order_acquire);
+
+        if (sequence & 1) {
+            continue;
+        }
+
+        snapshot.pid = header.pid;
+        snapshot.updatedAt = header.updatedAt;
+
+        // a torn count is caught by the sequence check, it only must not overflow the arrays
+        size_t metricsCount = std::min(header.metricsCount, header.metricsCapacity);
+        size_t connectionsCount = std::min(header.connectionsCount, header.connectionsCapacity);
+        size_t gamesCount = std::min(header.gamesCount, header.gamesCapacity);
+
+        snapshot.metrics.assign(metrics(), metrics() + metricsCount);
+        snapshot.connections.assign(connections(), connections() + connectionsCount);
+        snapshot.games.assign(games(), games() + gamesCount);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (header.sequence.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+MetricsSegment::~MetricsSegment()
+{
+    if (memory) {
+        ::munmap(memory, size);
+
+        // the segment disappears with the server, readers still mapping it keep the last snapshot
+        if (writable) {
+            ::unlink(path.c_str());
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Types.h"
+
+const char METRICS_MAGIC[8]{'U', 'P', 'S', 'M', 'T', 'R', 'C', '\0'};
+const uint32_t METRICS_VERSION{2};
+
+/**
+ * Leads the shared memory segment, the metrics, the connections and the games follow in this order.
+ * The whole segment is guarded by the sequence: odd while it is being written.
+ */
+struct MetricsHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    std::atomic<uint64_t> sequence;
+    int64_t updatedAt;
+    uint32_t metricsCapacity;
+    uint32_t metricsCount;
+    uint32_t connectionsCapacity;
+    uint32_t connectionsCount;
+    uint32_t gamesCapacity;
+    uint32_t gamesCount;
+};
+
+struct MetricEntry
+{
+    char name[47];
+    uint8_t gauge;
+    uint64_t value;
+};
+
+struct ConnectionEntry
+{
+    Uid uid;
+    Uid game;
+    int64_t rtt;
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    char nickname[16];
+};
+
+struct GameEntry
+{
+    Uid uid;
+    uint8_t phase;
+    uint8_t scoreLeft;
+    uint8_t scoreRight;
+    uint8_t reserved;
+    double sendRate;
+    double updateRate;
+    uint64_t rallies;
+};
+
+static_assert(sizeof(MetricsHeader) == 56, "metrics header must keep its layout");
+static_assert(sizeof(MetricEntry) == 56, "metric entries must keep their layout");
+static_assert(sizeof(ConnectionEntry) == 48, "connection entries must keep their layout");
+static_assert(sizeof(GameEntry) == 32, "game entries must keep their layout");
+
+/**
+ * Versioned metrics snapshot in a file mapped from /dev/shm, published by the server
+ * and read by any number of processes without syscalls or locks (seqlock).
+ */
+class MetricsSegment
+{
+public:
+    struct Snapshot
+    {
+        uint32_t pid{0};
+        int64_t updatedAt{0};
+        std::vector<MetricEntry> metrics;
+        std::vector<ConnectionEntry> connections;
+        std::vector<GameEntry> games;
+    };
+
+    static const int READ_ATTEMPTS{1000};
+
+private:
+    std::string path;
+    bool writable;
+    size_t size;
+    void *memory;
+
+    MetricsHeader &header() const;
+    MetricEntry *metrics() const;
+    ConnectionEntry *connections() const;
+    GameEntry *games() const;
+
+    MetricsSegment(std::string path, bool writable);
+
+public:
+    static std::string pathOf(const std::string &name);
+
+    // the server creates the segment, the readers attach to it read only
+    static MetricsSegment create(const std::string &name, size_t metrics, size_t connections, size_t games);
+    static MetricsSegment attach(const std::string &name);
+
+    MetricsSegment(MetricsSegment &&segment) noexcept;
+    MetricsSegment(const MetricsSegment &segment) = delete;
+    virtual ~MetricsSegment();
+
+    void publish(int64_t now,
+                 const std::vector<MetricEntry> &metrics,
+                 const std::vector<ConnectionEntry> &connections,
+                 const std::vector<GameEntry> &games);
+    bool read(Snapshot &snapshot) const;
+};
@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "Profiler.h"
+#include "../Exceptions.h"
+
+const unsigned Profiler::DEFAULT_FREQUENCY;
+const size_t Profiler::SAMPLES_CAPACITY;
+const int Profiler::MAX_DEPTH;
+
+// older glibc names the thread of SIGEV_THREAD_ID only in the kernel headers
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+std::atomic<Profiler *> Profiler::active{nullptr};
+std::atomic<int> Profiler::handlersRunning{0};
+
+namespace
+{
+    // registers of the interrupted thread the stack is walked from
+    bool interruptedFrame(void *context, uintptr_t &pc, uintptr_t &sp, uintptr_t &fp)
+    {
+        auto *ucontext = static_cast<ucontext_t *>(context);
+
+#if defined(__x86_64__)
+        pc = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]);
+        sp = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RSP]);
+        fp = static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RBP]);
+        return true;
+#elif defined(__aarch64__)
+        pc = ucontext->uc_mcontext.pc;
+        sp = ucontext->uc_mcontext.sp;
+        fp = ucontext->uc_mcontext.regs[29];
+        return true;
+#else
+        (void) ucontext;
+        (void) pc;
+        (void) sp;
+        (void) fp;
+        return false;
+#endif
+    }
+
+    // the frame record is the caller's frame pointer and the return address, read through the kernel,
+    // so that a frame pointer register used for anything else fails the read instead of faulting
+    bool readFrameRecord(uintptr_t fp, uintptr_t record[2])
+    {
+        iovec local{record, 2 * sizeof(uintptr_t)};
+        iovec remote{reinterpret_cast<void *>(fp), 2 * sizeof(uintptr_t)};
+
+        return ::process_vm_readv(::getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(2 * sizeof(uintptr_t));
+    }
+
+    // the parameter list of a demangled function, so that the frames stay readable
+    std::string withoutParameters(const std::string &name)
+    {
+        size_t end = name.rfind(')');
+
+        if (end == std::string::npos || name.find_first_not_of(" const", end + 1) != std::string::npos) {
+            return name;
+        }
+
+        int depth{0};
+
+        for (size_t i = end + 1; i > 0; --i) {
+            if (name[i - 1] == ')') {
+                ++depth;
+            } else if (name[i - 1] == '(' && --depth == 0) {
+                return name.substr(0, i - 1);
+            }
+        }
+
+        return name;
+    }
+
+    bool isCode(void *address)
+    {
+        Dl_info info{};
+        return ::dladdr(address, &info) && info.dli_fname;
+    }
+
+    std::string symbolName(void *address)
+    {
+        Dl_info info{};
+
+        if (::dladdr(address, &info) && info.dli_sname) {
+            int status;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name{status == 0 ? withoutParameters(demangled) : info.dli_sname};
+            std::free(demangled);
+
+            // the collapsed format separates the frames by semicolons
+            std::replace(name.begin(), name.end(), ';', ':');
+            return name;
+        }
+
+        // static or stripped functions are located by the offset in their module
+        std::stringstream stream;
+        const char *module = info.dli_fname ? std::strrchr(info.dli_fname, '/') : nullptr;
+        stream << (module ? module + 1 : "?") << "+0x" << std::hex
+               << (reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(info.dli_fbase));
+
+        return stream.str();
+    }
+}
+
+Profiler::Profiler()
+    : frequency{DEFAULT_FREQUENCY},
+      samplesCount{0},
+      samplesDropped{0}
+{}
+
+void Profiler::installHandler()
+{
+    // installed once and never removed, a SIGPROF still pending after stopping would kill the process otherwise
+    static bool installed{false};
+
+    if (installed) {
+        return;
+    }
+
+    struct sigaction action{};
+    action.sa_sigaction = &Profiler::handleSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (::sigaction(SIGPROF, &action, nullptr) != 0) {
+        throw ProfilerException("can not install the profiling signal handler: " + std::string{std::strerror(errno)});
+    }
+
+    installed = true;
+}
+
+void Profiler::handleSignal(int, siginfo_t *, void *context)
+{
+    int savedErrno = errno;
+    handlersRunning.fetch_add(1);
+
+    Profiler *profiler = active.load();
+
+    if (profiler) {
+        profiler->sample(context);
+    }
+
+    handlersRunning.fetch_sub(1);
+    errno = savedErrno;
+}
+
+void Profiler::sample(void *context)
+{
+    size_t index = samplesCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (index >= SAMPLES_CAPACITY) {
+        samplesDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Sample &sample = samples[index];
+    sample.depth = 0;
+
+    uintptr_t pc, sp, fp;
+
+    if (interruptedFrame(context, pc, sp, fp)) {
+        sample.frames[sample.depth++] = pc;
+
+        // every frame lies above the previous one on the stack, which ends the walk at the bottom or on garbage
+        while (sample.depth < MAX_DEPTH && fp >= sp && fp % sizeof(uintptr_t) == 0) {
+            uintptr_t record[2];
+
+            if (!readFrameRecord(fp, record) || record[1] == 0) {
+                break;
+            }
+
+            sample.frames[sample.depth++] = record[1];
+            sp = fp + 2 * sizeof(uintptr_t);
+            fp = record[0];
+        }
+    }
+
+    sample.ready.store(true, std::memory_order_release);
+}
+
+unsigned Profiler::getFrequency() const
+{
+    return frequency;
+}
+
+void Profiler::setFrequency(unsigned frequency)
+{
+    this->frequency = std::max(1u, std::min(frequency, 10000u));
+}
+
+size_t Profiler::getSamplesCount() const
+{
+    return std::min(samplesCount.load(), SAMPLES_CAPACITY);
+}
+
+uint64_t Profiler::getSamplesDropped() const
+{
+    return samplesDropped.load();
+}
+
+void Profiler::before()
+{
+    Profiler *expected{nullptr};
+
+    if (!active.compare_exchange_strong(expected, this)) {
+        throw ProfilerException("another profiler is running");
+    }
+
+    samples.reset(new Sample[SAMPLES_CAPACITY]);
+    for (size_t i = 0; i < SAMPLES_CAPACITY; ++i) {
+        samples[i].ready.store(false, std::memory_order_relaxed);
+    }
+
+    samplesCount = 0;
+    samplesDropped = 0;
+    stacks.clear();
+
+    installHandler();
+}
+
+void Profiler::scanThreads()
+{
+    int self = static_cast<int>(::syscall(SYS_gettid));
+    std::vector<int> tids;
+
+    DIR *directory = ::opendir("/proc/self/task");
+
+    if (!directory) {
+        return;
+    }
+
+    while (dirent *entry = ::readdir(directory)) {
+        if (entry->d_name[0] != '.') {
+            tids.push_back(std::atoi(entry->d_name));
+        }
+    }
+
+    ::closedir(directory);
+
+    // the timers of finished threads go, so that a reused thread id gets a new one
+    for (auto i = timers.begin(); i != timers.end();) {
+        if (std::find(tids.begin(), tids.end(), i->first) == tids.end()) {
+            ::timer_delete(i->second);
+            i = timers.erase(i);
+        } else {
+            ++i;
+        }
+    }
+
+    long interval = 1000000000l / frequency;
+    itimerspec spec{{interval / 1000000000l, interval % 1000000000l}, {interval / 1000000000l, interval % 1000000000l}};
+
+    for (int tid : tids) {
+        if (tid == self || timers.count(tid)) {
+            continue;
+        }
+
+        sigevent event{};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_notify_thread_id = tid;
+
+        // CPU clock of the thread, as pthread_getcpuclockid makes it, only the running time is sampled
+        auto clock = static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6);
+        timer_t timer;
+
+        if (::timer_create(clock, &event, &timer) != 0) {
+            // the thread finished meanwhile
+            continue;
+        }
+
+        ::timer_settime(timer, 0, &spec, nullptr);
+        timers[tid] = timer;
+    }
+}
+
+void Profiler::run()
+{
+    // new connections and games start threads all the time
+    while (!shouldStop()) {
+        scanThreads();
+
+        auto lock = acquireLock();
+        waitFor(lock, SCAN_PERIOD, [this]() {
+            return shouldStop();
+        });
+    }
+}
+
+void Profiler::after()
+{
+    for (auto &timer : timers) {
+        ::timer_delete(timer.second);
+    }
+    timers.clear();
+
+    active.store(nullptr);
+
+    // a handler may still be writing a sample
+    while (handlersRunning.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    symbolize();
+    samples.reset();
+}
+
+void Profiler::symbolize()
+{
+    std::unordered_map<void *, std::string> names;
+
+    auto nameOf = [&names](void *address) -> const std::string & {
+        auto found = names.find(address);
+
+        if (found == names.end()) {
+            found = names.emplace(address, symbolName(address)).first;
+        }
+
+        return found->second;
+    };
+
+    for (size_t i = 0; i < getSamplesCount(); ++i) {
+        Sample &sample = samples[i];
+
+        if (!sample.ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        // return addresses point past the call, look up the call itself
+        std::vector<void *> addresses;
+
+        for (int j = 0; j < sample.depth; ++j) {
+            auto address = reinterpret_cast<void *>(j == 0 ? sample.frames[j] : sample.frames[j] - 1);
+
+            // the frame pointer register of a function built without one held anything, the walk went astray
+            if (j > 0 && !isCode(address)) {
+                break;
+            }
+
+            addresses.push_back(address);
+        }
+
+        std::vector<std::string> stack;
+
+        for (auto address = addresses.rbegin(); address != addresses.rend(); ++address) {
+            stack.push_back(nameOf(*address));
+        }
+
+        if (!stack.empty()) {
+            ++stacks[stack];
+        }
+    }
+}
+
+void Profiler::writeCollapsed(std::ostream &stream) const
+{
+    for (auto &stack : stacks) {
+        for (size_t i = 0; i < stack.first.size(); ++i) {
+            stream << (i ? ";" : "") << stack.first[i];
+        }
+
+        stream << " " << stack.second << "\n";
+    }
+}
+
+std::vector<std::pair<std::string, uint64_t>> Profiler::getHottest(size_t count) const
+{
+    // self samples, the function running when the sample was taken
+    std::unordered_map<std::string, uint64_t> functions;
+
+    for (auto &stack : stacks) {
+        functions[stack.first.back()] += stack.second;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> hottest{functions.begin(), functions.end()};
+
+    size_t shown = std::min(count, hottest.size());
+    std::partial_sort(hottest.begin(), hottest.begin() + shown, hottest.end(),
+                      [](const std::pair<std::string, uint64_t> &a, const std::pair<std::string, uint64_t> &b) {
+                          return a.second > b.second;
+                      });
+    hottest.resize(shown);
+
+    return hottest;
+}
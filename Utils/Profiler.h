@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <csignal>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Thread.h"
+
+/**
+ * Sampling CPU profiler of all the threads of the process. Every thread gets a timer on its own CPU clock
+ * signalling it with SIGPROF, the handler walks the frame pointers of the interrupted thread into preallocated
+ * samples, nothing is allocated or locked in the signal context. The samples are symbolized once the profiling
+ * stops and written as collapsed stacks for the flame graphs.
+ *
+ * Functions built without frame pointers, the system libraries, hide their caller from the stack.
+ */
+class Profiler: public Thread
+{
+public:
+    static const unsigned DEFAULT_FREQUENCY{99};
+    static const size_t SAMPLES_CAPACITY{1u << 15};
+    static const int MAX_DEPTH{48};
+    const std::chrono::milliseconds SCAN_PERIOD{100};
+
+private:
+    struct Sample
+    {
+        std::atomic<bool> ready;
+        int depth;
+        // the interrupted instruction first, then the return addresses
+        uintptr_t frames[MAX_DEPTH];
+    };
+
+    // the handler samples into the active profiler only
+    static std::atomic<Profiler *> active;
+    static std::atomic<int> handlersRunning;
+
+    static void handleSignal(int signal, siginfo_t *info, void *context);
+    static void installHandler();
+
+    unsigned frequency;
+    std::unique_ptr<Sample[]> samples;
+    std::atomic<size_t> samplesCount;
+    std::atomic<uint64_t> samplesDropped;
+    std::unordered_map<int, timer_t> timers;
+    std::map<std::vector<std::string>, uint64_t> stacks;
+
+    void sample(void *context);
+    void scanThreads();
+    void symbolize();
+
+public:
+    Profiler();
+
+    unsigned getFrequency() const;
+    void setFrequency(unsigned frequency);
+
+    size_t getSamplesCount() const;
+    uint64_t getSamplesDropped() const;
+
+    void before() override;
+    void run() override;
+    void after() override;
+
+    // valid once the profiler stopped
+    void writeCollapsed(std::ostream &stream) const;
+    std::vector<std::pair<std::string, uint64_t>> getHottest(size_t count) const;
+};
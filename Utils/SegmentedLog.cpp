@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SegmentedLog.h"
+#include "../Exceptions.h"
+
+SegmentedLog::SegmentedLog(std::string path, Options options, std::string header)
+    : path(std::move(path)),
+      header(std::move(header)),
+      options(options),
+      fd{-1},
+      index{0},
+      size{0}
+{
+    size_t slash = this->path.rfind('/');
+    std::string name = slash == std::string::npos ? this->path : this->path.substr(slash + 1);
+    directory = slash == std::string::npos ? "." : this->path.substr(0, slash);
+
+    size_t dot = name.rfind('.');
+    stem = dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+    extension = dot == std::string::npos || dot == 0 ? "" : name.substr(dot);
+
+    if (this->options.segmentSize == 0 || this->options.segmentsKept == 0) {
+        throw LoggerException("log segments must have a size and at least one must be kept");
+    }
+
+    // the logs of the previous runs are continued, not truncated
+    scan();
+    adopt();
+
+    if (!open()) {
+        throw LoggerException("can not open log segment " + getSegmentPath() + ": " + std::strerror(errno));
+    }
+}
+
+std::string SegmentedLog::segmentName(unsigned index) const
+{
+    char number[16];
+    std::snprintf(number, sizeof(number), "%06u", index);
+
+    return stem + "." + number + extension;
+}
+
+bool SegmentedLog::parseSegmentName(const std::string &name, unsigned &index) const
+{
+    if (name.size() <= stem.size() + 1 + extension.size()
+        || name.compare(0, stem.size() + 1, stem + ".") != 0
+        || name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+        return false;
+    }
+
+    std::string number = name.substr(stem.size() + 1, name.size() - stem.size() - 1 - extension.size());
+
+    if (number.size() > 9 || !std::all_of(number.begin(), number.end(), ::isdigit)) {
+        return false;
+    }
+
+    index = static_cast<unsigned>(std::stoul(number));
+    return true;
+}
+
+void SegmentedLog::scan()
+{
+    DIR *dir = ::opendir(directory.c_str());
+
+    if (!dir) {
+        return;
+    }
+
+    unsigned found;
+
+    while (dirent *entry = ::readdir(dir)) {
+        if (parseSegmentName(entry->d_name, found)) {
+            segments.push_back(found);
+        }
+    }
+
+    ::closedir(dir);
+    std::sort(segments.begin(), segments.end());
+}
+
+void SegmentedLog::adopt()
+{
+    struct stat status{};
+
+    // a plain file left by an older version becomes the newest segment instead of being overwritten
+    if (::lstat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode)) {
+        unsigned adopted = segments.empty() ? 1 : segments.back() + 1;
+
+        if (::rename(path.c_str(), (directory + "/" + segmentName(adopted)).c_str()) == 0) {
+            segments.push_back(adopted);
+        }
+    }
+}
+
+bool SegmentedLog::open()
+{
+    index = segments.empty() ? 1 : segments.back() + 1;
+
+    fd = ::open(getSegmentPath().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    // the size of the file stays zero, the reserved blocks are only filled by the appends
+    ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(options.segmentSize));
+
+    size = 0;
+    openedAt = std::chrono::steady_clock::now();
+    segments.push_back(index);
+
+    link();
+    retain();
+
+    return writeAll(header.data(), header.size());
+}
+
+void SegmentedLog::rotate()
+{
+    if (fd != -1) {
+        // releases the reserved blocks which were not used
+        ::ftruncate(fd, static_cast<off_t>(size));
+        ::close(fd);
+        fd = -1;
+    }
+
+    open();
+}
+
+void SegmentedLog::link()
+{
+    std::string temporary = path + ".link";
+
+    // replaced by a rename, so that the link is never missing
+    ::unlink(temporary.c_str());
+
+    if (::symlink(segmentName(index).c_str(), temporary.c_str()) == 0) {
+        ::rename(temporary.c_str(), path.c_str());
+    }
+}
+
+void SegmentedLog::retain()
+{
+    while (segments.size() > options.segmentsKept) {
+        ::unlink((directory + "/" + segmentName(segments.front())).c_str());
+        segments.erase(segments.begin());
+    }
+}
+
+bool SegmentedLog::writeAll(const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        this->size += static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+bool SegmentedLog::write(const char *data, size_t size)
+{
+    if (size == 0) {
+        return true;
+    }
+
+    bool full = this->size + size > options.segmentSize;
+    bool old = options.segmentPeriod.count() > 0
+        && std::chrono::steady_clock::now() - openedAt >= options.segmentPeriod;
+
+    // a segment holds at least one batch, even a batch bigger than the segment size
+    if (fd == -1 || (this->size > header.size() && (full || old))) {
+        rotate();
+    }
+
+    if (fd == -1) {
+        return false;
+    }
+
+    return writeAll(data, size);
+}
+
+std::string SegmentedLog::getSegmentPath() const
+{
+    return directory + "/" + segmentName(index);
+}
+
+SegmentedLog::~SegmentedLog()
+{
+    if (fd != -1) {
+        ::ftruncate(fd, static_cast<off_t>(size));
+        ::close(fd);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only log split into numbered segments next to the given path (server.log -> server.000001.log),
+ * the path itself is kept as a symbolic link to the segment being written.
+ * A segment is rotated when it would outgrow the size limit or when it gets older than the period,
+ * only the newest segments are kept. The space of each segment is reserved up front with fallocate,
+ * so that the appends never wait for the file system to allocate new extents.
+ * Not thread safe, meant to be written by a single flusher.
+ */
+class SegmentedLog
+{
+public:
+    struct Options
+    {
+        size_t segmentSize{64 * 1024 * 1024};
+        // zero disables the time rotation
+        std::chrono::seconds segmentPeriod{std::chrono::hours{24}};
+        size_t segmentsKept{16};
+    };
+
+private:
+    std::string path;
+    std::string directory;
+    std::string stem;
+    std::string extension;
+    // written at the beginning of every segment, so that each one can be read alone
+    std::string header;
+    Options options;
+
+    int fd;
+    unsigned index;
+    size_t size;
+    std::chrono::steady_clock::time_point openedAt;
+    std::vector<unsigned> segments;
+
+    std::string segmentName(unsigned index) const;
+    bool parseSegmentName(const std::string &name, unsigned &index) const;
+
+    void scan();
+    void adopt();
+    bool open();
+    void rotate();
+    void link();
+    void retain();
+    bool writeAll(const char *data, size_t size);
+
+public:
+    SegmentedLog(std::string path, Options options, std::string header = "");
+    SegmentedLog(const SegmentedLog &log) = delete;
+    virtual ~SegmentedLog();
+
+    bool write(const char *data, size_t size);
+    std::string getSegmentPath() const;
+};
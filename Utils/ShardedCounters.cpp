@@ -0,0 +1,9 @@
+#include "ShardedCounters.h"
+
+size_t currentShard(size_t shardsCount)
+{
+    static std::atomic<size_t> lastShard{0};
+    static thread_local size_t shard{lastShard++};
+
+    return shard % shardsCount;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// shard of the calling thread, the threads are spread over the shards in the order they first count
+size_t currentShard(size_t shardsCount);
+
+/**
+ * Fixed set of counters split into cache line aligned shards, each thread increments only its own shard
+ * with relaxed atomics and the shards are summed on read.
+ */
+template<size_t COUNT>
+class ShardedCounters
+{
+public:
+    static const size_t SHARDS_COUNT{64};
+
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, COUNT> values;
+    };
+
+    std::array<Shard, SHARDS_COUNT> shards;
+
+public:
+    ShardedCounters()
+    {
+        for (auto &shard : shards) {
+            for (auto &value : shard.values) {
+                value.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ShardedCounters(const ShardedCounters &counters) = delete;
+
+    void add(size_t counter, uint64_t count)
+    {
+        shards[currentShard(SHARDS_COUNT)].values[counter].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    uint64_t get(size_t counter) const
+    {
+        uint64_t sum{0};
+
+        for (auto &shard : shards) {
+            sum += shard.values[counter].load(std::memory_order_relaxed);
+        }
+
+        return sum;
+    }
+};
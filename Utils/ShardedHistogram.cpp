@@ -0,0 +1,62 @@
+#include "ShardedHistogram.h"
+#include "ShardedCounters.h"
+
+ShardedHistogram::ShardedHistogram()
+{
+    for (auto &shard : shards) {
+        shard.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Histogram &ShardedHistogram::getShard()
+{
+    std::atomic<Histogram *> &slot = shards[currentShard(SHARDS_COUNT)];
+    Histogram *shard = slot.load(std::memory_order_acquire);
+
+    if (!shard) {
+        // two threads of one shard may race, the loser frees its copy
+        auto *created = new Histogram{};
+
+        if (slot.compare_exchange_strong(shard, created, std::memory_order_acq_rel)) {
+            shard = created;
+        } else {
+            delete created;
+        }
+    }
+
+    return *shard;
+}
+
+void ShardedHistogram::record(int64_t value)
+{
+    getShard().record(value);
+}
+
+bool ShardedHistogram::isEmpty() const
+{
+    for (auto &shard : shards) {
+        if (shard.load(std::memory_order_acquire)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ShardedHistogram::mergeInto(Histogram &histogram) const
+{
+    for (auto &shard : shards) {
+        Histogram *current = shard.load(std::memory_order_acquire);
+
+        if (current) {
+            histogram.merge(*current);
+        }
+    }
+}
+
+ShardedHistogram::~ShardedHistogram()
+{
+    for (auto &shard : shards) {
+        delete shard.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "Histogram.h"
+
+/**
+ * Histogram split into per thread shards like the ShardedCounters, so that the recording threads
+ * do not share cache lines. A shard is allocated only when its first value is recorded,
+ * the shards are merged on read.
+ */
+class ShardedHistogram
+{
+public:
+    static const size_t SHARDS_COUNT{64};
+
+private:
+    std::array<std::atomic<Histogram *>, SHARDS_COUNT> shards;
+
+    Histogram &getShard();
+
+public:
+    ShardedHistogram();
+    ShardedHistogram(const ShardedHistogram &histogram) = delete;
+    virtual ~ShardedHistogram();
+
+    void record(int64_t value);
+
+    bool isEmpty() const;
+    void mergeInto(Histogram &histogram) const;
+};
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -9,6 +11,7 @@
 #include "../Exceptions.h"
 #include "../Network/Server.h"
 #include "../Game/Game.h"
+#include "LockProfiler.h"
 
 Shell::Shell(App &app)
     : input(std::cin),
@@ -38,7 +41,7 @@ void Shell::run()
 void Shell::after()
 {
     app.stop(false);
-    app.getLogger().log("shell stopped");
+    LOG_DEFAULT(app.getLogger(), "shell stopped");
 }
 
 void Shell::handle(std::string line)
@@ -76,8 +79,22 @@ void Shell::cmdHelp(std::vector<std::string> arguments)
     output << Text::justifyL("help", 10) << "- print help" << std::endl;
     output << Text::justifyL("info", 10) << "- print server info" << std::endl;
     output << Text::justifyL("stats", 10) << "- print server statistics" << std::endl;
+    output << Text::justifyL("capture", 10) << "- print the communication capture rates" << std::endl;
+    output << Text::justifyL("", 10) << "  capture <type|all> <off|all|N> - capture none, every or one of N packets" << std::endl;
+    output << Text::justifyL("", 10) << "  capture echo <on|off> - print the captured packets" << std::endl;
     output << Text::justifyL("players", 10) << "- print list of players" << std::endl;
     output << Text::justifyL("games", 10) << "- print list of games" << std::endl;
+    output << Text::justifyL("top", 10) << "- print the busiest connections and games" << std::endl;
+    output << Text::justifyL("", 10) << "  top connections [N] [bytes|packets|queue|rtt|corrupted|idle]" << std::endl;
+    output << Text::justifyL("", 10) << "  top games [N] [sends|updates|rallies|lateness]" << std::endl;
+    output << Text::justifyL("trace", 10) << "- trace the packets through the server" << std::endl;
+    output << Text::justifyL("", 10) << "  trace <on|off> - record the spans of every packet" << std::endl;
+    output << Text::justifyL("", 10) << "  trace dump <file> [milliseconds] - write the recent spans as Chrome trace JSON" << std::endl;
+    output << Text::justifyL("locks", 10) << "- print the most contended locks, needs a UPS_LOCK_PROFILING build" << std::endl;
+    output << Text::justifyL("", 10) << "  locks [N] [wait|contended|hold]" << std::endl;
+    output << Text::justifyL("profile", 10) << "- sample the CPU usage of all the threads" << std::endl;
+    output << Text::justifyL("", 10) << "  profile start [hz] - start sampling, 99 samples per second of CPU time by default" << std::endl;
+    output << Text::justifyL("", 10) << "  profile stop <file> - stop and write the collapsed stacks for a flame graph" << std::endl;
     output << Text::justifyL("exit", 10) << "- stop the server and exit" << std::endl;
 
     output << Text::hline() << std::endl;
@@ -99,7 +116,53 @@ void Shell::cmdStats(std::vector<std::string> arguments)
     output << std::endl;
     output << Text::hline() << std::endl;
     output << "Statistics:" << std::endl << std::endl;
+    app.updateGameRates();
     output << app.getStats().toLog() << std::endl;
+
+    output << Text::hline() << std::endl;
+    output << std::endl;
+}
+
+void Shell::cmdCapture(std::vector<std::string> arguments)
+{
+    PacketCapture &capture = app.getLogger().getCapture();
+
+    if (arguments.size() == 3 && arguments[1] == "echo") {
+        capture.setEcho(arguments[2] == "on");
+    }
+    else if (arguments.size() == 3) {
+        uint32_t rate;
+
+        if (arguments[2] == "off") {
+            rate = 0;
+        } else if (arguments[2] == "all") {
+            rate = 1;
+        } else {
+            rate = static_cast<uint32_t>(std::stoul(arguments[2]));
+        }
+
+        if (arguments[1] == "all") {
+            for (size_t i = 0; i < PacketCapture::TYPES.size(); ++i) {
+                capture.setRate(static_cast<uint8_t>(i), rate);
+            }
+        } else {
+            uint8_t type = PacketCapture::typeId(arguments[1]);
+
+            if (type == PacketCapture::OTHER_TYPE && arguments[1] != "other") {
+                throw UnknownCommandException("unknown packet type " + arguments[1]);
+            }
+
+            capture.setRate(type, rate);
+        }
+    }
+    else if (arguments.size() != 1) {
+        throw UnknownCommandException("usage: capture [<type|all> <off|all|N>] [echo <on|off>]");
+    }
+
+    output << std::endl;
+    output << Text::hline() << std::endl;
+    output << "Capture:" << std::endl << std::endl;
+    output << capture.toLog();
     output << Text::hline() << std::endl;
     output << std::endl;
 }
@@ -113,11 +176,13 @@ void Shell::cmdPlayers(std::vector<std::string> arguments)
 
     size_t count = app.forEachConnection([this](Connection &connection) {
         try {
-            output << connection.getUid() << ": " << app.getNickname(connection.getUid()) << std::endl;
+            output << connection.getUid() << ": " << app.getNickname(connection.getUid());
         }
         catch (NoNicknameException &exception) {
-            output << connection.getUid() << ": " << "[not logged]" << std::endl;
+            output << connection.getUid() << ": " << "[not logged]";
         }
+
+        output << " - " << connection.getClockSync().toLog() << std::endl;
     });
 
     if (count == 0) {
@@ -154,6 +219,324 @@ void Shell::cmdGames(std::vector<std::string> arguments)
     output << std::endl;
 }
 
+void Shell::cmdTop(std::vector<std::string> arguments)
+{
+    std::string what = arguments.size() > 1 ? arguments[1] : "all";
+    size_t count = arguments.size() > 2 ? std::stoul(arguments[2]) : 10;
+    std::string key = arguments.size() > 3 ? arguments[3] : "";
+
+    if ((what != "all" && what != "connections" && what != "games") || arguments.size() > 4) {
+        throw UnknownCommandException("usage: top [connections|games] [N] [key]");
+    }
+
+    output << std::endl;
+    output << Text::hline(100) << std::endl;
+
+    if (what == "all" || what == "connections") {
+        topConnections(count, key.empty() ? "bytes" : key);
+    }
+
+    if (what == "all") {
+        output << std::endl;
+    }
+
+    if (what == "all" || what == "games") {
+        topGames(count, key.empty() ? "sends" : key);
+    }
+
+    output << Text::hline(100) << std::endl;
+    output << std::endl;
+}
+
+void Shell::topConnections(size_t count, const std::string &key)
+{
+    struct Row
+    {
+        Uid uid;
+        std::string nickname;
+        uint64_t bytesReceived;
+        uint64_t bytesSent;
+        uint64_t packetsReceived;
+        uint64_t packetsSent;
+        size_t queue;
+        Timestamp rtt;
+        uint64_t corrupted;
+        int64_t idle;
+    };
+
+    std::function<uint64_t(const Row &)> weight;
+
+    if (key == "bytes") {
+        weight = [](const Row &row) { return row.bytesReceived + row.bytesSent; };
+    } else if (key == "packets") {
+        weight = [](const Row &row) { return row.packetsReceived + row.packetsSent; };
+    } else if (key == "queue") {
+        weight = [](const Row &row) { return row.queue; };
+    } else if (key == "rtt") {
+        weight = [](const Row &row) { return static_cast<uint64_t>(row.rtt); };
+    } else if (key == "corrupted") {
+        weight = [](const Row &row) { return row.corrupted; };
+    } else if (key == "idle") {
+        weight = [](const Row &row) { return static_cast<uint64_t>(row.idle); };
+    } else {
+        throw UnknownCommandException("connections can be sorted by bytes, packets, queue, rtt, corrupted or idle");
+    }
+
+    std::vector<Row> rows;
+
+    app.forEachConnection([this, &rows](Connection &connection) {
+        Row row{
+            connection.getUid(),
+            "[not logged]",
+            connection.getBytesReceived(),
+            connection.getBytesSent(),
+            connection.getPacketsReceived(),
+            connection.getPacketsSent(),
+            connection.getSendQueueDepth(),
+            connection.getClockSync().getRttPercentile(0.5),
+            connection.getCorruptedCount(),
+            connection.getInactiveFor().count()};
+
+        try {
+            row.nickname = app.getNickname(row.uid);
+        }
+        catch (NoNicknameException &exception) {
+            // keeps the placeholder
+        }
+
+        rows.push_back(row);
+    });
+
+    // only the heaviest are sorted
+    size_t shown = std::min(count, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(), [&weight](const Row &a, const Row &b) {
+        return weight(a) > weight(b);
+    });
+
+    output << "Connections by " << key << " (" << shown << " of " << rows.size() << "):" << std::endl << std::endl;
+    output << Text::justifyL("uid", 8) << Text::justifyL("nickname", 16)
+           << Text::justifyL("bytes in", 12) << Text::justifyL("bytes out", 12)
+           << Text::justifyL("pkts in", 10) << Text::justifyL("pkts out", 10)
+           << Text::justifyL("queue", 8) << Text::justifyL("rtt ms", 8)
+           << Text::justifyL("corrupt", 9) << "idle ms" << std::endl;
+
+    for (size_t i = 0; i < shown; ++i) {
+        const Row &row = rows[i];
+
+        output << Text::justifyL(std::to_string(row.uid), 8) << Text::justifyL(row.nickname, 16)
+               << Text::justifyL(std::to_string(row.bytesReceived), 12)
+               << Text::justifyL(std::to_string(row.bytesSent), 12)
+               << Text::justifyL(std::to_string(row.packetsReceived), 10)
+               << Text::justifyL(std::to_string(row.packetsSent), 10)
+               << Text::justifyL(std::to_string(row.queue), 8)
+               << Text::justifyL(std::to_string(row.rtt), 8)
+               << Text::justifyL(std::to_string(row.corrupted), 9)
+               << row.idle << std::endl;
+    }
+
+    if (rows.empty()) {
+        output << "- no players active -" << std::endl;
+    }
+}
+
+void Shell::topGames(size_t count, const std::string &key)
+{
+    struct Row
+    {
+        Uid uid;
+        Uid playerLeft;
+        Uid playerRight;
+        uint64_t rallies;
+        double updateRate;
+        double sendRate;
+        int64_t meanLateness;
+        int64_t maxLateness;
+    };
+
+    std::function<double(const Row &)> weight;
+
+    if (key == "sends") {
+        weight = [](const Row &row) { return row.sendRate; };
+    } else if (key == "updates") {
+        weight = [](const Row &row) { return row.updateRate; };
+    } else if (key == "rallies") {
+        weight = [](const Row &row) { return static_cast<double>(row.rallies); };
+    } else if (key == "lateness") {
+        weight = [](const Row &row) { return static_cast<double>(row.maxLateness); };
+    } else {
+        throw UnknownCommandException("games can be sorted by sends, updates, rallies or lateness");
+    }
+
+    std::vector<Row> rows;
+
+    app.forEachGame([&rows](Game &game) {
+        rows.push_back(Row{
+            game.getUid(),
+            game.getPlayerUid(Side::Left),
+            game.getPlayerUid(Side::Right),
+            game.getRalliesCount(),
+            game.getUpdateRate(),
+            game.getSendRate(),
+            game.getMeanLateness(),
+            game.getMaxLateness()});
+    });
+
+    size_t shown = std::min(count, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(), [&weight](const Row &a, const Row &b) {
+        return weight(a) > weight(b);
+    });
+
+    output << "Games by " << key << " (" << shown << " of " << rows.size() << "):" << std::endl << std::endl;
+    output << Text::justifyL("uid", 8) << Text::justifyL("players", 14)
+           << Text::justifyL("rallies", 10) << Text::justifyL("updates/s", 12)
+           << Text::justifyL("sends/s", 12) << Text::justifyL("late avg us", 14)
+           << "late max us" << std::endl;
+
+    for (size_t i = 0; i < shown; ++i) {
+        const Row &row = rows[i];
+
+        output << Text::justifyL(std::to_string(row.uid), 8)
+               << Text::justifyL(std::to_string(row.playerLeft) + " vs " + std::to_string(row.playerRight), 14)
+               << Text::justifyL(std::to_string(row.rallies), 10)
+               << Text::justifyL(std::to_string(row.updateRate), 12)
+               << Text::justifyL(std::to_string(row.sendRate), 12)
+               << Text::justifyL(std::to_string(row.meanLateness), 14)
+               << row.maxLateness << std::endl;
+    }
+
+    if (rows.empty()) {
+        output << "- no games active -" << std::endl;
+    }
+}
+
+void Shell::cmdTrace(std::vector<std::string> arguments)
+{
+    Tracer &tracer = app.getTracer();
+
+    if (arguments.size() == 2 && (arguments[1] == "on" || arguments[1] == "off")) {
+        tracer.setEnabled(arguments[1] == "on");
+    }
+    else if ((arguments.size() == 3 || arguments.size() == 4) && arguments[1] == "dump") {
+        int64_t window = arguments.size() == 4 ? std::stoll(arguments[3]) * 1000 : 0;
+        std::ofstream file{arguments[2]};
+
+        if (!file) {
+            throw UnknownCommandException("can not open file " + arguments[2] + " for writing");
+        }
+
+        size_t count = tracer.dump(file, window);
+        output << count << " spans written to " << arguments[2] << std::endl;
+        return;
+    }
+    else if (arguments.size() != 1) {
+        throw UnknownCommandException("usage: trace [on|off] [dump <file> [milliseconds]]");
+    }
+
+    output << "tracing " << (tracer.isEnabled() ? "on" : "off") << std::endl;
+}
+
+void Shell::cmdLocks(std::vector<std::string> arguments)
+{
+    size_t count = arguments.size() > 1 ? std::stoul(arguments[1]) : 10;
+    std::string key = arguments.size() > 2 ? arguments[2] : "wait";
+
+    if (arguments.size() > 3) {
+        throw UnknownCommandException("usage: locks [N] [wait|contended|hold]");
+    }
+
+    std::function<int64_t(const LockProfiler::Report &)> weight;
+
+    if (key == "wait") {
+        weight = [](const LockProfiler::Report &report) { return report.waitSum; };
+    } else if (key == "contended") {
+        weight = [](const LockProfiler::Report &report) { return static_cast<int64_t>(report.contended); };
+    } else if (key == "hold") {
+        weight = [](const LockProfiler::Report &report) { return report.holdSum; };
+    } else {
+        throw UnknownCommandException("locks can be sorted by wait, contended or hold");
+    }
+
+    if (!LockProfiler::isEnabled()) {
+        output << "lock profiling is not compiled in, configure with -DUPS_LOCK_PROFILING=ON" << std::endl;
+        return;
+    }
+
+    std::vector<LockProfiler::Report> reports = LockProfiler::report();
+
+    size_t shown = std::min(count, reports.size());
+    std::partial_sort(reports.begin(), reports.begin() + shown, reports.end(),
+                      [&weight](const LockProfiler::Report &a, const LockProfiler::Report &b) {
+                          return weight(a) > weight(b);
+                      });
+
+    output << std::endl;
+    output << Text::hline(130) << std::endl;
+    output << "Locks by " << key << " (" << shown << " of " << reports.size() << "):" << std::endl << std::endl;
+    output << Text::justifyL("lock", 32) << Text::justifyL("site", 26)
+           << Text::justifyL("acquired", 12) << Text::justifyL("contended", 12)
+           << Text::justifyL("wait us", 12) << Text::justifyL("wait p99 ns", 13)
+           << Text::justifyL("hold us", 12) << "hold p99 ns" << std::endl;
+
+    for (size_t i = 0; i < shown; ++i) {
+        const LockProfiler::Report &report = reports[i];
+
+        output << Text::justifyL(report.lock, 32)
+               << Text::justifyL(report.site, 26)
+               << Text::justifyL(std::to_string(report.acquisitions), 12)
+               << Text::justifyL(std::to_string(report.contended), 12)
+               << Text::justifyL(std::to_string(report.waitSum / 1000), 12)
+               << Text::justifyL(std::to_string(report.waitP99), 13)
+               << Text::justifyL(std::to_string(report.holdSum / 1000), 12)
+               << report.holdP99 << std::endl;
+    }
+
+    output << Text::hline(130) << std::endl;
+    output << std::endl;
+}
+
+void Shell::cmdProfile(std::vector<std::string> arguments)
+{
+    Profiler &profiler = app.getProfiler();
+
+    if (arguments.size() >= 2 && arguments.size() <= 3 && arguments[1] == "start") {
+        profiler.setFrequency(arguments.size() == 3 ? std::stoul(arguments[2]) : Profiler::DEFAULT_FREQUENCY);
+
+        if (!profiler.start()) {
+            throw UnknownCommandException("the profiler is already running");
+        }
+
+        output << "profiling at " << profiler.getFrequency() << " Hz" << std::endl;
+    }
+    else if (arguments.size() == 3 && arguments[1] == "stop") {
+        std::ofstream file{arguments[2]};
+
+        if (!file) {
+            throw UnknownCommandException("can not open file " + arguments[2] + " for writing");
+        }
+
+        if (!profiler.stop(true)) {
+            throw UnknownCommandException("the profiler is not running");
+        }
+
+        profiler.writeCollapsed(file);
+
+        output << std::endl;
+        output << Text::hline() << std::endl;
+        output << "Profile: " << profiler.getSamplesCount() << " samples written to " << arguments[2];
+        output << ", " << profiler.getSamplesDropped() << " dropped" << std::endl << std::endl;
+
+        for (auto &function : profiler.getHottest(10)) {
+            output << Text::justifyL(std::to_string(function.second), 10) << function.first << std::endl;
+        }
+
+        output << Text::hline() << std::endl;
+        output << std::endl;
+    }
+    else {
+        throw UnknownCommandException("usage: profile start [hz] | profile stop <file>");
+    }
+}
+
 void Shell::cmdExit(std::vector<std::string> arguments)
 {
     stop(false);
@@ -23,6 +23,11 @@ class Shell: public Thread
         {"players", &Shell::cmdPlayers},
         {"info", &Shell::cmdInfo},
         {"stats", &Shell::cmdStats},
+        {"capture", &Shell::cmdCapture},
+        {"top", &Shell::cmdTop},
+        {"trace", &Shell::cmdTrace},
+        {"locks", &Shell::cmdLocks},
+        {"profile", &Shell::cmdProfile},
         {"help", &Shell::cmdHelp},
     };
 
@@ -31,8 +36,15 @@ class Shell: public Thread
     void cmdHelp(std::vector<std::string> arguments);
     void cmdInfo(std::vector<std::string> arguments);
     void cmdStats(std::vector<std::string> arguments);
+    void cmdCapture(std::vector<std::string> arguments);
     void cmdPlayers(std::vector<std::string> arguments);
     void cmdGames(std::vector<std::string> arguments);
+    void cmdTop(std::vector<std::string> arguments);
+    void topConnections(size_t count, const std::string &key);
+    void topGames(size_t count, const std::string &key);
+    void cmdTrace(std::vector<std::string> arguments);
+    void cmdLocks(std::vector<std::string> arguments);
+    void cmdProfile(std::vector<std::string> arguments);
     void cmdExit(std::vector<std::string> arguments);
 
 public:
@@ -1,15 +1,13 @@
 #include <sstream>
+#include <utility>
 
 #include "Stats.h"
 
 Stats::Stats()
     : started(std::chrono::system_clock::now()),
-      messagesReceived{0},
-      messagesDropped{0},
-      bytesReceived{0},
-      bytesDropped{0},
-      messagesSent{0},
-      bytesSent{0}
+      connectionsCount{0},
+      gamesCount{0},
+      playersWaiting{0}
 {}
 
 void Stats::setStarted(std::chrono::system_clock::time_point started)
@@ -20,38 +18,92 @@ void Stats::setStarted(std::chrono::system_clock::time_point started)
 
 void Stats::addPacketsReceived(uint64_t count)
 {
-    auto lock = acquireLock();
-    messagesReceived += count;
+    counters.add(MessagesReceived, count);
 }
 
 void Stats::addPacketsDropped(uint64_t count)
 {
-    auto lock = acquireLock();
-    messagesDropped += count;
+    counters.add(MessagesDropped, count);
+}
+
+void Stats::addPacketsSuperseded(uint64_t count)
+{
+    counters.add(MessagesSuperseded, count);
 }
 
 void Stats::addBytesReceived(uint64_t count)
 {
-    auto lock = acquireLock();
-    bytesReceived += count;
+    counters.add(BytesReceived, count);
 }
 
 void Stats::addBytesDropped(uint64_t count)
 {
-    auto lock = acquireLock();
-    bytesDropped += count;
+    counters.add(BytesDropped, count);
 }
 
 void Stats::addPacketsSent(uint64_t count)
 {
-    auto lock = acquireLock();
-    messagesSent += count;
+    counters.add(MessagesSent, count);
 }
 
 void Stats::addBytesSent(uint64_t count)
+{
+    counters.add(BytesSent, count);
+}
+
+void Stats::addSpectatorFramesSkipped(uint64_t count)
+{
+    counters.add(SpectatorFramesSkipped, count);
+}
+
+void Stats::addSpectatorsDropped(uint64_t count)
+{
+    counters.add(SpectatorsDropped, count);
+}
+
+void Stats::recordResolutionLateness(int64_t micros)
+{
+    resolutionLateness.record(micros);
+}
+
+void Stats::recordSendTime(int64_t micros)
+{
+    sendTime.record(micros);
+}
+
+void Stats::recordHandlingTime(uint8_t type, int64_t micros)
+{
+    handlingTime.record(micros);
+    handlingTimeByType[type < handlingTimeByType.size() ? type : PacketCapture::OTHER_TYPE].record(micros);
+}
+
+void Stats::setConnectionsCount(uint64_t count)
+{
+    connectionsCount = count;
+}
+
+void Stats::setGamesCount(uint64_t count)
+{
+    gamesCount = count;
+}
+
+void Stats::setPlayersWaiting(uint64_t count)
+{
+    playersWaiting = count;
+}
+
+void Stats::setGameRates(std::vector<GameRates> rates)
 {
     auto lock = acquireLock();
-    bytesSent += count;
+    gameRates = std::move(rates);
+}
+
+std::string Stats::histogramToLog(const ShardedHistogram &histogram)
+{
+    Histogram merged;
+    histogram.mergeInto(merged);
+
+    return merged.toLog("us");
 }
 
 std::string Stats::toLog() const
@@ -70,14 +122,121 @@ std::string Stats::toLog() const
            << std::chrono::duration_cast<std::chrono::minutes>(upTime).count() << " minutes "
            << std::chrono::duration_cast<std::chrono::seconds>(upTime).count() << " seconds"
            << std::endl;
-    stream << "Bytes received: " << bytesReceived + bytesDropped << std::endl;
-    stream << "Packets received: " << messagesReceived + messagesDropped << std::endl;
+    stream << "Connections: " << connectionsCount << std::endl;
+    stream << "Games: " << gamesCount << std::endl;
+    stream << "Players waiting: " << playersWaiting << std::endl;
+    stream << std::endl;
+    stream << "Bytes received: " << counters.get(BytesReceived) + counters.get(BytesDropped) << std::endl;
+    stream << "Packets received: "
+           << counters.get(MessagesReceived) + counters.get(MessagesDropped) + counters.get(MessagesSuperseded)
+           << std::endl;
+    stream << std::endl;
+    stream << "Bytes sent: " << counters.get(BytesSent) << std::endl;
+    stream << "Packets sent: " << counters.get(MessagesSent) << std::endl;
     stream << std::endl;
-    stream << "Bytes sent: " << bytesSent << std::endl;
-    stream << "Packets sent: " << messagesSent << std::endl;
+    stream << "Packets dropped: " << counters.get(BytesDropped) << std::endl;
+    stream << "Bytes dropped: " << counters.get(MessagesDropped) << std::endl;
+    stream << "Packets superseded: " << counters.get(MessagesSuperseded) << std::endl;
     stream << std::endl;
-    stream << "Packets dropped: " << bytesDropped << std::endl;
-    stream << "Bytes dropped: " << messagesDropped;
+    stream << "Spectator frames skipped: " << counters.get(SpectatorFramesSkipped) << std::endl;
+    stream << "Spectators dropped: " << counters.get(SpectatorsDropped) << std::endl;
+    stream << std::endl;
+    stream << "Ball resolution lateness: " << histogramToLog(resolutionLateness) << std::endl;
+    stream << "Send time: " << histogramToLog(sendTime) << std::endl;
+    stream << "Handling time: " << histogramToLog(handlingTime);
+
+    for (size_t i = 0; i < handlingTimeByType.size(); ++i) {
+        if (!handlingTimeByType[i].isEmpty()) {
+            stream << std::endl << "  " << PacketCapture::typeName(static_cast<uint8_t>(i)) << ": "
+                   << histogramToLog(handlingTimeByType[i]);
+        }
+    }
+
+    if (!gameRates.empty()) {
+        stream << std::endl << std::endl << "Game rates:";
+
+        for (auto &rates : gameRates) {
+            stream << std::endl << "  " << rates.game << ": " << rates.sendRate << " packets/s sent, "
+                   << rates.updateRate << " updates/s";
+        }
+    }
+
+    return stream.str();
+}
+
+void Stats::histogramToPrometheus(std::ostream &stream,
+                                  const std::string &name,
+                                  const std::string &labels,
+                                  const ShardedHistogram &histogram)
+{
+    Histogram merged;
+    histogram.mergeInto(merged);
+
+    std::string separator = labels.empty() ? "" : ",";
+
+    // power of two buckets, the values are whole microseconds, so below 2^k is at most 2^k - 1
+    for (int k = 0; k <= 24; ++k) {
+        int64_t bound = int64_t{1} << k;
+        stream << name << "_bucket{" << labels << separator << "le=\"" << bound - 1 << "\"} "
+               << merged.getCountBelow(bound) << "\n";
+    }
+
+    stream << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << merged.getCount() << "\n";
+    stream << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << merged.getSum() << "\n";
+    stream << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << merged.getCount() << "\n";
+}
+
+std::vector<Stats::Metric> Stats::getMetrics() const
+{
+    return {
+        {"ups_packets_received_total", "Packets received and handled.", false, counters.get(MessagesReceived)},
+        {"ups_packets_dropped_total", "Received packets which could not be handled.", false,
+         counters.get(MessagesDropped)},
+        {"ups_packets_superseded_total", "Received states replaced by a newer one of the same batch.", false,
+         counters.get(MessagesSuperseded)},
+        {"ups_bytes_received_total", "Bytes received.", false, counters.get(BytesReceived)},
+        {"ups_bytes_dropped_total", "Received bytes thrown away as corrupted.", false, counters.get(BytesDropped)},
+        {"ups_packets_sent_total", "Packets sent.", false, counters.get(MessagesSent)},
+        {"ups_bytes_sent_total", "Bytes sent.", false, counters.get(BytesSent)},
+        {"ups_spectator_frames_skipped_total", "Frames skipped for lagging spectators.", false,
+         counters.get(SpectatorFramesSkipped)},
+        {"ups_spectators_dropped_total", "Spectators disconnected for being too slow.", false,
+         counters.get(SpectatorsDropped)},
+        {"ups_connections", "Open connections of players and spectators.", true, connectionsCount},
+        {"ups_games", "Games in progress or waiting for a player.", true, gamesCount},
+        {"ups_players_waiting", "Players waiting for an opponent.", true, playersWaiting}
+    };
+}
+
+std::string Stats::toPrometheus() const
+{
+    // only atomics are read, a scrape never waits for the recording threads
+    std::stringstream stream;
+
+    auto histogram = [&stream](const std::string &name, const std::string &help) {
+        stream << "# HELP " << name << " " << help << "\n";
+        stream << "# TYPE " << name << " histogram\n";
+    };
+
+    for (auto &metric : getMetrics()) {
+        stream << "# HELP " << metric.name << " " << metric.help << "\n";
+        stream << "# TYPE " << metric.name << (metric.gauge ? " gauge\n" : " counter\n");
+        stream << metric.name << " " << metric.value << "\n";
+    }
+
+    histogram("ups_resolution_lateness_microseconds", "Delay of the ball resolutions after their intended time.");
+    histogramToPrometheus(stream, "ups_resolution_lateness_microseconds", "", resolutionLateness);
+
+    histogram("ups_send_time_microseconds", "Time spent in blocking sends.");
+    histogramToPrometheus(stream, "ups_send_time_microseconds", "", sendTime);
+
+    histogram("ups_handling_time_microseconds", "Time spent handling an incoming packet, by packet type.");
+    for (size_t i = 0; i < handlingTimeByType.size(); ++i) {
+        if (!handlingTimeByType[i].isEmpty()) {
+            std::string labels = "type=\"" + PacketCapture::typeName(static_cast<uint8_t>(i)) + "\"";
+            histogramToPrometheus(stream, "ups_handling_time_microseconds", labels, handlingTimeByType[i]);
+        }
+    }
 
     return stream.str();
 }
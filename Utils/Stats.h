@@ -2,18 +2,69 @@
 
 #include <string>
 #include <chrono>
+#include <vector>
 
 #include "Lockable.h"
+#include "Histogram.h"
+#include "ShardedCounters.h"
+#include "ShardedHistogram.h"
+#include "../Types.h"
+#include "../Network/PacketCapture.h"
 
+/**
+ * The counters are sharded per thread and summed only when the stats are read,
+ * the lock guards just the start time and the rates of the games. The latency histograms are sharded the same way.
+ */
 class Stats: public Lockable
 {
+public:
+    struct Metric
+    {
+        const char *name;
+        const char *help;
+        bool gauge;
+        uint64_t value;
+    };
+
+    // the games own their rates, the app copies them in before the stats are written
+    struct GameRates
+    {
+        Uid game;
+        double sendRate;
+        double updateRate;
+    };
+
+private:
+    enum Counter
+    {
+        MessagesReceived,
+        MessagesDropped,
+        MessagesSuperseded,
+        BytesReceived,
+        BytesDropped,
+        MessagesSent,
+        BytesSent,
+        SpectatorFramesSkipped,
+        SpectatorsDropped,
+        COUNTERS_COUNT
+    };
+
     std::chrono::system_clock::time_point started;
-    uint64_t messagesReceived;
-    uint64_t messagesDropped;
-    uint64_t bytesReceived;
-    uint64_t bytesDropped;
-    uint64_t messagesSent;
-    uint64_t bytesSent;
+    ShardedCounters<COUNTERS_COUNT> counters;
+    std::atomic<uint64_t> connectionsCount;
+    std::atomic<uint64_t> gamesCount;
+    std::atomic<uint64_t> playersWaiting;
+    ShardedHistogram resolutionLateness;
+    ShardedHistogram sendTime;
+    ShardedHistogram handlingTime;
+    std::array<ShardedHistogram, PacketCapture::MAX_TYPES> handlingTimeByType;
+    std::vector<GameRates> gameRates;
+
+    static std::string histogramToLog(const ShardedHistogram &histogram);
+    static void histogramToPrometheus(std::ostream &stream,
+                                      const std::string &name,
+                                      const std::string &labels,
+                                      const ShardedHistogram &histogram);
 
 public:
     Stats();
@@ -21,12 +72,27 @@ public:
     void setStarted(std::chrono::system_clock::time_point started);
     void addPacketsReceived(uint64_t count);
     void addPacketsDropped(uint64_t count);
+    void addPacketsSuperseded(uint64_t count);
     void addBytesReceived(uint64_t count);
     void addBytesDropped(uint64_t count);
     void addPacketsSent(uint64_t count);
     void addBytesSent(uint64_t count);
+    void addSpectatorFramesSkipped(uint64_t count);
+    void addSpectatorsDropped(uint64_t count);
+    void recordResolutionLateness(int64_t micros);
+    void recordSendTime(int64_t micros);
+    void recordHandlingTime(uint8_t type, int64_t micros);
+
+    void setConnectionsCount(uint64_t count);
+    void setGamesCount(uint64_t count);
+    void setPlayersWaiting(uint64_t count);
+    void setGameRates(std::vector<GameRates> rates);
+
+    // counters and gauges, read without locking
+    std::vector<Metric> getMetrics() const;
 
     std::string toLog() const;
+    std::string toPrometheus() const;
 };
 
 
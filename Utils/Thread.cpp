@@ -19,7 +19,7 @@ void Thread::execute()
 
 bool Thread::start()
 {
-    Lock lock = Lock{joinMutex};
+    std::unique_lock<std::mutex> lock{joinMutex};
 
     if (thread.joinable()) {
         return false;
@@ -28,6 +28,9 @@ bool Thread::start()
     stopCondition = false;
 
     before();
+
+    // running from now on, not only once the thread gets scheduled, a started thread must not look finished
+    running = true;
     thread = std::thread(&Thread::execute, this);
 
     return true;
@@ -63,7 +66,7 @@ void Thread::finally()
 
 bool Thread::join()
 {
-    Lock lock = Lock{joinMutex};
+    std::unique_lock<std::mutex> lock{joinMutex};
 
     if (!thread.joinable()) {
         return false;
@@ -76,7 +79,7 @@ bool Thread::join()
 
 bool Thread::detach()
 {
-    Lock lock = Lock{joinMutex};
+    std::unique_lock<std::mutex> lock{joinMutex};
 
     if (!thread.joinable()) {
         return false;
@@ -0,0 +1,113 @@
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <cerrno>
+
+#include "Timer.h"
+#include "../Exceptions.h"
+
+Timer::Timer(std::chrono::microseconds slack)
+    : timerFd{-1},
+      eventFd{-1},
+      wakePending{false},
+      slack{slack}
+{}
+
+Timer::~Timer()
+{
+    if (timerFd != -1) {
+        ::close(timerFd);
+        ::close(eventFd);
+    }
+}
+
+void Timer::open()
+{
+    if (timerFd != -1) {
+        return;
+    }
+
+    timerFd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (timerFd == -1) {
+        throw TimerException("can not create a timer: " + std::string{std::strerror(errno)});
+    }
+
+    int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (fd == -1) {
+        ::close(timerFd);
+        timerFd = -1;
+        throw TimerException("can not create a timer event: " + std::string{std::strerror(errno)});
+    }
+
+    eventFd = fd;
+
+    // a wake() that saw no descriptor yet is delivered now
+    if (wakePending.exchange(false)) {
+        uint64_t value{1};
+        ::write(fd, &value, sizeof(value));
+    }
+}
+
+bool Timer::waitFor(std::chrono::microseconds delay)
+{
+    open();
+
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t deadline = static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+    deadline += std::max<int64_t>(1, delay.count());
+
+    if (slack.count() > 0) {
+        deadline = (deadline + slack.count() - 1) / slack.count() * slack.count();
+    }
+
+    itimerspec spec{};
+    spec.it_value.tv_sec = deadline / 1000000;
+    spec.it_value.tv_nsec = (deadline % 1000000) * 1000;
+
+    if (::timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        throw TimerException("can not arm the timer: " + std::string{std::strerror(errno)});
+    }
+
+    pollfd fds[2]{{timerFd, POLLIN, 0}, {eventFd, POLLIN, 0}};
+
+    while (::poll(fds, 2, -1) == -1) {
+        if (errno != EINTR) {
+            throw TimerException("can not wait for the timer: " + std::string{std::strerror(errno)});
+        }
+    }
+
+    uint64_t value;
+    bool woken{false};
+
+    if (fds[1].revents & POLLIN) {
+        woken = ::read(eventFd, &value, sizeof(value)) == sizeof(value);
+    }
+
+    if (fds[0].revents & POLLIN) {
+        ::read(timerFd, &value, sizeof(value));
+    }
+
+    return woken;
+}
+
+void Timer::wake()
+{
+    // latched first, the descriptors may be opened meanwhile
+    wakePending = true;
+
+    int fd = eventFd;
+
+    if (fd == -1) {
+        return;
+    }
+
+    uint64_t value{1};
+    ::write(fd, &value, sizeof(value));
+}
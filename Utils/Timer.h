@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * High resolution timer on timerfd (CLOCK_MONOTONIC) with an eventfd for early wake ups.
+ * A wake() is never lost: when it comes before the wait, the following wait returns immediately.
+ * The descriptors are opened on demand, so that an unused timer costs nothing,
+ * a wake() before that is latched and delivered once they are open.
+ * With a non-zero slack the deadlines are rounded up to its multiples,
+ * so that timers of many threads expire together.
+ */
+class Timer
+{
+    int timerFd;
+    std::atomic<int> eventFd;
+    std::atomic<bool> wakePending;
+    std::chrono::microseconds slack;
+
+public:
+    explicit Timer(std::chrono::microseconds slack = std::chrono::microseconds{0});
+    Timer(const Timer &timer) = delete;
+    virtual ~Timer();
+
+    void open();
+    bool waitFor(std::chrono::microseconds delay);
+    void wake();
+};
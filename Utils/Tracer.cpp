@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Tracer.h"
+#include "../Exceptions.h"
+
+const size_t Tracer::DEFAULT_RING_CAPACITY;
+const size_t Tracer::CLOSED_RINGS_KEPT;
+
+std::atomic<uint64_t> Tracer::lastTracerId{0};
+thread_local Tracer::ThreadRing Tracer::threadRing;
+thread_local uint64_t Tracer::threadTrace{0};
+
+Tracer::Context::Context(uint64_t trace)
+    : previous{threadTrace}
+{
+    threadTrace = trace;
+}
+
+Tracer::Context::~Context()
+{
+    threadTrace = previous;
+}
+
+Tracer::Ring::Ring(size_t capacity, int tid)
+    : spans(capacity),
+      mask{capacity - 1},
+      tid{tid}
+{}
+
+Tracer::ThreadRing::~ThreadRing()
+{
+    // the spans of a finished thread stay dumpable until the ring is pruned
+    if (ring) {
+        ring->closed = true;
+    }
+}
+
+Tracer::Tracer(size_t ringCapacity)
+    : id{++lastTracerId},
+      ringCapacity{ringCapacity},
+      enabled{false},
+      lastTrace{0}
+{
+    if (ringCapacity == 0 || (ringCapacity & (ringCapacity - 1)) != 0) {
+        throw TracerException("ring capacity must be a power of two");
+    }
+}
+
+int64_t Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Tracer::currentTrace()
+{
+    return threadTrace;
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::newTrace()
+{
+    if (!isEnabled()) {
+        return 0;
+    }
+
+    return lastTrace.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+Tracer::Ring &Tracer::getRing()
+{
+    if (threadRing.tracerId != id) {
+        auto ring = std::make_shared<Ring>(ringCapacity, static_cast<int>(::syscall(SYS_gettid)));
+
+        {
+            std::lock_guard<std::mutex> lock{ringsMutex};
+
+            // a connection thread per client, keep only the most recent of the finished ones
+            size_t closed = std::count_if(rings.begin(), rings.end(), [](const std::shared_ptr<Ring> &ring) {
+                return ring->closed.load();
+            });
+
+            for (auto i = rings.begin(); i != rings.end() && closed >= CLOSED_RINGS_KEPT;) {
+                if ((*i)->closed) {
+                    i = rings.erase(i);
+                    --closed;
+                }
+                else {
+                    ++i;
+                }
+            }
+
+            rings.push_back(ring);
+        }
+
+        if (threadRing.ring) {
+            threadRing.ring->closed = true;
+        }
+
+        threadRing.tracerId = id;
+        threadRing.ring = ring;
+    }
+
+    return *threadRing.ring;
+}
+
+void Tracer::record(const Span &span)
+{
+    Ring &ring = getRing();
+
+    // single writer, the oldest span is overwritten
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.spans[head & ring.mask] = span;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+size_t Tracer::dump(std::ostream &stream, int64_t windowMicros)
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    {
+        std::lock_guard<std::mutex> lock{ringsMutex};
+        rings = this->rings;
+    }
+
+    struct Event
+    {
+        Span span;
+        int tid;
+    };
+
+    std::vector<Event> events;
+    int64_t from = windowMicros > 0 ? now() - windowMicros : 0;
+
+    for (auto &ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ring->spans.size() ? head - ring->spans.size() : 0;
+        std::vector<Span> spans;
+
+        for (uint64_t i = begin; i < head; ++i) {
+            spans.push_back(ring->spans[i & ring->mask]);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // the spans the writer overwrote meanwhile may be torn, the slot of the head is being written
+        uint64_t written = ring->head.load(std::memory_order_relaxed);
+        uint64_t valid = written >= ring->spans.size() ? written - ring->spans.size() + 1 : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < head; ++i) {
+            const Span &span = spans[i - begin];
+
+            if (span.start + span.duration >= from) {
+                events.push_back({span, ring->tid});
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+        return a.span.start < b.span.start;
+    });
+
+    int pid = ::getpid();
+    bool first = true;
+
+    auto separate = [&stream, &first]() {
+        stream << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (auto &event : events) {
+        separate();
+        stream << "{\"name\":\"" << event.span.name << "\",\"cat\":\"ups\",\"ph\":\"X\""
+               << ",\"ts\":" << event.span.start
+               << ",\"dur\":" << event.span.duration
+               << ",\"pid\":" << pid
+               << ",\"tid\":" << event.tid
+               << ",\"args\":{\"trace\":" << event.span.trace
+               << ",\"uid\":" << event.span.uid
+               << ",\"packet\":" << static_cast<int>(event.span.packetType) << "}}";
+    }
+
+    // flow arrows link the spans of a packet across the threads, from its receipt to the sends it caused
+    std::map<uint64_t, std::vector<const Event *>> traces;
+
+    for (auto &event : events) {
+        if (event.span.trace) {
+            traces[event.span.trace].push_back(&event);
+        }
+    }
+
+    for (auto &trace : traces) {
+        auto &flow = trace.second;
+
+        for (size_t i = 0; flow.size() > 1 && i < flow.size(); ++i) {
+            const char *phase = i == 0 ? "s" : i + 1 == flow.size() ? "f" : "t";
+
+            separate();
+            stream << "{\"name\":\"packet\",\"cat\":\"ups\",\"ph\":\"" << phase << "\""
+                   << ",\"id\":" << trace.first
+                   << ",\"ts\":" << flow[i]->span.start
+                   << ",\"pid\":" << pid
+                   << ",\"tid\":" << flow[i]->tid
+                   << (i == 0 ? "" : ",\"bp\":\"e\"") << "}";
+        }
+    }
+
+    stream << "\n]}\n";
+
+    return events.size();
+}
+
+TraceSpan::TraceSpan(Tracer &tracer, const char *name, Uid uid, uint8_t packetType)
+    : tracer(tracer),
+      span{name, Tracer::currentTrace(), 0, 0, uid, packetType},
+      active{tracer.isEnabled()}
+{
+    if (active) {
+        span.start = Tracer::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (active) {
+        span.duration = Tracer::now() - span.start;
+        tracer.record(span);
+    }
+}
+
+void TraceSpan::setTrace(uint64_t trace)
+{
+    span.trace = trace;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "../Types.h"
+
+/**
+ * Opt-in tracing of the packet lifecycle. Every received packet gets a trace id, the spans of its parsing,
+ * handling, game events and of the sends it causes are recorded with that id into rings of the threads
+ * (flight recorder, the oldest spans are overwritten) and dumped as Chrome / Perfetto trace JSON.
+ * While disabled a span costs one relaxed load.
+ */
+class Tracer
+{
+public:
+    static const size_t DEFAULT_RING_CAPACITY{1024};
+    static const size_t CLOSED_RINGS_KEPT{64};
+
+    struct Span
+    {
+        // names are string literals
+        const char *name;
+        uint64_t trace;
+        int64_t start;
+        int64_t duration;
+        Uid uid;
+        uint8_t packetType;
+    };
+
+    /**
+     * Sets the trace of the calling thread for its lifetime, the packets created meanwhile carry it.
+     */
+    class Context
+    {
+        uint64_t previous;
+
+    public:
+        explicit Context(uint64_t trace);
+        Context(const Context &context) = delete;
+        ~Context();
+    };
+
+private:
+    struct Ring
+    {
+        std::vector<Span> spans;
+        size_t mask;
+        int tid;
+
+        std::atomic<uint64_t> head{0};
+        std::atomic<bool> closed{false};
+
+        Ring(size_t capacity, int tid);
+    };
+
+    struct ThreadRing
+    {
+        uint64_t tracerId{0};
+        std::shared_ptr<Ring> ring;
+
+        ~ThreadRing();
+    };
+
+    static std::atomic<uint64_t> lastTracerId;
+    static thread_local ThreadRing threadRing;
+    static thread_local uint64_t threadTrace;
+
+    const uint64_t id;
+    const size_t ringCapacity;
+
+    std::atomic<bool> enabled;
+    std::atomic<uint64_t> lastTrace;
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    Ring &getRing();
+
+public:
+    explicit Tracer(size_t ringCapacity = DEFAULT_RING_CAPACITY);
+    Tracer(const Tracer &tracer) = delete;
+
+    static int64_t now();
+    static uint64_t currentTrace();
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled);
+
+    // zero while disabled, so that nothing downstream is traced
+    uint64_t newTrace();
+
+    void record(const Span &span);
+
+    // spans which ended within the window, zero takes everything still in the rings
+    size_t dump(std::ostream &stream, int64_t windowMicros);
+};
+
+/**
+ * Records a span from its construction to its destruction, nothing when the tracer is disabled.
+ */
+class TraceSpan
+{
+    Tracer &tracer;
+    Tracer::Span span;
+    bool active;
+
+public:
+    TraceSpan(Tracer &tracer, const char *name, Uid uid = -1, uint8_t packetType = 0);
+    TraceSpan(const TraceSpan &span) = delete;
+    ~TraceSpan();
+
+    void setTrace(uint64_t trace);
+};
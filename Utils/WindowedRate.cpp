@@ -0,0 +1,50 @@
+#include <algorithm>
+
+#include "WindowedRate.h"
+
+const size_t WindowedRate::SECONDS;
+const int WindowedRate::COUNT_BITS;
+const uint64_t WindowedRate::COUNT_MASK;
+const uint64_t WindowedRate::SECOND_MASK;
+
+WindowedRate::WindowedRate()
+{
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void WindowedRate::add(Timestamp now, uint64_t count)
+{
+    uint64_t second = static_cast<uint64_t>(now / 1000) & SECOND_MASK;
+    std::atomic<uint64_t> &bucket = buckets[second % SECONDS];
+
+    uint64_t current = bucket.load(std::memory_order_relaxed);
+    uint64_t next;
+
+    // a bucket left from an older second starts over
+    do {
+        uint64_t counted = (current >> COUNT_BITS) == second ? current & COUNT_MASK : 0;
+        next = (second << COUNT_BITS) | std::min(counted + count, COUNT_MASK);
+    } while (!bucket.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+double WindowedRate::get(Timestamp now, Timestamp since) const
+{
+    uint64_t second = static_cast<uint64_t>(now / 1000) & SECOND_MASK;
+    uint64_t sum{0};
+
+    for (auto &bucket : buckets) {
+        uint64_t value = bucket.load(std::memory_order_relaxed);
+
+        // the seconds wrap around in the packed word, the age is taken modulo as well
+        if (((second - (value >> COUNT_BITS)) & SECOND_MASK) < SECONDS) {
+            sum += value & COUNT_MASK;
+        }
+    }
+
+    Timestamp windowStart = (now / 1000 - static_cast<Timestamp>(SECONDS) + 1) * 1000;
+    Timestamp elapsed = std::max<Timestamp>(1, now - std::max(windowStart, since));
+
+    return sum * 1000.0 / elapsed;
+}
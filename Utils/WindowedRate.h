@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "../Game/GameTypes.h"
+
+/**
+ * Events per second over the last seconds, so that a spike shows up and fades instead of being averaged
+ * over the whole lifetime. Every second has its bucket, which packs the second and its count into one word,
+ * adding is a compare and swap and reading needs no lock.
+ */
+class WindowedRate
+{
+public:
+    static const size_t SECONDS{10};
+
+private:
+    static const int COUNT_BITS{40};
+    static const uint64_t COUNT_MASK{(uint64_t{1} << COUNT_BITS) - 1};
+    static const uint64_t SECOND_MASK{(uint64_t{1} << (64 - COUNT_BITS)) - 1};
+
+    std::array<std::atomic<uint64_t>, SECONDS> buckets;
+
+public:
+    WindowedRate();
+    WindowedRate(const WindowedRate &rate) = delete;
+
+    void add(Timestamp now, uint64_t count = 1);
+
+    // over the window, or since the given time when it started within the window
+    double get(Timestamp now, Timestamp since) const;
+};
@@ -17,12 +17,22 @@ bool isValidPort(unsigned long port)
     return port > 0 && port <= UINT16_MAX;
 }
 
+bool isValidMaxConnections(unsigned long count)
+{
+    return count > 0 && count <= 10000;
+}
+
+bool isValidRate(unsigned long rate)
+{
+    return rate > 0 && rate <= 1000;
+}
+
 void printHelp(char *name)
 {
     std::cout << "Pong game server with a simple built-in shell." << std::endl;
     std::cout << std::endl;
     std::cout << "Usage:" << std::endl;
-    std::cout << name << " [-t port] [-i ip_address]" << std::endl;
+    std::cout << name << " [-t port] [-i ip_address] [-c connections] [-r rate] [-R directory] [-m port] [-M name]" << std::endl;
     std::cout << std::endl;
     std::cout << "\t-t port" << std::endl;
     std::cout << "\t\tdefault = 8191" << std::endl;
@@ -32,6 +42,26 @@ void printHelp(char *name)
     std::cout << "\t\tdefault = 0.0.0.0" << std::endl;
     std::cout << "\t\tIPv4 address in the Internet standard dot notation." << std::endl;
     std::cout << std::endl;
+    std::cout << "\t-c connections" << std::endl;
+    std::cout << "\t\tdefault = 120" << std::endl;
+    std::cout << "\t\tMaximum number of connections of players and spectators, 1 - 10000." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-r rate" << std::endl;
+    std::cout << "\t\tdefault = 60" << std::endl;
+    std::cout << "\t\tGame state broadcast rate in frames per second, 1 - 1000." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-R directory" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tRecord a binary replay of every game into the directory." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-m port" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tServe Prometheus metrics at http://127.0.0.1:port/metrics." << std::endl;
+    std::cout << std::endl;
+    std::cout << "\t-M name" << std::endl;
+    std::cout << "\t\tdefault = none" << std::endl;
+    std::cout << "\t\tPublish live metrics in /dev/shm/name for ups-top." << std::endl;
+    std::cout << std::endl;
     std::cout << "\t-h";
     std::cout << "\t\tPrint help";
 }
@@ -40,10 +70,15 @@ int main(int argc, char *argv[])
 {
     Port port = App::DEFAULT_PORT;
     std::string ip;
+    size_t maxConnections = App::DEFAUL_MAX_CONNECTIONS;
+    unsigned rate = App::DEFAULT_BROADCAST_RATE;
+    std::string replayDirectory;
+    Port metricsPort{0};
+    std::string metricsSegment;
 
     int opt;
 
-    while ((opt = getopt(argc, argv, "hp:i:")) != -1) {
+    while ((opt = getopt(argc, argv, "hp:i:c:r:R:m:M:")) != -1) {
         switch (opt) {
         case 'p': {
             unsigned long p = std::stoul(std::string{optarg});
@@ -58,6 +93,41 @@ int main(int argc, char *argv[])
             ip = optarg;
             break;
         }
+        case 'c': {
+            unsigned long c = std::stoul(std::string{optarg});
+            if (!isValidMaxConnections(c)) {
+                std::cout << "error: invalid maximum of connections" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            maxConnections = c;
+            break;
+        }
+        case 'r': {
+            unsigned long r = std::stoul(std::string{optarg});
+            if (!isValidRate(r)) {
+                std::cout << "error: invalid broadcast rate" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            rate = static_cast<unsigned>(r);
+            break;
+        }
+        case 'R': {
+            replayDirectory = optarg;
+            break;
+        }
+        case 'm': {
+            unsigned long m = std::stoul(std::string{optarg});
+            if (!isValidPort(m)) {
+                std::cout << "error: invalid metrics port number" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            metricsPort = static_cast<Port>(m);
+            break;
+        }
+        case 'M': {
+            metricsSegment = optarg;
+            break;
+        }
         case 'h': {
             printHelp(argv[0]);
             exit(EXIT_SUCCESS);
@@ -69,7 +139,7 @@ int main(int argc, char *argv[])
     }
 
     try {
-        app = new App{port, ip};
+        app = new App{port, ip, maxConnections, rate, replayDirectory, metricsPort, metricsSegment};
         app->start();
 
         // register sigterm and sigint handler